@@ -0,0 +1,524 @@
+﻿/*
+    Бенчмарк хэш-мультимножества c_hash_multiset
+    Измеряет пропускную способность операций insert, check (попадания и промахи), data_count,
+    erase, erase_all, for_each и clear, а также память на элемент, на нагрузках:
+    uniform   - равномерно случайные ключи (в среднем 4 повтора на ключ),
+    zipf      - ключи по закону Ципфа (s = 1, много повторов у немногих ключей),
+    unique    - все ключи различны,
+    с ключами-целыми (uint64_t) и ключами-строками, на размерах от помещающихся в L1
+    до заданного максимума (по умолчанию 4M элементов, --max-elements 268435456 - несколько ГБ).
+    Результаты выводятся в stdout в формате JSON для сравнения версий и параметров.
+
+    Сборка (пример):
+    cc -O2 -DNDEBUG benchmark.c c_hash_multiset.c c_hash_multiset_hash.c -lpthread -lm -o benchmark
+
+    Запуск:
+    benchmark [--max-elements N] [--min-elements N] [--engine chained|flat|all]
+              [--growth modulo|pow2|fastrange|prime] [--migrate-step N] [--storage nodes|array]
+              [--keys u64|string|all] [--workload uniform|zipf|unique|all] [--seed N]
+
+    Лицензия: GPLv3
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "c_hash_multiset.h"
+#include "c_hash_multiset_hash.h"
+
+// Размер одного ключа-строки (с завершающим нулем).
+#define BENCHMARK_STRING_SIZE ( (size_t) 24 )
+
+// Минимальное количество операций одного замера: малые размеры повторяются, пока
+// количество операций не наберется.
+#define BENCHMARK_OPS_MIN ( (size_t) 1048576 )
+
+// Количество различных ключей нагрузки uniform - доля от количества элементов.
+#define BENCHMARK_UNIFORM_RATIO ( (size_t) 4 )
+
+// Количество различных ключей нагрузки zipf - доля от количества элементов.
+#define BENCHMARK_ZIPF_RATIO ( (size_t) 8 )
+
+enum
+{
+    BENCHMARK_OP_INSERT,
+    BENCHMARK_OP_CHECK,
+    BENCHMARK_OP_CHECK_MISS,
+    BENCHMARK_OP_DATA_COUNT,
+    BENCHMARK_OP_FOR_EACH,
+    BENCHMARK_OP_ERASE,
+    BENCHMARK_OP_ERASE_ALL,
+    BENCHMARK_OP_CLEAR,
+    BENCHMARK_OPS_COUNT
+};
+
+static const char *const benchmark_op_names[BENCHMARK_OPS_COUNT] =
+{
+    "insert", "check", "check_miss", "data_count", "for_each", "erase", "erase_all", "clear"
+};
+
+static const char *const benchmark_workload_names[3] = { "uniform", "zipf", "unique" };
+
+static const char *const benchmark_keys_names[2] = { "u64", "string" };
+
+static const char *const benchmark_engine_names[2] = { "chained", "flat" };
+
+static const char *const benchmark_growth_names[4] = { "modulo", "pow2", "fastrange", "prime" };
+
+static const char *const benchmark_storage_names[2] = { "nodes", "array" };
+
+// Параметры запуска.
+typedef struct s_benchmark_config
+{
+    size_t min_elements,
+           max_elements;
+    // Битовые маски выбранных движков, типов ключей и нагрузок.
+    unsigned engines,
+             keys,
+             workloads;
+    size_t growth_policy,
+           migrate_step,
+           storage;
+    uint64_t seed;
+} benchmark_config;
+
+// Ключи одного замера: n элементов (с повторами) и n ключей, которых в хэш-мультимножестве нет.
+typedef struct s_benchmark_keys
+{
+    size_t count;
+    const void **present,
+               **absent;
+    // Хранилище значений ключей (uint64_t или строки BENCHMARK_STRING_SIZE байт).
+    void *present_storage,
+         *absent_storage;
+} benchmark_keys;
+
+// Генератор псевдослучайных чисел splitmix64.
+static uint64_t benchmark_random(uint64_t *const _state)
+{
+    uint64_t z = (*_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Возвращает время в секундах.
+static double benchmark_time(void)
+{
+    struct timespec time_spec;
+    timespec_get(&time_spec, TIME_UTC);
+    return (double)time_spec.tv_sec + (double)time_spec.tv_nsec * 1e-9;
+}
+
+// Заполняет _ids номерами ключей нагрузки (номера различных ключей < 2^62).
+static void benchmark_ids(const size_t _workload,
+                          uint64_t *const _ids,
+                          const size_t _count,
+                          uint64_t *const _state)
+{
+    switch (_workload)
+    {
+        case 0:
+        {
+            const uint64_t distinct = _count / BENCHMARK_UNIFORM_RATIO + 1;
+            for (size_t i = 0; i < _count; ++i)
+            {
+                _ids[i] = benchmark_random(_state) % distinct;
+            }
+            break;
+        }
+        case 1:
+        {
+            // Обратная функция распределения Ципфа по таблице накопленных вероятностей.
+            const size_t distinct = _count / BENCHMARK_ZIPF_RATIO + 1;
+            double *const cdf = malloc(distinct * sizeof(double));
+            if (cdf == NULL)
+            {
+                fprintf(stderr, "benchmark: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+            double sum = 0.0;
+            for (size_t k = 0; k < distinct; ++k)
+            {
+                sum += 1.0 / (double)(k + 1);
+                cdf[k] = sum;
+            }
+            for (size_t i = 0; i < _count; ++i)
+            {
+                const double u = (double)(benchmark_random(_state) >> 11) * (1.0 / 9007199254740992.0) * sum;
+                size_t low = 0,
+                       high = distinct - 1;
+                while (low < high)
+                {
+                    const size_t middle = low + (high - low) / 2;
+                    if (cdf[middle] < u)
+                    {
+                        low = middle + 1;
+                    } else {
+                        high = middle;
+                    }
+                }
+                // Ранг перемешивается, чтобы частые ключи не шли подряд по значению.
+                _ids[i] = ((uint64_t)low * 0x9E3779B97F4A7C15ull) >> 2;
+            }
+            free(cdf);
+            break;
+        }
+        default:
+        {
+            for (size_t i = 0; i < _count; ++i)
+            {
+                _ids[i] = i;
+            }
+            // Перемешивание Фишера-Йетса.
+            for (size_t i = _count; i > 1; --i)
+            {
+                const size_t j = (size_t)(benchmark_random(_state) % i);
+                const uint64_t t = _ids[i - 1];
+                _ids[i - 1] = _ids[j];
+                _ids[j] = t;
+            }
+            break;
+        }
+    }
+}
+
+// Размещает ключи-значения по номерам ключей. Ключи с одинаковыми номерами - разные объекты
+// с одинаковым содержимым, как у реальных повторов.
+static void *benchmark_storage(const size_t _key_type,
+                               const uint64_t *const _ids,
+                               const size_t _count,
+                               const uint64_t _offset,
+                               const void **const _keys)
+{
+    const size_t key_size = (_key_type == 0) ? sizeof(uint64_t) : BENCHMARK_STRING_SIZE;
+    char *const storage = malloc(_count * key_size + 1);
+    if (storage == NULL)
+    {
+        fprintf(stderr, "benchmark: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < _count; ++i)
+    {
+        char *const key = storage + i * key_size;
+        const uint64_t id = _ids[i] + _offset;
+        if (_key_type == 0)
+        {
+            memcpy(key, &id, sizeof(uint64_t));
+        } else {
+            snprintf(key, BENCHMARK_STRING_SIZE, "key:%019llu", (unsigned long long)id);
+        }
+        _keys[i] = key;
+    }
+    return storage;
+}
+
+static void benchmark_keys_create(benchmark_keys *const _keys,
+                                  const size_t _workload,
+                                  const size_t _key_type,
+                                  const size_t _count,
+                                  uint64_t *const _state)
+{
+    uint64_t *const ids = malloc(_count * sizeof(uint64_t));
+    _keys->present = malloc(_count * sizeof(void*));
+    _keys->absent = malloc(_count * sizeof(void*));
+    if ( (ids == NULL) || (_keys->present == NULL) || (_keys->absent == NULL) )
+    {
+        fprintf(stderr, "benchmark: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    _keys->count = _count;
+
+    benchmark_ids(_workload, ids, _count, _state);
+    _keys->present_storage = benchmark_storage(_key_type, ids, _count, 0, _keys->present);
+
+    // Отсутствующие ключи - номера из непересекающегося диапазона.
+    for (size_t i = 0; i < _count; ++i)
+    {
+        ids[i] = benchmark_random(_state) >> 2;
+    }
+    _keys->absent_storage = benchmark_storage(_key_type, ids, _count, (uint64_t)1 << 62, _keys->absent);
+
+    free(ids);
+}
+
+static void benchmark_keys_delete(benchmark_keys *const _keys)
+{
+    free(_keys->present);
+    free(_keys->absent);
+    free(_keys->present_storage);
+    free(_keys->absent_storage);
+}
+
+// Приемник результатов, не дающий компилятору выбросить измеряемые вызовы.
+static volatile size_t benchmark_sink;
+
+static void benchmark_visit(const void *const _data)
+{
+    benchmark_sink += (size_t)(uintptr_t)_data;
+}
+
+static c_hash_multiset *benchmark_create(const benchmark_config *const _config,
+                                         const size_t _engine,
+                                         const size_t _key_type)
+{
+    c_hash_multiset_options options;
+    c_hash_multiset_options_init(&options);
+    options.engine = _engine;
+    options.growth_policy = _config->growth_policy;
+    options.migrate_step = _config->migrate_step;
+    options.storage = _config->storage;
+
+    size_t error = 0;
+    c_hash_multiset *const hash_multiset = (_key_type == 0) ?
+        c_hash_multiset_create_ex(c_hash_multiset_hash_u64, c_hash_multiset_comp_u64, 0, 0.75f, &options, &error) :
+        c_hash_multiset_create_ex(c_hash_multiset_hash_string, c_hash_multiset_comp_string, 0, 0.75f, &options, &error);
+    if (hash_multiset == NULL)
+    {
+        fprintf(stderr, "benchmark: create error %zu\n", error);
+        exit(EXIT_FAILURE);
+    }
+    return hash_multiset;
+}
+
+// Выполняет все операции над одним набором ключей, накапливая время в _seconds
+// и количество операций в _ops. Память на элемент помещается в _memory.
+static void benchmark_round(const benchmark_config *const _config,
+                            const size_t _engine,
+                            const size_t _key_type,
+                            const benchmark_keys *const _keys,
+                            double *const _seconds,
+                            size_t *const _ops,
+                            double *const _memory)
+{
+    const size_t n = _keys->count;
+    c_hash_multiset *const hash_multiset = benchmark_create(_config, _engine, _key_type);
+    double start;
+
+    start = benchmark_time();
+    for (size_t i = 0; i < n; ++i)
+    {
+        c_hash_multiset_insert(hash_multiset, _keys->present[i]);
+    }
+    _seconds[BENCHMARK_OP_INSERT] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_INSERT] += n;
+
+    c_hash_multiset_stats_report stats;
+    c_hash_multiset_stats(hash_multiset, &stats);
+    *_memory = (double)stats.memory_total / (double)n;
+
+    size_t found = 0;
+    start = benchmark_time();
+    for (size_t i = 0; i < n; ++i)
+    {
+        found += (c_hash_multiset_check(hash_multiset, _keys->present[i]) > 0);
+    }
+    _seconds[BENCHMARK_OP_CHECK] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_CHECK] += n;
+
+    start = benchmark_time();
+    for (size_t i = 0; i < n; ++i)
+    {
+        found += (c_hash_multiset_check(hash_multiset, _keys->absent[i]) > 0);
+    }
+    _seconds[BENCHMARK_OP_CHECK_MISS] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_CHECK_MISS] += n;
+
+    start = benchmark_time();
+    for (size_t i = 0; i < n; ++i)
+    {
+        found += c_hash_multiset_data_count(hash_multiset, _keys->present[i], NULL);
+    }
+    _seconds[BENCHMARK_OP_DATA_COUNT] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_DATA_COUNT] += n;
+
+    start = benchmark_time();
+    c_hash_multiset_for_each(hash_multiset, benchmark_visit);
+    _seconds[BENCHMARK_OP_FOR_EACH] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_FOR_EACH] += n;
+
+    // Первая половина ключей удаляется по одной единице, затем вторая - целиком.
+    start = benchmark_time();
+    for (size_t i = 0; i < n / 2; ++i)
+    {
+        c_hash_multiset_erase(hash_multiset, _keys->present[i], NULL);
+    }
+    _seconds[BENCHMARK_OP_ERASE] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_ERASE] += n / 2;
+
+    start = benchmark_time();
+    for (size_t i = n / 2; i < n; ++i)
+    {
+        found += c_hash_multiset_erase_all(hash_multiset, _keys->present[i], NULL, NULL);
+    }
+    _seconds[BENCHMARK_OP_ERASE_ALL] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_ERASE_ALL] += n - n / 2;
+
+    // Очистка измеряется на заново заполненном хэш-мультимножестве, операция - один элемент.
+    for (size_t i = 0; i < n; ++i)
+    {
+        c_hash_multiset_insert(hash_multiset, _keys->present[i]);
+    }
+    start = benchmark_time();
+    c_hash_multiset_clear(hash_multiset, NULL);
+    _seconds[BENCHMARK_OP_CLEAR] += benchmark_time() - start;
+    _ops[BENCHMARK_OP_CLEAR] += n;
+
+    benchmark_sink += found;
+
+    c_hash_multiset_delete(hash_multiset, NULL);
+}
+
+static void benchmark_run(const benchmark_config *const _config,
+                          const size_t _engine,
+                          const size_t _key_type,
+                          const size_t _workload,
+                          const size_t _count,
+                          size_t *const _results_count)
+{
+    uint64_t state = _config->seed ^ ((uint64_t)_count << 8) ^ (_workload << 4) ^ _key_type;
+    benchmark_keys keys;
+    benchmark_keys_create(&keys, _workload, _key_type, _count, &state);
+
+    double seconds[BENCHMARK_OPS_COUNT] = {0};
+    size_t ops[BENCHMARK_OPS_COUNT] = {0};
+    double memory = 0.0;
+
+    const size_t rounds = (_count < BENCHMARK_OPS_MIN) ? BENCHMARK_OPS_MIN / _count : 1;
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        benchmark_round(_config, _engine, _key_type, &keys, seconds, ops, &memory);
+    }
+
+    printf("%s\n    {\"engine\": \"%s\", \"growth\": \"%s\", \"migrate_step\": %zu, \"storage\": \"%s\", \"keys\": \"%s\", "
+           "\"workload\": \"%s\", \"elements\": %zu, \"rounds\": %zu, \"bytes_per_element\": %.2f",
+           (*_results_count > 0) ? "," : "",
+           benchmark_engine_names[_engine], benchmark_growth_names[_config->growth_policy],
+           _config->migrate_step, benchmark_storage_names[_config->storage],
+           benchmark_keys_names[_key_type], benchmark_workload_names[_workload],
+           _count, rounds, memory);
+    for (size_t o = 0; o < BENCHMARK_OPS_COUNT; ++o)
+    {
+        const double per_second = (seconds[o] > 0.0) ? (double)ops[o] / seconds[o] : 0.0;
+        printf(",\n     \"%s\": {\"ops_per_second\": %.0f, \"ns_per_op\": %.3f}",
+               benchmark_op_names[o], per_second, (per_second > 0.0) ? 1e9 / per_second : 0.0);
+    }
+    printf("}");
+    fflush(stdout);
+    ++*_results_count;
+
+    benchmark_keys_delete(&keys);
+}
+
+// Возвращает номер значения в списке имен, "all" - SIZE_MAX, неизвестное имя - завершение программы.
+static size_t benchmark_parse_name(const char *const _value,
+                                   const char *const *const _names,
+                                   const size_t _names_count)
+{
+    if (strcmp(_value, "all") == 0)
+    {
+        return SIZE_MAX;
+    }
+    for (size_t i = 0; i < _names_count; ++i)
+    {
+        if (strcmp(_value, _names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    fprintf(stderr, "benchmark: unknown value '%s'\n", _value);
+    exit(EXIT_FAILURE);
+}
+
+static unsigned benchmark_parse_mask(const char *const _value,
+                                     const char *const *const _names,
+                                     const size_t _names_count)
+{
+    const size_t index = benchmark_parse_name(_value, _names, _names_count);
+    return (index == SIZE_MAX) ? (1u << _names_count) - 1 : 1u << index;
+}
+
+int main(int argc, char **argv)
+{
+    benchmark_config config;
+    config.min_elements = 1024;
+    config.max_elements = 4194304;
+    config.engines = 3;
+    config.keys = 3;
+    config.workloads = 7;
+    config.growth_policy = C_HASH_MULTISET_GROWTH_MODULO;
+    config.migrate_step = 0;
+    config.storage = C_HASH_MULTISET_STORAGE_NODES;
+    config.seed = 20180413;
+
+    for (int a = 1; a + 1 < argc; a += 2)
+    {
+        const char *const value = argv[a + 1];
+        if (strcmp(argv[a], "--max-elements") == 0)
+        {
+            config.max_elements = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(argv[a], "--min-elements") == 0) {
+            config.min_elements = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(argv[a], "--engine") == 0) {
+            config.engines = benchmark_parse_mask(value, benchmark_engine_names, 2);
+        } else if (strcmp(argv[a], "--keys") == 0) {
+            config.keys = benchmark_parse_mask(value, benchmark_keys_names, 2);
+        } else if (strcmp(argv[a], "--workload") == 0) {
+            config.workloads = benchmark_parse_mask(value, benchmark_workload_names, 3);
+        } else if (strcmp(argv[a], "--growth") == 0) {
+            const size_t growth_policy = benchmark_parse_name(value, benchmark_growth_names, 4);
+            config.growth_policy = (growth_policy == SIZE_MAX) ? C_HASH_MULTISET_GROWTH_MODULO : growth_policy;
+        } else if (strcmp(argv[a], "--migrate-step") == 0) {
+            config.migrate_step = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(argv[a], "--storage") == 0) {
+            const size_t storage = benchmark_parse_name(value, benchmark_storage_names, 2);
+            config.storage = (storage == SIZE_MAX) ? C_HASH_MULTISET_STORAGE_NODES : storage;
+        } else if (strcmp(argv[a], "--seed") == 0) {
+            config.seed = strtoull(value, NULL, 10);
+        } else {
+            fprintf(stderr, "benchmark: unknown option '%s'\n", argv[a]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ( (config.min_elements < 2) || (config.max_elements < config.min_elements) )
+    {
+        fprintf(stderr, "benchmark: bad element counts\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("{\"benchmark\": \"c_hash_multiset\", \"seed\": %llu, \"results\": [",
+           (unsigned long long)config.seed);
+
+    size_t results_count = 0;
+    // Размеры растут в 8 раз: 1K элементов помещаются в L1, верхние - далеко за пределами LLC.
+    for (size_t count = config.min_elements; count <= config.max_elements; )
+    {
+        for (size_t engine = 0; engine < 2; ++engine)
+        {
+            if ( (config.engines & (1u << engine)) == 0 ) continue;
+            for (size_t key_type = 0; key_type < 2; ++key_type)
+            {
+                if ( (config.keys & (1u << key_type)) == 0 ) continue;
+                for (size_t workload = 0; workload < 3; ++workload)
+                {
+                    if ( (config.workloads & (1u << workload)) == 0 ) continue;
+                    benchmark_run(&config, engine, key_type, workload, count, &results_count);
+                }
+            }
+        }
+        if (count > config.max_elements / 8)
+        {
+            if (count == config.max_elements) break;
+            count = config.max_elements;
+        } else {
+            count *= 8;
+        }
+    }
+
+    printf("\n]}\n");
+
+    return EXIT_SUCCESS;
+}
@@ -12,11 +12,26 @@
     Лицензия: GPLv3
 */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <memory.h>
 
+// Без потоков (C_HASH_MULTISET_NO_THREADS) параллельные операции выполняются последовательно.
+#if !defined(C_HASH_MULTISET_NO_THREADS)
+#include <pthread.h>
+#endif
+
+#if defined(C_HASH_MULTISET_LATENCY)
+#include <time.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define C_HASH_MULTISET_SSE2
+#endif
+
 #include "c_hash_multiset.h"
 
 // Количество слотов, задаваемое хэш-мультимножеству с нулем слотов при автоматическом
@@ -27,26 +42,146 @@
 #define C_HASH_MULTISET_MLF_MIN ( (float) 0.01f )
 
 // Максимально возможное значение max_load_factor.
-#define C_HASH_MULTISET_MLF_MAX ( (float) 1.0f )
+// Значения больше 1.0 имеют смысл только для цепочного движка, плоский движок ограничивает их.
+#define C_HASH_MULTISET_MLF_MAX ( (float) 16.0f )
+
+// Коэф. роста количества слотов по умолчанию.
+#define C_HASH_MULTISET_GROWTH ( (float) 1.75f )
+
+// Максимально возможный коэф. роста количества слотов.
+#define C_HASH_MULTISET_GROWTH_MAX ( (float) 16.0f )
+
+// Количество слотов, меньше которого автоматическое сжатие не опускается.
+#define C_HASH_MULTISET_SHRINK_MIN ( (size_t) 64 )
+
+// Количество данных, хэши которых пакетные операции вычисляют за один проход.
+#define C_HASH_MULTISET_BATCH ( (size_t) 256 )
+
+// Построение из массива: среднее количество данных в части, таблица группировки которой
+// помещается в кэш, и максимальное количество частей.
+#define C_HASH_MULTISET_BULK_PART ( (size_t) 1024 )
+#define C_HASH_MULTISET_BULK_PARTS_MAX ( (size_t) 1024 )
+
+// Дистанция предвыборки пакетных операций: узлы выбираются на столько данных вперед,
+// цепочки - на две дистанции, слоты - на три.
+#define C_HASH_MULTISET_PREFETCH_DISTANCE ( (size_t) 8 )
+
+// Подсказка процессору о предстоящем чтении.
+#if defined(__GNUC__)
+#define C_HASH_MULTISET_PREFETCH(_address) __builtin_prefetch(_address)
+#elif defined(C_HASH_MULTISET_SSE2)
+#define C_HASH_MULTISET_PREFETCH(_address) _mm_prefetch((const char*)(_address), _MM_HINT_T0)
+#else
+#define C_HASH_MULTISET_PREFETCH(_address) ( (void)(_address) )
+#endif
+
+// Максимальное количество потоков параллельных операций.
+#define C_HASH_MULTISET_THREADS_MAX ( (size_t) 64 )
+
+// Минимальное количество слотов на один поток параллельной операции
+// (на меньших диапазонах создание потока дороже самой работы).
+#define C_HASH_MULTISET_PARALLEL_MIN ( (size_t) 4096 )
+
+// Количество объектов в первом блоке пула.
+#define C_HASH_MULTISET_SLAB_MIN ( (size_t) 32 )
+
+// Максимальное количество объектов в одном блоке пула.
+#define C_HASH_MULTISET_SLAB_MAX ( (size_t) 8192 )
+
+// Быстрая очистка обнуляет слоты по цепочкам пула, если цепочек в пулах хотя бы
+// во столько раз меньше, чем слотов, иначе обнуляет весь массив слотов.
+#define C_HASH_MULTISET_CLEAR_RATIO ( (size_t) 16 )
+
+// Начальная вместимость внешнего массива повторов (хранение массивом).
+#define C_HASH_MULTISET_ITEMS_MIN ( (size_t) 4 )
+
+// Операции алгебры хэш-мультимножеств (количество единиц в результате):
+// сумма - l + r, объединение - max(l, r), пересечение - min(l, r), разность - max(0, l - r).
+#define C_HASH_MULTISET_ALGEBRA_SUM ( (size_t) 0 )
+#define C_HASH_MULTISET_ALGEBRA_UNION ( (size_t) 1 )
+#define C_HASH_MULTISET_ALGEBRA_INTERSECTION ( (size_t) 2 )
+#define C_HASH_MULTISET_ALGEBRA_DIFFERENCE ( (size_t) 3 )
+
+// Размер заголовка блока пула (выровнен, чтобы объекты в блоке были выровнены).
+#define C_HASH_MULTISET_SLAB_HEADER ( (size_t) 16 )
+
+// Максимально возможное значение max_load_factor плоского движка.
+#define C_HASH_MULTISET_FLAT_MLF_MAX ( (float) 0.875f )
+
+// Количество позиций в группе плоского движка (одна группа сканируется одной SSE2-командой).
+#define C_HASH_MULTISET_GROUP ( (size_t) 16 )
+
+// Управляющий байт пустой позиции плоского движка.
+#define C_HASH_MULTISET_CTRL_EMPTY ( (uint8_t) 0x80 )
+
+// Управляющий байт удаленной позиции плоского движка.
+#define C_HASH_MULTISET_CTRL_DELETED ( (uint8_t) 0xFE )
+
+// Маска отпечатка хэша, хранимого в управляющем байте занятой позиции.
+#define C_HASH_MULTISET_CTRL_H2 ( (uint8_t) 0x7F )
 
 typedef struct s_c_hash_multiset_node c_hash_multiset_node;
 
 typedef struct s_c_hash_multiset_chain c_hash_multiset_chain;
 
+typedef struct s_c_hash_multiset_items c_hash_multiset_items;
+
+typedef struct s_c_hash_multiset_slab c_hash_multiset_slab;
+
+typedef struct s_c_hash_multiset_pool c_hash_multiset_pool;
+
 struct s_c_hash_multiset_node
 {
     struct s_c_hash_multiset_node *next_node;
     void *data;
 };
 
+// Внешний массив данных цепочки при хранении массивом (если единиц данных больше одной).
+struct s_c_hash_multiset_items
+{
+    size_t capacity;
+    void *data[];
+};
+
 struct s_c_hash_multiset_chain
 {
     struct s_c_hash_multiset_chain *next_chain;
-    c_hash_multiset_node *head;
+    // При хранении узлами - список узлов, при хранении массивом - сами данные (если единица одна)
+    // или внешний массив.
+    union
+    {
+        c_hash_multiset_node *head;
+        void *data;
+        c_hash_multiset_items *items;
+    };
     size_t count,
            hash;
 };
 
+// Блок памяти, из которого пул нарезает объекты.
+// Объекты располагаются сразу за заголовком блока.
+struct s_c_hash_multiset_slab
+{
+    struct s_c_hash_multiset_slab *next_slab;
+    size_t capacity;
+};
+
+// Пул объектов одного размера.
+// Освобожденные объекты помещаются в список свободных, новые объекты нарезаются
+// из последнего выделенного блока, и только когда он исчерпан, выделяется новый блок.
+struct s_c_hash_multiset_pool
+{
+    // Список свободных объектов (связь хранится в первых байтах объекта).
+    void *free_list;
+    // Список всех выделенных блоков.
+    c_hash_multiset_slab *slabs;
+    // Неразмеченная часть последнего блока.
+    uint8_t *free_begin,
+            *free_end;
+    // Размер одного объекта.
+    size_t object_size;
+};
+
 struct s_c_hash_multiset
 {
     // Функция, генерирующая хэш на основе данных.
@@ -60,728 +195,5203 @@ struct s_c_hash_multiset
            nodes_count,
            uniques_count;
 
-    float max_load_factor;
+    float max_load_factor,
+          min_load_factor;
 
     c_hash_multiset_chain **slots;
+
+    // Политика роста, коэф. роста и константы быстрого деления
+    // (для простых количеств слотов) текущего и старого массивов слотов.
+    size_t growth_policy;
+    float growth_factor;
+    uint64_t slots_magic,
+             old_slots_magic;
+
+    // Движок хэш-мультимножества.
+    size_t engine;
+
+    // Плоский движок: управляющие байты позиций, записи уникальных данных
+    // (цепочки без связи next_chain) и количество удаленных позиций.
+    uint8_t *flat_ctrl;
+    c_hash_multiset_chain *flat_entries;
+    size_t flat_tombstones;
+
+    // Постепенное перестроение цепочной таблицы: количество старых слотов, переносимых
+    // за одну операцию (0 - перестроение сразу), старый массив слотов, его размер и
+    // количество уже перенесенных слотов.
+    size_t migrate_step;
+    c_hash_multiset_chain **old_slots;
+    size_t old_slots_count,
+           migrate_pos;
+
+    // Пулы цепочек и узлов.
+    c_hash_multiset_pool chains_pool,
+                         nodes_pool;
+
+    // Размер ключа при хранении по значению (ключ лежит в узле сразу за ним), 0 - хранятся указатели.
+    size_t key_size;
+
+    // Хранение повторов (C_HASH_MULTISET_STORAGE_*).
+    size_t storage;
+
+    // Быстрая очистка (см. c_hash_multiset_options).
+    size_t fast_clear;
+
+    // Распределитель памяти и его контекст.
+    c_hash_multiset_allocator allocator;
+    void *allocator_context;
+
+#if defined(C_HASH_MULTISET_COUNTERS)
+    // Счетчики вызовов функций хэша и сравнения и перестроений.
+    struct
+    {
+        size_t hash_calls,
+               comp_calls,
+               resizes;
+    } counters;
+#endif
+
+#if defined(C_HASH_MULTISET_LATENCY)
+    // Обработчики начала и конца долгих операций и гистограммы задержек операций.
+    c_hash_multiset_hooks hooks;
+    uint64_t latency[C_HASH_MULTISET_OPS_COUNT][C_HASH_MULTISET_LATENCY_BUCKETS];
+#endif
 };
 
-// Если расположение задано, в него помещается код.
-static void error_set(size_t *const _error,
-                      const size_t _code)
+// Со счетчиками (C_HASH_MULTISET_COUNTERS) вызовы функций хэша и сравнения и перестроения
+// подсчитываются, иначе макросы не стоят ничего.
+// Счетчики не атомарны: параллельные операции считаются приблизительно.
+#if defined(C_HASH_MULTISET_COUNTERS)
+#define C_HASH_MULTISET_COUNT(_hash_multiset, _counter) ( (void)++((c_hash_multiset*)(_hash_multiset))->counters._counter )
+#else
+#define C_HASH_MULTISET_COUNT(_hash_multiset, _counter) ( (void)0 )
+#endif
+
+// Вызов функции хэша хэш-мультимножества.
+#define C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data)\
+    ( C_HASH_MULTISET_COUNT(_hash_multiset, hash_calls), (_hash_multiset)->hash_data(_data) )
+
+// Вызов функции сравнения хэш-мультимножества (без нее ключи, хранимые по значению, сравниваются memcmp()).
+#define C_HASH_MULTISET_COMP_DATA(_hash_multiset, _data_a, _data_b)\
+    ( C_HASH_MULTISET_COUNT(_hash_multiset, comp_calls),\
+      ((_hash_multiset)->comp_data != NULL) ? (_hash_multiset)->comp_data(_data_a, _data_b) :\
+                                              (size_t)(memcmp(_data_a, _data_b, (_hash_multiset)->key_size) == 0) )
+
+#if defined(C_HASH_MULTISET_LATENCY)
+// Возвращает показание монотонных часов в наносекундах.
+static uint64_t latency_clock(void)
 {
-    if (_error != NULL)
+    struct timespec time_spec;
+#if defined(CLOCK_MONOTONIC)
+    clock_gettime(CLOCK_MONOTONIC, &time_spec);
+#else
+    timespec_get(&time_spec, TIME_UTC);
+#endif
+    return (uint64_t)time_spec.tv_sec * 1000000000u + (uint64_t)time_spec.tv_nsec;
+}
+
+// Начало измеряемой операции: для перестроения и очистки вызывается обработчик начала.
+// Возвращает показание часов.
+static uint64_t trace_begin(const c_hash_multiset *const _hash_multiset,
+                            const size_t _operation)
+{
+    if ( (_hash_multiset->hooks.begin != NULL) &&
+         ( (_operation == C_HASH_MULTISET_OP_RESIZE) || (_operation == C_HASH_MULTISET_OP_CLEAR) ) )
     {
-        *_error = _code;
+        _hash_multiset->hooks.begin(_hash_multiset->hooks.context, _operation);
     }
+    return latency_clock();
 }
 
-// Создает новое хэш-мультимножество.
-// Позволяет создавать хэш-мультимножество с нулем слотов.
-// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
-// код причины ошибки (> 0).
-c_hash_multiset *c_hash_multiset_create(size_t (*const _hash_data)(const void *const _data),
-                                        size_t (*const _comp_data)(const void *const _data_a,
-                                                                   const void *const _data_b),
-                                        const size_t _slots_count,
-                                        const float _max_load_factor,
-                                        size_t *const _error)
+// Конец измеряемой операции: задержка заносится в гистограмму операции,
+// для перестроения и очистки вызывается обработчик конца.
+static void trace_end(c_hash_multiset *const _hash_multiset,
+                      const size_t _operation,
+                      const uint64_t _start)
 {
-    if (_hash_data == NULL)
+    const uint64_t nanoseconds = latency_clock() - _start;
+
+    size_t bucket = 0;
+    for (uint64_t value = nanoseconds; (value > 1) && (bucket < C_HASH_MULTISET_LATENCY_BUCKETS - 1); value >>= 1)
     {
-        error_set(_error, 1);
-        return NULL;
+        ++bucket;
     }
-    if (_comp_data == NULL)
+    ++_hash_multiset->latency[_operation][bucket];
+
+    if ( (_hash_multiset->hooks.end != NULL) &&
+         ( (_operation == C_HASH_MULTISET_OP_RESIZE) || (_operation == C_HASH_MULTISET_OP_CLEAR) ) )
     {
-        error_set(_error, 2);
-        return NULL;
+        _hash_multiset->hooks.end(_hash_multiset->hooks.context, _operation, nanoseconds);
     }
-    if ( (_max_load_factor < C_HASH_MULTISET_MLF_MIN) ||
-         (_max_load_factor > C_HASH_MULTISET_MLF_MAX) )
+}
+#endif
+
+// С измерением задержек (C_HASH_MULTISET_LATENCY) операция обрамляется показаниями часов,
+// иначе макросы не стоят ничего.
+// Макрос начала объявляет переменную, поэтому в функции может быть только одна измеряемая операция.
+#if defined(C_HASH_MULTISET_LATENCY)
+#define C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, _operation)\
+    const uint64_t trace_start = trace_begin(_hash_multiset, _operation)
+#define C_HASH_MULTISET_TRACE_END(_hash_multiset, _operation)\
+    trace_end(_hash_multiset, _operation, trace_start)
+#else
+#define C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, _operation) ( (void)0 )
+#define C_HASH_MULTISET_TRACE_END(_hash_multiset, _operation) ( (void)0 )
+#endif
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
     {
-        error_set(_error, 3);
-        return NULL;
+        *_error = _code;
     }
+}
 
-    c_hash_multiset_chain **new_slots = NULL;
+// Простые числа, которые используются в качестве количества слотов политикой
+// C_HASH_MULTISET_GROWTH_PRIME (примерно четыре на каждое удвоение).
+static const uint32_t primes[] =
+{
+    UINT32_C(11), UINT32_C(13), UINT32_C(17), UINT32_C(19),
+    UINT32_C(23), UINT32_C(29), UINT32_C(37), UINT32_C(41),
+    UINT32_C(47), UINT32_C(59), UINT32_C(67), UINT32_C(79),
+    UINT32_C(97), UINT32_C(109), UINT32_C(131), UINT32_C(157),
+    UINT32_C(181), UINT32_C(223), UINT32_C(257), UINT32_C(307),
+    UINT32_C(367), UINT32_C(431), UINT32_C(521), UINT32_C(613),
+    UINT32_C(727), UINT32_C(863), UINT32_C(1031), UINT32_C(1223),
+    UINT32_C(1451), UINT32_C(1723), UINT32_C(2053), UINT32_C(2437),
+    UINT32_C(2897), UINT32_C(3449), UINT32_C(4099), UINT32_C(4871),
+    UINT32_C(5801), UINT32_C(6899), UINT32_C(8209), UINT32_C(9743),
+    UINT32_C(11587), UINT32_C(13781), UINT32_C(16411), UINT32_C(19489),
+    UINT32_C(23173), UINT32_C(27581), UINT32_C(32771), UINT32_C(38971),
+    UINT32_C(46349), UINT32_C(55109), UINT32_C(65537), UINT32_C(77951),
+    UINT32_C(92683), UINT32_C(110221), UINT32_C(131101), UINT32_C(155887),
+    UINT32_C(185369), UINT32_C(220447), UINT32_C(262147), UINT32_C(311747),
+    UINT32_C(370759), UINT32_C(440893), UINT32_C(524309), UINT32_C(623521),
+    UINT32_C(741457), UINT32_C(881779), UINT32_C(1048583), UINT32_C(1246997),
+    UINT32_C(1482919), UINT32_C(1763491), UINT32_C(2097169), UINT32_C(2493949),
+    UINT32_C(2965847), UINT32_C(3526987), UINT32_C(4194319), UINT32_C(4987901),
+    UINT32_C(5931649), UINT32_C(7053971), UINT32_C(8388617), UINT32_C(9975803),
+    UINT32_C(11863289), UINT32_C(14107921), UINT32_C(16777259), UINT32_C(19951597),
+    UINT32_C(23726569), UINT32_C(28215809), UINT32_C(33554467), UINT32_C(39903197),
+    UINT32_C(47453149), UINT32_C(56431657), UINT32_C(67108879), UINT32_C(79806341),
+    UINT32_C(94906297), UINT32_C(112863217), UINT32_C(134217757), UINT32_C(159612679),
+    UINT32_C(189812533), UINT32_C(225726419), UINT32_C(268435459), UINT32_C(319225391),
+    UINT32_C(379625083), UINT32_C(451452839), UINT32_C(536870923), UINT32_C(638450719),
+    UINT32_C(759250133), UINT32_C(902905657), UINT32_C(1073741827), UINT32_C(1276901429),
+    UINT32_C(1518500279), UINT32_C(1805811341), UINT32_C(2147483659), UINT32_C(2553802871),
+    UINT32_C(3037000507), UINT32_C(3611622607), UINT32_C(4294967291)
+};
 
-    if (_slots_count > 0)
+// Возвращает старшие 64 бита произведения.
+static uint64_t mul_high(const uint64_t _a,
+                         const uint64_t _b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((unsigned __int128)_a * _b) >> 64);
+#else
+    const uint64_t a_lo = (uint32_t)_a,
+                   a_hi = _a >> 32,
+                   b_lo = (uint32_t)_b,
+                   b_hi = _b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo,
+                   hi_lo = a_hi * b_lo,
+                   lo_hi = a_lo * b_hi,
+                   hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    return hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Приводит количество слотов к допустимому для политики роста значению (не меньше заданного).
+// В случае переполнения возвращает 0.
+static size_t slots_round(const size_t _growth_policy,
+                          const size_t _slots_count)
+{
+    switch (_growth_policy)
     {
-        const size_t new_slots_size = _slots_count * sizeof(c_hash_multiset_chain*);
-        if ( (new_slots_size == 0) ||
-             (new_slots_size / _slots_count != sizeof(c_hash_multiset_chain*)) )
+        case C_HASH_MULTISET_GROWTH_POW2:
         {
-            error_set(_error, 4);
-            return NULL;
+            size_t slots_count = 1;
+            while (slots_count < _slots_count)
+            {
+                if (slots_count > SIZE_MAX / 2)
+                {
+                    return 0;
+                }
+                slots_count *= 2;
+            }
+            return slots_count;
         }
-
-        new_slots = malloc(new_slots_size);
-        if (new_slots == NULL)
+        case C_HASH_MULTISET_GROWTH_PRIME:
         {
-            error_set(_error, 5);
-            return NULL;
+            for (size_t i = 0; i < sizeof(primes) / sizeof(primes[0]); ++i)
+            {
+                if (primes[i] >= _slots_count)
+                {
+                    return primes[i];
+                }
+            }
+            return 0;
+        }
+        default:
+        {
+            return _slots_count;
         }
-
-        memset(new_slots, 0, new_slots_size);
     }
+}
 
-    c_hash_multiset *const new_hash_multiset = malloc(sizeof(c_hash_multiset));
-    if (new_hash_multiset == NULL)
+// Возвращает константу быстрого деления для заданного количества слотов.
+static uint64_t slots_magic(const size_t _growth_policy,
+                            const size_t _slots_count)
+{
+    if ( (_growth_policy == C_HASH_MULTISET_GROWTH_PRIME) && (_slots_count > 0) )
     {
-        free(new_slots);
-        error_set(_error, 6);
-        return NULL;
+        return UINT64_MAX / _slots_count + 1;
     }
+    return 0;
+}
 
-    new_hash_multiset->hash_data = _hash_data;
-    new_hash_multiset->comp_data = _comp_data;
+// Приводит хэш к номеру слота согласно политике роста.
+static size_t slots_reduce(const size_t _growth_policy,
+                           const size_t _hash,
+                           const size_t _slots_count,
+                           const uint64_t _magic)
+{
+    switch (_growth_policy)
+    {
+        case C_HASH_MULTISET_GROWTH_POW2:
+        {
+            return _hash & (_slots_count - 1);
+        }
+        case C_HASH_MULTISET_GROWTH_FASTRANGE:
+        {
+#if SIZE_MAX > UINT32_MAX
+            return (size_t)mul_high(_hash, _slots_count);
+#else
+            return (size_t)( ((uint64_t)_hash * _slots_count) >> 32 );
+#endif
+        }
+        case C_HASH_MULTISET_GROWTH_PRIME:
+        {
+            // Остаток от деления 32-битной свертки хэша без деления (Lemire, fastmod).
+            const uint32_t folded = (uint32_t)( (uint64_t)_hash ^ ((uint64_t)_hash >> 32) );
+            return (size_t)mul_high(_magic * folded, _slots_count);
+        }
+        default:
+        {
+            return _hash % _slots_count;
+        }
+    }
+}
 
-    new_hash_multiset->slots_count = _slots_count;
-    new_hash_multiset->nodes_count = 0;
-    new_hash_multiset->uniques_count = 0;
+// Распределитель по умолчанию: выделение памяти.
+static void *default_allocate(void *const _context,
+                              const size_t _size)
+{
+    (void)_context;
+    return malloc(_size);
+}
 
-    new_hash_multiset->max_load_factor = _max_load_factor;
+// Распределитель по умолчанию: освобождение памяти.
+static void default_deallocate(void *const _context,
+                               void *const _block)
+{
+    (void)_context;
+    free(_block);
+}
 
-    new_hash_multiset->slots = new_slots;
+// Распределитель по умолчанию, использующий malloc/free.
+static const c_hash_multiset_allocator default_allocator =
+{
+    default_allocate,
+    default_deallocate,
+    NULL
+};
 
-    return new_hash_multiset;
+// Выделяет блок памяти распределителем хэш-мультимножества.
+static void *memory_alloc(const c_hash_multiset *const _hash_multiset,
+                          const size_t _size)
+{
+    return _hash_multiset->allocator.allocate(_hash_multiset->allocator_context, _size);
 }
 
-// Удаляет хэш-мультимножество.
-// В случае успеха возвращает > 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_multiset_delete(c_hash_multiset *const _hash_multiset,
-                                 void (*const _del_data)(void *const _data))
+// Освобождает блок памяти распределителем хэш-мультимножества.
+static void memory_free(const c_hash_multiset *const _hash_multiset,
+                        void *const _block)
 {
-    if (c_hash_multiset_clear(_hash_multiset, _del_data) < 0)
+    if (_block != NULL)
     {
-        return -1;
+        _hash_multiset->allocator.deallocate(_hash_multiset->allocator_context, _block);
     }
-
-    free(_hash_multiset->slots);
-
-    free(_hash_multiset);
-
-    return 1;
 }
 
-// Вставка данных в хэш-мультимножество.
-// В случае успешной вставки возвращает > 0, данные захватываются хэш-мультимножеством.
-// В случае ошибки возвращает < 0, данные не захватываются хэш-мультимножеством.
-ptrdiff_t c_hash_multiset_insert(c_hash_multiset *const _hash_multiset,
-                                 const void *const _data)
+// Инициализирует пустой пул объектов заданного размера.
+static void pool_init(c_hash_multiset_pool *const _pool,
+                      const size_t _object_size)
 {
-    if (_hash_multiset == NULL) return -1;
-    if (_data == NULL) return -2;
+    _pool->free_list = NULL;
+    _pool->slabs = NULL;
+    _pool->free_begin = NULL;
+    _pool->free_end = NULL;
+    _pool->object_size = _object_size;
+}
 
-    // Первым делом контролируем процесс увеличения количества слотов.
+// Выделяет объект из пула.
+// В случае ошибки возвращает NULL.
+static void *pool_alloc(const c_hash_multiset *const _hash_multiset,
+                        c_hash_multiset_pool *const _pool)
+{
+    // Первым делом используем ранее освобожденные объекты.
+    if (_pool->free_list != NULL)
+    {
+        void *const object = _pool->free_list;
+        _pool->free_list = *(void**)object;
+        return object;
+    }
 
-    // Если слотов нет вообще.
-    if (_hash_multiset->slots_count == 0)
+    // Если последний блок исчерпан, выделяем новый, вдвое больше предыдущего.
+    if (_pool->free_begin == _pool->free_end)
     {
-        // Пытаемся расширить слоты.
-        if (c_hash_multiset_resize(_hash_multiset, C_HASH_MULTISET_0) <= 0)
-        {
-            return -3;
-        }
-    } else {
-        // Если слоты есть, то при достижении предела загруженности увеличиваем количество слотов.
-        const float load_factor = (float)_hash_multiset->uniques_count / _hash_multiset->slots_count;
-        if (load_factor >= _hash_multiset->max_load_factor)
+        size_t capacity = C_HASH_MULTISET_SLAB_MIN;
+        if (_pool->slabs != NULL)
         {
-            // Определим новое количество слотов.
-            size_t new_slots_count = (size_t)(_hash_multiset->slots_count * 1.75f);
-            if (new_slots_count < _hash_multiset->slots_count)
-            {
-                return -4;
-            }
-            new_slots_count += 1;
-            if (new_slots_count == 0)
+            capacity = _pool->slabs->capacity * 2;
+            if (capacity > C_HASH_MULTISET_SLAB_MAX)
             {
-                return -5;
+                capacity = C_HASH_MULTISET_SLAB_MAX;
             }
+        }
 
-            // Пытаемся расширить слоты.
-            if (c_hash_multiset_resize(_hash_multiset, new_slots_count) < 0)
-            {
-                return -6;
-            }
+        c_hash_multiset_slab *const new_slab = memory_alloc(_hash_multiset,
+                                                            C_HASH_MULTISET_SLAB_HEADER +
+                                                            capacity * _pool->object_size);
+        if (new_slab == NULL)
+        {
+            return NULL;
         }
+
+        new_slab->capacity = capacity;
+        new_slab->next_slab = _pool->slabs;
+        _pool->slabs = new_slab;
+
+        _pool->free_begin = (uint8_t*)new_slab + C_HASH_MULTISET_SLAB_HEADER;
+        _pool->free_end = _pool->free_begin + capacity * _pool->object_size;
     }
-    // Вставляем данные в хэш-мультимножество.
 
-    // Неприведенный хэш вставляемых данных.
-    const size_t hash = _hash_multiset->hash_data(_data);
+    void *const object = _pool->free_begin;
+    _pool->free_begin += _pool->object_size;
+    return object;
+}
 
-    // Приведенный хэш.
-    const size_t presented_hash = hash % _hash_multiset->slots_count;
+// Возвращает объект в пул.
+static void pool_free(c_hash_multiset_pool *const _pool,
+                      void *const _object)
+{
+    *(void**)_object = _pool->free_list;
+    _pool->free_list = _object;
+}
 
-    // Попытаемся найти в нужном слоте уникальную цепочку с требуемыми данными.
-    c_hash_multiset_chain *select_chain = _hash_multiset->slots[presented_hash];
+// Освобождает все блоки пула разом, все выделенные из пула объекты становятся недействительными.
+static void pool_release(const c_hash_multiset *const _hash_multiset,
+                         c_hash_multiset_pool *const _pool)
+{
+    c_hash_multiset_slab *select_slab = _pool->slabs,
+                         *delete_slab;
+    while (select_slab != NULL)
+    {
+        delete_slab = select_slab;
+        select_slab = select_slab->next_slab;
+        memory_free(_hash_multiset, delete_slab);
+    }
 
-    while(select_chain != NULL)
+    pool_init(_pool, _pool->object_size);
+}
+
+// Возвращает пулу все объекты разом: последний (самый большой) блок сохраняется для повторного
+// использования, остальные блоки освобождаются. Все выделенные из пула объекты становятся недействительными.
+static void pool_recycle(const c_hash_multiset *const _hash_multiset,
+                         c_hash_multiset_pool *const _pool)
+{
+    c_hash_multiset_slab *const keep_slab = _pool->slabs;
+    if (keep_slab == NULL) return;
+
+    c_hash_multiset_slab *select_slab = keep_slab->next_slab,
+                         *delete_slab;
+    while (select_slab != NULL)
+    {
+        delete_slab = select_slab;
+        select_slab = select_slab->next_slab;
+        memory_free(_hash_multiset, delete_slab);
+    }
+
+    keep_slab->next_slab = NULL;
+    _pool->free_list = NULL;
+    _pool->free_begin = (uint8_t*)keep_slab + C_HASH_MULTISET_SLAB_HEADER;
+    _pool->free_end = _pool->free_begin + keep_slab->capacity * _pool->object_size;
+}
+
+// Возвращает конец размеченной части блока пула: неразмеченная часть есть только у последнего блока.
+static const uint8_t *pool_slab_end(const c_hash_multiset_pool *const _pool,
+                                    const c_hash_multiset_slab *const _slab)
+{
+    if ( (_slab == _pool->slabs) && (_pool->free_begin != _pool->free_end) )
+    {
+        return _pool->free_begin;
+    }
+    return (const uint8_t*)_slab + C_HASH_MULTISET_SLAB_HEADER + _slab->capacity * _pool->object_size;
+}
+
+// Возвращает количество размеченных объектов пула (занятых и свободных).
+static size_t pool_carved(const c_hash_multiset_pool *const _pool)
+{
+    size_t count = 0;
+    for (const c_hash_multiset_slab *select_slab = _pool->slabs; select_slab != NULL; select_slab = select_slab->next_slab)
+    {
+        const uint8_t *const objects = (const uint8_t*)select_slab + C_HASH_MULTISET_SLAB_HEADER;
+        count += (size_t)(pool_slab_end(_pool, select_slab) - objects) / _pool->object_size;
+    }
+    return count;
+}
+
+// Передает пулу _pool все блоки пула _source (вместе со свободными объектами),
+// после чего _source становится пустым.
+// Оба пула должны принадлежать хэш-мультимножествам с одним распределителем.
+static void pool_adopt(c_hash_multiset_pool *const _pool,
+                       c_hash_multiset_pool *const _source)
+{
+    if (_source->slabs != NULL)
     {
-        if (hash == select_chain->hash)
+        // Блоки добавляются в конец списка, чтобы последний блок пула остался прежним.
+        c_hash_multiset_slab **tail_slab = &_pool->slabs;
+        while (*tail_slab != NULL)
         {
-            if (_hash_multiset->comp_data(_data, select_chain->head->data) > 0)
-            {
-                break;
-            }
+            tail_slab = &(*tail_slab)->next_slab;
         }
-        select_chain = select_chain->next_chain;
+        *tail_slab = _source->slabs;
     }
 
-    // Если цепочки не существует, то создаем ее.
-    size_t created = 0;
-    if (select_chain == NULL)
+    // Неразмеченная часть последнего блока _source становится недоступной до удаления,
+    // вместимость блока сокращается до размеченной части (все объекты блоков пула размечены).
+    if (_source->free_begin != _source->free_end)
     {
-        created = 1;
-        // Попытаемся создать цепочку.
-        c_hash_multiset_chain *const new_chain = malloc(sizeof(c_hash_multiset_chain));
-        if (new_chain == NULL)
+        const uint8_t *const objects = (const uint8_t*)_source->slabs + C_HASH_MULTISET_SLAB_HEADER;
+        _source->slabs->capacity = (size_t)(_source->free_begin - objects) / _source->object_size;
+    }
+    if (_source->free_list != NULL)
+    {
+        void **tail_object = &_source->free_list;
+        while (*tail_object != NULL)
         {
-            return -7;
+            tail_object = (void**)*tail_object;
         }
+        *tail_object = _pool->free_list;
+        _pool->free_list = _source->free_list;
+    }
 
-        // Встроим цепочку в слот.
-        new_chain->next_chain = _hash_multiset->slots[presented_hash];
-        _hash_multiset->slots[presented_hash] = new_chain;
-
-        // Установим параметры цепи.
-        new_chain->head = NULL;
-        new_chain->count = 0;
-        new_chain->hash = hash;
+    pool_init(_source, _source->object_size);
+}
 
-        // Цепей стало больше.
-        ++_hash_multiset->uniques_count;
+// Размечает в пуле место под _count объектов одним блоком (если в последнем блоке места меньше),
+// так что следующие _count выделений не обращаются к распределителю.
+// Неразмеченная часть прежнего последнего блока отбрасывается, его вместимость сокращается
+// до размеченной части.
+// Если места достаточно, возвращает 0.
+// Если выделен блок, возвращает > 0.
+// В случае ошибки возвращает < 0, пул не изменяется.
+static ptrdiff_t pool_reserve(const c_hash_multiset *const _hash_multiset,
+                              c_hash_multiset_pool *const _pool,
+                              const size_t _count)
+{
+    if ((size_t)(_pool->free_end - _pool->free_begin) / _pool->object_size >= _count) return 0;
 
-        select_chain = new_chain;
+    if (_count > (SIZE_MAX - C_HASH_MULTISET_SLAB_HEADER) / _pool->object_size)
+    {
+        return -1;
     }
 
-    // Создадим и вставим узел в требуемую цепочку.
-    // Если узел не удалось создать, и если мы создавали цепочку, то удаляем ее,
-    // потому что пустая цепочка не должна существовать.
+    c_hash_multiset_slab *const new_slab = memory_alloc(_hash_multiset,
+                                                        C_HASH_MULTISET_SLAB_HEADER +
+                                                        _count * _pool->object_size);
+    if (new_slab == NULL)
+    {
+        return -2;
+    }
 
-    // Попытаемся выделить память под узел.
-    c_hash_multiset_node *const new_node = malloc(sizeof(c_hash_multiset_node));
-    if (new_node == NULL)
+    if (_pool->free_begin != _pool->free_end)
     {
-        if (created == 1)
-        {
-            _hash_multiset->slots[presented_hash] = select_chain->next_chain;
-            free(select_chain);
-            --_hash_multiset->uniques_count;
-        }
-        return -8;
+        const uint8_t *const objects = (const uint8_t*)_pool->slabs + C_HASH_MULTISET_SLAB_HEADER;
+        _pool->slabs->capacity = (size_t)(_pool->free_begin - objects) / _pool->object_size;
     }
 
-    // Свяжем узел с данными.
-    new_node->data = (void*)_data;
+    new_slab->capacity = _count;
+    new_slab->next_slab = _pool->slabs;
+    _pool->slabs = new_slab;
 
-    // Вставим узел в нужную цепочку.
-    new_node->next_node = select_chain->head;
-    select_chain->head = new_node;
-    ++select_chain->count;
-
-    // Объектов в хэш-мультимножестве стало больше.
-    ++_hash_multiset->nodes_count;
+    _pool->free_begin = (uint8_t*)new_slab + C_HASH_MULTISET_SLAB_HEADER;
+    _pool->free_end = _pool->free_begin + _count * _pool->object_size;
 
     return 1;
 }
 
-// Удаляет из хэш-мультимножества одну единицу заданных данных.
-// В случае успешного удаления возвращает > 0.
-// В случае, если заданных данных в хэш-мультимножестве нет, возвращает 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_multiset_erase(c_hash_multiset *const _hash_multiset,
-                                const void *const _data,
-                                void (*const _del_data)(void *const _data))
+// Связывает узел с данными: при хранении по значению данные копируются в узел.
+static void node_bind(const c_hash_multiset *const _hash_multiset,
+                      c_hash_multiset_node *const _node,
+                      const void *const _data)
 {
-    if (_hash_multiset == NULL) return -1;
-    if (_data == NULL) return -2;
-
-    if (_hash_multiset->uniques_count == 0) return 0;
+    if (_hash_multiset->key_size > 0)
+    {
+        memcpy(_node + 1, _data, _hash_multiset->key_size);
+        _node->data = _node + 1;
+    } else {
+        _node->data = (void*)_data;
+    }
+}
 
-    // Неприведенный хэш искомых данных.
-    const size_t hash = _hash_multiset->hash_data(_data);
+// Возвращает первые данные цепочки (с ними сравниваются искомые данные).
+static const void *chain_first(const c_hash_multiset *const _hash_multiset,
+                               const c_hash_multiset_chain *const _chain)
+{
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+    {
+        return (_chain->count == 1) ? _chain->data : _chain->items->data[0];
+    }
+    return _chain->head->data;
+}
 
-    // Приведенный хэш искомых данных.
-    const size_t presented_hash = hash % _hash_multiset->slots_count;
+// Возвращает i-ые данные цепочки, хранимой массивом.
+static void *chain_item(const c_hash_multiset_chain *const _chain,
+                        const size_t _i)
+{
+    return (_chain->count == 1) ? _chain->data : _chain->items->data[_i];
+}
 
-    // Поиск цепи с заданными данными.
-    c_hash_multiset_chain *select_chain = _hash_multiset->slots[presented_hash],
-                          *prev_chain = NULL;
-    while (select_chain != NULL)
+// Добавляет в цепочку единицу данных.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0, цепочка не изменяется.
+static ptrdiff_t chain_push(c_hash_multiset *const _hash_multiset,
+                            c_hash_multiset_chain *const _chain,
+                            const void *const _data)
+{
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
     {
-        if (hash == select_chain->hash)
+        if (_chain->count == 0)
         {
-            if (_hash_multiset->comp_data(_data, select_chain->head->data) > 0)
+            _chain->data = (void*)_data;
+        } else if (_chain->count == 1) {
+            // Вторая единица: данные переезжают во внешний массив.
+            c_hash_multiset_items *const new_items = memory_alloc(_hash_multiset, sizeof(c_hash_multiset_items) +
+                                                                                  C_HASH_MULTISET_ITEMS_MIN * sizeof(void*));
+            if (new_items == NULL)
             {
-                // Удаляем первый узел из требуемой цепи.
-                c_hash_multiset_node *delete_node = select_chain->head;
-                select_chain->head = select_chain->head->next_node;
-
-                if (_del_data != NULL)
+                return -1;
+            }
+            new_items->capacity = C_HASH_MULTISET_ITEMS_MIN;
+            new_items->data[0] = _chain->data;
+            new_items->data[1] = (void*)_data;
+            _chain->items = new_items;
+        } else {
+            c_hash_multiset_items *select_items = _chain->items;
+            if (_chain->count == select_items->capacity)
+            {
+                // Массив заполнен - удваиваем вместимость.
+                if (select_items->capacity > (SIZE_MAX - sizeof(c_hash_multiset_items)) / sizeof(void*) / 2)
                 {
-                    _del_data( delete_node->data );
+                    return -2;
                 }
-                free(delete_node);
-
-                --select_chain->count;
-                --_hash_multiset->nodes_count;
-
-                // Если цепочка опустела, удаляем ее, сшивая разрыв.
-                if (select_chain->count == 0)
+                const size_t new_capacity = select_items->capacity * 2;
+                c_hash_multiset_items *const new_items = memory_alloc(_hash_multiset, sizeof(c_hash_multiset_items) +
+                                                                                      new_capacity * sizeof(void*));
+                if (new_items == NULL)
                 {
-                    if (prev_chain != NULL)
-                    {
-                        prev_chain->next_chain = select_chain->next_chain;
-                    } else {
-                        _hash_multiset->slots[presented_hash] = select_chain->next_chain;
-                    }
-                    free(select_chain);
-
-                    --_hash_multiset->uniques_count;
+                    return -3;
                 }
-                return 1;
+                new_items->capacity = new_capacity;
+                memcpy(new_items->data, select_items->data, _chain->count * sizeof(void*));
+                memory_free(_hash_multiset, select_items);
+                _chain->items = select_items = new_items;
             }
+            select_items->data[_chain->count] = (void*)_data;
         }
-        prev_chain = select_chain;
-        select_chain = select_chain->next_chain;
+    } else {
+        c_hash_multiset_node *const new_node = pool_alloc(_hash_multiset, &_hash_multiset->nodes_pool);
+        if (new_node == NULL)
+        {
+            return -4;
+        }
+        node_bind(_hash_multiset, new_node, _data);
+        new_node->next_node = _chain->head;
+        _chain->head = new_node;
     }
 
-    return 0;
+    ++_chain->count;
+
+    return 1;
 }
 
-// Задает хэш-мультимножеству новое количество слотов.
-// Позволяет расширить хэш-мультимножество с нулем слотов.
-// Если в хэш-мультимножестве есть хотя бы один элемент, то попытка задать нулевое количество слотов считается
-// ошибкой.
-// Если хэш-мультимножество перестраивается, функция возвращает > 0.
-// Если не перестраивается, функция возвращает 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_multiset_resize(c_hash_multiset *const _hash_multiset,
-                                 const size_t _slots_count)
+// Удаляет из цепочки одну единицу данных: при хранении узлами - первый узел,
+// при хранении массивом - последнюю единицу массива.
+static void chain_pop(c_hash_multiset *const _hash_multiset,
+                      c_hash_multiset_chain *const _chain,
+                      void (*const _del_data)(void *const _data))
 {
-    if (_hash_multiset == NULL) return -1;
-
-    if (_slots_count == _hash_multiset->slots_count) return 0;
-
-    if (_slots_count == 0)
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
     {
-        if (_hash_multiset->uniques_count != 0)
+        if (_chain->count == 1)
         {
-            return -2;
+            if (_del_data != NULL)
+            {
+                _del_data( _chain->data );
+            }
+            _chain->data = NULL;
+        } else {
+            c_hash_multiset_items *const select_items = _chain->items;
+            if (_del_data != NULL)
+            {
+                _del_data( select_items->data[_chain->count - 1] );
+            }
+            // Осталась одна единица: она возвращается в цепочку, массив освобождается.
+            if (_chain->count == 2)
+            {
+                _chain->data = select_items->data[0];
+                memory_free(_hash_multiset, select_items);
+            }
         }
-
-        free(_hash_multiset->slots);
-        _hash_multiset->slots = NULL;
-
-        _hash_multiset->slots_count = 0;
-
-        return 1;
     } else {
-        const size_t new_slots_size = _slots_count * sizeof(c_hash_multiset_chain*);
-        if ( (new_slots_size == 0) ||
-             (new_slots_size / _slots_count != sizeof(c_hash_multiset_chain*)) )
-        {
-            return -3;
-        }
-
-        c_hash_multiset_chain **const new_slots = malloc(new_slots_size);
-        if (new_slots == NULL)
+        c_hash_multiset_node *const delete_node = _chain->head;
+        _chain->head = delete_node->next_node;
+        if (_del_data != NULL)
         {
-            return -4;
+            _del_data( delete_node->data );
         }
+        pool_free(&_hash_multiset->nodes_pool, delete_node);
+    }
 
-        memset(new_slots, 0, new_slots_size);
+    --_chain->count;
+}
 
-        // Если есть уникальные цепочки, которые необходимо перенести.
-        if (_hash_multiset->uniques_count > 0)
+// Удаляет все данные цепочки и освобождает их память (количество в цепочке не изменяется).
+static void chain_drop(c_hash_multiset *const _hash_multiset,
+                       c_hash_multiset_chain *const _chain,
+                       void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+    {
+        if (_del_data != NULL)
         {
-            size_t count = _hash_multiset->uniques_count;
-            for (size_t s = 0; (s < _hash_multiset->slots_count)&&(count > 0); ++s)
+            for (size_t i = 0; i < _chain->count; ++i)
             {
-                if (_hash_multiset->slots[s] != NULL)
-                {
-                    c_hash_multiset_chain *select_chain = _hash_multiset->slots[s],
-                                          *relocate_chain;
-                    while (select_chain != NULL)
-                    {
-                        relocate_chain = select_chain;
-                        select_chain = select_chain->next_chain;
-
-                        // Хэш цепочки, приведенный к новому количеству слотов.
-                        const size_t presented_hash = relocate_chain->hash % _slots_count;
-
-                        // Перенос цепочки.
-                        relocate_chain->next_chain = new_slots[presented_hash];
-                        new_slots[presented_hash] = relocate_chain;
-
-                        --count;
-                    }
-                }
+                _del_data( chain_item(_chain, i) );
             }
-
         }
+        if (_chain->count > 1)
+        {
+            memory_free(_hash_multiset, _chain->items);
+        }
+        return;
+    }
 
-        free(_hash_multiset->slots);
-
-        // Используем новые слоты.
-        _hash_multiset->slots = new_slots;
-        _hash_multiset->slots_count = _slots_count;
-
-        return 2;
+    c_hash_multiset_node *select_node = _chain->head,
+                         *delete_node;
+    while (select_node != NULL)
+    {
+        delete_node = select_node;
+        select_node = select_node->next_node;
+        if (_del_data != NULL)
+        {
+            _del_data( delete_node->data );
+        }
+        pool_free(&_hash_multiset->nodes_pool, delete_node);
     }
 }
 
-// Проверяет наличие заданных данных в хэш-мультимножестве.
-// Если данные есть, возвращает > 0.
-// Если данных нет, возвращает 0.
-// В случае ошибки возвращает < 0.
-ptrdiff_t c_hash_multiset_check(const c_hash_multiset *const _hash_multiset,
-                                const void *const _data)
+// Если загруженность упала ниже минимальной, уменьшает количество слотов так, чтобы загруженность
+// оказалась посередине между минимальной и максимальной, - так сжатие и расширение не сменяют друг друга
+// на каждой операции.
+// Незаконченное постепенное перестроение при сжатии завершается (при низкой загруженности
+// это дешево), иначе хэш-мультимножество, из которого только удаляют, держало бы оба массива слотов.
+// Если сжать не удалось, хэш-мультимножество просто остается прежнего размера.
+static void shrink(c_hash_multiset *const _hash_multiset)
 {
-    if (_hash_multiset == NULL) return -1;
-    if (_data == NULL) return -2;
-
-    if (_hash_multiset->uniques_count == 0) return 0;
-
-    // Неприведенный хэш данных.
-    const size_t hash = _hash_multiset->hash_data(_data);
+    if (_hash_multiset->min_load_factor <= 0.0f) return;
+    if (_hash_multiset->slots_count <= C_HASH_MULTISET_SHRINK_MIN) return;
 
-    // Приведенный хэш.
-    const size_t presented_hash = hash % _hash_multiset->slots_count;
+    const float load_factor = (float)_hash_multiset->uniques_count / _hash_multiset->slots_count;
+    if (load_factor >= _hash_multiset->min_load_factor) return;
 
-    const c_hash_multiset_chain *select_chain = _hash_multiset->slots[presented_hash];
-    while (select_chain != NULL)
+    const float target_load_factor = (_hash_multiset->min_load_factor + _hash_multiset->max_load_factor) / 2.0f;
+    size_t new_slots_count = (size_t)(_hash_multiset->uniques_count / target_load_factor) + 1;
+    if (new_slots_count < C_HASH_MULTISET_SHRINK_MIN)
     {
-        if (hash == select_chain->hash)
-        {
-            if (_hash_multiset->comp_data(_data, select_chain->head->data) > 0)
-            {
-                return 1;
-            }
-        }
-        select_chain = select_chain->next_chain;
+        new_slots_count = C_HASH_MULTISET_SHRINK_MIN;
     }
 
-    return 0;
+    c_hash_multiset_resize(_hash_multiset, new_slots_count);
 }
 
-// Возвращает количество заданных данных в хэш-мультимножестве.
-// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
-// код причины ошибки (> 0).
-// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
-// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
-size_t c_hash_multiset_data_count(const c_hash_multiset *const _hash_multiset,
-                                  const void *const _data,
-                                  size_t *const _error)
+// Возвращает номер младшего установленного бита маски (маска != 0).
+static size_t bit_first(const uint32_t _mask)
 {
-    if (_hash_multiset == NULL)
+#if defined(__GNUC__)
+    return (size_t)__builtin_ctz(_mask);
+#else
+    size_t b = 0;
+    while ( ((_mask >> b) & 1) == 0 )
     {
-        error_set(_error, 1);
-        return 0;
+        ++b;
     }
-    if (_data == NULL)
+    return b;
+#endif
+}
+
+// Возвращает битовую маску байтов группы, равных заданному.
+static uint32_t group_match(const uint8_t *const _group,
+                            const uint8_t _byte)
+{
+#if defined(C_HASH_MULTISET_SSE2)
+    const __m128i group = _mm_loadu_si128((const __m128i*)_group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)_byte)));
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < C_HASH_MULTISET_GROUP; ++i)
     {
-        error_set(_error, 2);
-        return 0;
+        if (_group[i] == _byte)
+        {
+            mask |= (uint32_t)1 << i;
+        }
     }
+    return mask;
+#endif
+}
 
-    if (_hash_multiset->uniques_count == 0) return 0;
+// Возвращает битовую маску незанятых (пустых или удаленных) позиций группы.
+static uint32_t group_match_free(const uint8_t *const _group)
+{
+#if defined(C_HASH_MULTISET_SSE2)
+    const __m128i group = _mm_loadu_si128((const __m128i*)_group);
+    return (uint32_t)_mm_movemask_epi8(group);
+#else
+    uint32_t mask = 0;
+    for (size_t i = 0; i < C_HASH_MULTISET_GROUP; ++i)
+    {
+        if ( (_group[i] & C_HASH_MULTISET_CTRL_EMPTY) != 0 )
+        {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+    return mask;
+#endif
+}
 
-    // Неприведенный хэш искомых данных.
-    const size_t hash = _hash_multiset->hash_data(_data);
+// Перемешивает хэш пользователя, чтобы и отпечаток, и номер группы зависели от всех его битов.
+static uint64_t flat_mix(const size_t _hash)
+{
+    uint64_t mix = (uint64_t)_hash * UINT64_C(0x9E3779B97F4A7C15);
+    mix ^= mix >> 32;
+    return mix;
+}
 
-    // Приведенный хэш.
-    const size_t presented_hash = hash % _hash_multiset->slots_count;
+// Ищет запись уникальных данных в плоской таблице.
+// Если запись найдена, возвращает ее номер, иначе возвращает SIZE_MAX.
+static size_t flat_find(const c_hash_multiset *const _hash_multiset,
+                        const void *const _data,
+                        const size_t _hash)
+{
+    const uint64_t mix = flat_mix(_hash);
+    const uint8_t fingerprint = (uint8_t)(mix & C_HASH_MULTISET_CTRL_H2);
+    const size_t groups_mask = _hash_multiset->slots_count / C_HASH_MULTISET_GROUP - 1;
 
-    const c_hash_multiset_chain *select_chain = _hash_multiset->slots[presented_hash];
-    while (select_chain != NULL)
+    size_t g = (size_t)(mix >> 7) & groups_mask;
+    for (size_t step = 1; ; ++step)
     {
-        if (hash == select_chain->hash)
+        const uint8_t *const group = _hash_multiset->flat_ctrl + g * C_HASH_MULTISET_GROUP;
+
+        uint32_t matches = group_match(group, fingerprint);
+        while (matches != 0)
         {
-            if (_hash_multiset->comp_data(_data, select_chain->head->data) > 0)
+            const size_t e = g * C_HASH_MULTISET_GROUP + bit_first(matches);
+            const c_hash_multiset_chain *const entry = &_hash_multiset->flat_entries[e];
+            if (entry->hash == _hash)
             {
-                return select_chain->count;
+                if (C_HASH_MULTISET_COMP_DATA(_hash_multiset, _data, chain_first(_hash_multiset, entry)) > 0)
+                {
+                    return e;
+                }
             }
+            matches &= matches - 1;
         }
 
-        select_chain = select_chain->next_chain;
-    }
+        // Пустая позиция в группе означает, что дальше искомых данных быть не может.
+        if (group_match(group, C_HASH_MULTISET_CTRL_EMPTY) != 0)
+        {
+            return SIZE_MAX;
+        }
 
-    return 0;
+        g = (g + step) & groups_mask;
+    }
 }
 
-// Проходит по всем данным хэш-мультимножества и выполняет над ними заданные действия.
-// В случае успешного выполнения возвращает > 0.
-// В случае, если в хэш-мультимножестве нет элементов, возвращает 0.
-// В случае ошибки < 0.
-ptrdiff_t c_hash_multiset_for_each(const c_hash_multiset *const _hash_multiset,
-                                   void (*const _action_data)(const void *const _data))
+// Ищет в плоской таблице первую незанятую позицию для заданного хэша.
+// В таблице обязана быть хотя бы одна пустая позиция.
+static size_t flat_find_free(const c_hash_multiset *const _hash_multiset,
+                             const uint64_t _mix)
 {
-    if (_hash_multiset == NULL) return -1;
-    if (_action_data == NULL) return -2;
+    const size_t groups_mask = _hash_multiset->slots_count / C_HASH_MULTISET_GROUP - 1;
 
-    if (_hash_multiset->uniques_count == 0) return 0;
-
-    size_t count = _hash_multiset->uniques_count;
-    for (size_t s = 0; (s < _hash_multiset->slots_count)&&(count > 0); ++s)
+    size_t g = (size_t)(_mix >> 7) & groups_mask;
+    for (size_t step = 1; ; ++step)
     {
-        if (_hash_multiset->slots[s] != NULL)
+        const uint32_t free_mask = group_match_free(_hash_multiset->flat_ctrl + g * C_HASH_MULTISET_GROUP);
+        if (free_mask != 0)
         {
-            const c_hash_multiset_chain *select_chain = _hash_multiset->slots[s];
-            while (select_chain != NULL)
-            {
-                const c_hash_multiset_node *select_node = select_chain->head;
-                while (select_node != NULL)
-                {
-                    _action_data( select_node->data );
-                    select_node = select_node->next_node;
-                }
-                select_chain = select_chain->next_chain;
-                --count;
-            }
+            return g * C_HASH_MULTISET_GROUP + bit_first(free_mask);
         }
+        g = (g + step) & groups_mask;
     }
+}
 
-    return 1;
+// Освобождает запись плоской таблицы.
+// Если в группе записи есть пустая позиция, поиск все равно остановился бы на этой группе,
+// поэтому позицию можно сразу сделать пустой, иначе она помечается удаленной.
+static void flat_vacate(c_hash_multiset *const _hash_multiset,
+                        const size_t _e)
+{
+    uint8_t *const group = _hash_multiset->flat_ctrl + (_e / C_HASH_MULTISET_GROUP) * C_HASH_MULTISET_GROUP;
+    if (group_match(group, C_HASH_MULTISET_CTRL_EMPTY) != 0)
+    {
+        _hash_multiset->flat_ctrl[_e] = C_HASH_MULTISET_CTRL_EMPTY;
+    } else {
+        _hash_multiset->flat_ctrl[_e] = C_HASH_MULTISET_CTRL_DELETED;
+        ++_hash_multiset->flat_tombstones;
+    }
+    --_hash_multiset->uniques_count;
 }
 
-// Очищает хэш-мультимножество ото всех данных, количество слотов сохраняется.
-// В случае успешного очищения возвращает > 0.
-// Если очищать не от чего, возвращает 0.
-// В случае ошибвки возвращает < 0.
-ptrdiff_t c_hash_multiset_clear(c_hash_multiset *const _hash_multiset,
-                                void (*const _del_data)(void *const _data))
+// Приводит количество слотов плоской таблицы к степени двойки групп.
+// В случае переполнения возвращает 0.
+static size_t flat_round(const size_t _slots_count)
 {
-    if (_hash_multiset == NULL) return -1;
+    size_t slots_count = C_HASH_MULTISET_GROUP;
+    while (slots_count < _slots_count)
+    {
+        if (slots_count > SIZE_MAX / 2)
+        {
+            return 0;
+        }
+        slots_count *= 2;
+    }
+    return slots_count;
+}
 
-    if (_hash_multiset->uniques_count == 0) return 0;
+// Перестраивает плоскую таблицу под заданное (уже приведенное) количество слотов.
+// Удаленные позиции при этом исчезают.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t flat_rehash(c_hash_multiset *const _hash_multiset,
+                             const size_t _slots_count)
+{
+    const size_t entry_size = sizeof(c_hash_multiset_chain) + 1;
+    if (_slots_count > SIZE_MAX / entry_size)
+    {
+        return -1;
+    }
 
-    size_t count = _hash_multiset->uniques_count;
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_RESIZE);
 
-    // Макросы дублирования кода для исключения првоерок из циклов.
-
-    // Открытие циклов.
-    #define C_HASH_MULTISET_CLEAR_BEGIN\
-    for (size_t s = 0; (s < _hash_multiset->slots_count)&&(count > 0); ++s)\
-    {\
-        if (_hash_multiset->slots[s] != NULL)\
-        {\
-            c_hash_multiset_chain *select_chain = _hash_multiset->slots[s],\
-                                  *delete_chain;\
-            while (select_chain != NULL)\
-            {\
-                delete_chain = select_chain;\
-                select_chain = select_chain->next_chain;\
-                c_hash_multiset_node *select_node = delete_chain->head,\
-                                     *delete_node;\
-                while (select_node != NULL)\
-                {\
-                    delete_node = select_node;\
-                    select_node = select_node->next_node;
+    // Записи и управляющие байты размещаются одним блоком.
+    c_hash_multiset_chain *const new_entries = memory_alloc(_hash_multiset, _slots_count * entry_size);
+    if (new_entries == NULL)
+    {
+        C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_RESIZE);
+        return -2;
+    }
+    uint8_t *const new_ctrl = (uint8_t*)(new_entries + _slots_count);
+    memset(new_ctrl, C_HASH_MULTISET_CTRL_EMPTY, _slots_count);
+
+    uint8_t *const old_ctrl = _hash_multiset->flat_ctrl;
+    c_hash_multiset_chain *const old_entries = _hash_multiset->flat_entries;
+    const size_t old_slots_count = _hash_multiset->slots_count;
+
+    _hash_multiset->flat_ctrl = new_ctrl;
+    _hash_multiset->flat_entries = new_entries;
+    _hash_multiset->slots_count = _slots_count;
+    _hash_multiset->flat_tombstones = 0;
 
-    // Закрытие циклов.
-    #define C_HASH_MULTISET_CLEAR_END\
-                    free(delete_node);\
-                }\
-                free(delete_chain);\
-                --count;\
-            }\
-            _hash_multiset->slots[s] = NULL;\
-        }\
+    // Первое размещение слотов перестроением не считается.
+    if (old_slots_count > 0)
+    {
+        C_HASH_MULTISET_COUNT(_hash_multiset, resizes);
     }
 
-    // Функция удаления данных задана.
-    if (_del_data != NULL)
+    // Переносим записи, хэш заново не вычисляется.
+    size_t count = _hash_multiset->uniques_count;
+    for (size_t e = 0; (e < old_slots_count)&&(count > 0); ++e)
     {
-        C_HASH_MULTISET_CLEAR_BEGIN
+        if ( (old_ctrl[e] & C_HASH_MULTISET_CTRL_EMPTY) == 0 )
+        {
+            const uint64_t mix = flat_mix(old_entries[e].hash);
+            const size_t n = flat_find_free(_hash_multiset, mix);
+            new_ctrl[n] = (uint8_t)(mix & C_HASH_MULTISET_CTRL_H2);
+            new_entries[n] = old_entries[e];
+            --count;
+        }
+    }
 
-        _del_data( delete_node->data );
+    memory_free(_hash_multiset, old_entries);
 
-        C_HASH_MULTISET_CLEAR_END
-    } else {
-        // Функция удаления данных не задана.
-        C_HASH_MULTISET_CLEAR_BEGIN
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_RESIZE);
+
+    return 1;
+}
 
-        C_HASH_MULTISET_CLEAR_END
+// Занимает свободную позицию плоской таблицы под новую пустую запись с заданным хэшем
+// и возвращает ее номер. В таблице должна быть свободная позиция.
+static size_t flat_occupy(c_hash_multiset *const _hash_multiset,
+                          const size_t _hash)
+{
+    const uint64_t mix = flat_mix(_hash);
+    const size_t e = flat_find_free(_hash_multiset, mix);
+    if (_hash_multiset->flat_ctrl[e] == C_HASH_MULTISET_CTRL_DELETED)
+    {
+        --_hash_multiset->flat_tombstones;
     }
+    _hash_multiset->flat_ctrl[e] = (uint8_t)(mix & C_HASH_MULTISET_CTRL_H2);
 
-    #undef C_HASH_MULTISET_CLEAR_BEGIN
-    #undef C_HASH_MULTISET_CLEAR_END
+    c_hash_multiset_chain *const select_entry = &_hash_multiset->flat_entries[e];
+    select_entry->next_chain = NULL;
+    select_entry->head = NULL;
+    select_entry->count = 0;
+    select_entry->hash = _hash;
 
-    return 1;
+    ++_hash_multiset->uniques_count;
+
+    return e;
 }
 
-// Удаляет из хэш-мультимножества все единицы заданных данных.
-// Возвращает количество удаленных элементов.
-// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
-// код причины ошибки (> 0).
-// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
-// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
-size_t c_hash_multiset_erase_all(c_hash_multiset *const _hash_multiset,
-                                 const void *const _data,
-                                 void (* const _del_data)(void *const _data),
-                                 size_t *const _error)
+// Вставка данных с известным хэшем в плоскую таблицу.
+static ptrdiff_t flat_insert(c_hash_multiset *const _hash_multiset,
+                             const void *const _data,
+                             const size_t _hash)
 {
-    if (_hash_multiset == NULL)
+    // Повтор существующих данных новую позицию не занимает и таблицу не расширяет.
+    size_t e = SIZE_MAX;
+    if (_hash_multiset->uniques_count > 0)
+    {
+        e = flat_find(_hash_multiset, _data, _hash);
+    }
+
+    if (e == SIZE_MAX)
+    {
+        // Позиции, занятые и удаленные, вместе не должны превышать предел загруженности.
+        if (_hash_multiset->slots_count == 0)
+        {
+            if (flat_rehash(_hash_multiset, flat_round(C_HASH_MULTISET_0)) < 0)
+            {
+                return -3;
+            }
+        } else {
+            const size_t used = _hash_multiset->uniques_count + _hash_multiset->flat_tombstones + 1;
+            if ((float)used > _hash_multiset->slots_count * _hash_multiset->max_load_factor)
+            {
+                // Если удаленных позиций много, достаточно перестроить таблицу того же размера.
+                size_t new_slots_count = _hash_multiset->slots_count;
+                if (_hash_multiset->flat_tombstones < _hash_multiset->uniques_count / 2)
+                {
+                    new_slots_count = flat_round((size_t)(_hash_multiset->slots_count * _hash_multiset->growth_factor) + 1);
+                    if (new_slots_count <= _hash_multiset->slots_count)
+                    {
+                        return -4;
+                    }
+                }
+                if (flat_rehash(_hash_multiset, new_slots_count) < 0)
+                {
+                    return -6;
+                }
+            }
+        }
+
+        e = flat_occupy(_hash_multiset, _hash);
+    }
+    c_hash_multiset_chain *const select_entry = &_hash_multiset->flat_entries[e];
+
+    // Если данные не удалось добавить в новую запись, запись освобождается - пустой она существовать не должна.
+    if (chain_push(_hash_multiset, select_entry, _data) < 0)
+    {
+        if (select_entry->count == 0)
+        {
+            flat_vacate(_hash_multiset, e);
+        }
+        return -8;
+    }
+
+    ++_hash_multiset->nodes_count;
+
+    return 1;
+}
+
+// Удаляет из плоской таблицы одну единицу заданных данных.
+static ptrdiff_t flat_erase(c_hash_multiset *const _hash_multiset,
+                            const void *const _data,
+                            const size_t _hash,
+                            void (*const _del_data)(void *const _data))
+{
+    const size_t e = flat_find(_hash_multiset, _data, _hash);
+    if (e == SIZE_MAX)
     {
-        error_set(_error, 1);
         return 0;
     }
-    if (_data == NULL)
+
+    c_hash_multiset_chain *const select_entry = &_hash_multiset->flat_entries[e];
+
+    chain_pop(_hash_multiset, select_entry, _del_data);
+
+    --_hash_multiset->nodes_count;
+
+    if (select_entry->count == 0)
+    {
+        flat_vacate(_hash_multiset, e);
+        shrink(_hash_multiset);
+    }
+
+    return 1;
+}
+
+// Удаляет из плоской таблицы все единицы заданных данных.
+static size_t flat_erase_all(c_hash_multiset *const _hash_multiset,
+                             const void *const _data,
+                             const size_t _hash,
+                             void (*const _del_data)(void *const _data))
+{
+    const size_t e = flat_find(_hash_multiset, _data, _hash);
+    if (e == SIZE_MAX)
     {
-        error_set(_error, 2);
         return 0;
     }
 
-    if (_hash_multiset->uniques_count == 0)
+    c_hash_multiset_chain *const select_entry = &_hash_multiset->flat_entries[e];
+
+    chain_drop(_hash_multiset, select_entry, _del_data);
+
+    const size_t count = select_entry->count;
+    _hash_multiset->nodes_count -= count;
+
+    flat_vacate(_hash_multiset, e);
+    shrink(_hash_multiset);
+
+    return count;
+}
+
+// Задает плоской таблице новое количество слотов.
+static ptrdiff_t flat_resize(c_hash_multiset *const _hash_multiset,
+                             const size_t _slots_count)
+{
+    if (_slots_count == 0)
+    {
+        if (_hash_multiset->uniques_count != 0)
+        {
+            return -2;
+        }
+
+        memory_free(_hash_multiset, _hash_multiset->flat_entries);
+        _hash_multiset->flat_entries = NULL;
+        _hash_multiset->flat_ctrl = NULL;
+        _hash_multiset->flat_tombstones = 0;
+
+        _hash_multiset->slots_count = 0;
+
+        return 1;
+    }
+
+    const size_t slots_count = flat_round(_slots_count);
+    if (slots_count == 0)
+    {
+        return -3;
+    }
+    if (slots_count == _hash_multiset->slots_count)
     {
         return 0;
     }
+    // Хотя бы одна позиция должна остаться пустой.
+    if (_hash_multiset->uniques_count >= slots_count)
+    {
+        return -5;
+    }
 
-    // Неприведенный хэш заданных данных.
-    const size_t hash = _hash_multiset->hash_data(_data);
+    if (flat_rehash(_hash_multiset, slots_count) < 0)
+    {
+        return -4;
+    }
 
-    // Приведенный хэш заданных данных.
-    const size_t presented_hash = hash % _hash_multiset->slots_count;
+    return 2;
+}
 
-    if (_hash_multiset->slots[presented_hash] != NULL)
+// Возвращает слот цепочной таблицы, в котором находятся (или должны находиться) данные
+// с заданным хэшем.
+// Во время постепенного перестроения еще не перенесенные слоты старого массива остаются в работе.
+static c_hash_multiset_chain **chained_slot(const c_hash_multiset *const _hash_multiset,
+                                            const size_t _hash)
+{
+    if (_hash_multiset->old_slots != NULL)
     {
-        c_hash_multiset_chain *select_chain = _hash_multiset->slots[presented_hash],
-                              *prev_chain = NULL;
+        const size_t old_presented_hash = slots_reduce(_hash_multiset->growth_policy,
+                                                       _hash,
+                                                       _hash_multiset->old_slots_count,
+                                                       _hash_multiset->old_slots_magic);
+        if (old_presented_hash >= _hash_multiset->migrate_pos)
+        {
+            return &_hash_multiset->old_slots[old_presented_hash];
+        }
+    }
+    return &_hash_multiset->slots[slots_reduce(_hash_multiset->growth_policy,
+                                               _hash,
+                                               _hash_multiset->slots_count,
+                                               _hash_multiset->slots_magic)];
+}
 
+// Переносит в новый массив не более _step слотов старого массива.
+// Когда перенесены все слоты, старый массив освобождается.
+static void migrate(c_hash_multiset *const _hash_multiset,
+                    size_t _step)
+{
+    while ( (_step > 0) && (_hash_multiset->migrate_pos < _hash_multiset->old_slots_count) )
+    {
+        c_hash_multiset_chain *select_chain = _hash_multiset->old_slots[_hash_multiset->migrate_pos],
+                              *relocate_chain;
         while (select_chain != NULL)
         {
-            if (hash == select_chain->hash)
-            {
-                if (_hash_multiset->comp_data(_data, select_chain->head->data) > 0)
-                {
-                    // Удаляем заданную цепь из хэш-мультимножества.
-                    c_hash_multiset_node *select_node = select_chain->head,
-                                         *delete_node;
-
-                    // Макросы дублирования кода для исключения проверки из цикла.
-
-                    // Открытие цикла.
-                    #define C_HASH_MULTISET_ERASE_ALL_BEGIN\
-                    while (select_node != NULL)\
-                    {\
-                        delete_node = select_node;\
-                        select_node = select_node->next_node;
-
-                    // Закрытие цикла.
-                    #define C_HASH_MULTISET_ERASE_ALL_END\
-                        free(delete_node);\
-                    }
-
-                    // Функция удаления данных узла задана.
-                    if (_del_data != NULL)
-                    {
-                        C_HASH_MULTISET_ERASE_ALL_BEGIN
-
-                        _del_data( delete_node->data );
+            relocate_chain = select_chain;
+            select_chain = select_chain->next_chain;
 
-                        C_HASH_MULTISET_ERASE_ALL_END
-                    } else {
-                        // Функция удаления данных узла не задана.
-                        C_HASH_MULTISET_ERASE_ALL_BEGIN
+            // Перенос цепочки, хэш заново не вычисляется.
+            const size_t presented_hash = slots_reduce(_hash_multiset->growth_policy,
+                                                       relocate_chain->hash,
+                                                       _hash_multiset->slots_count,
+                                                       _hash_multiset->slots_magic);
+            relocate_chain->next_chain = _hash_multiset->slots[presented_hash];
+            _hash_multiset->slots[presented_hash] = relocate_chain;
+        }
+        _hash_multiset->old_slots[_hash_multiset->migrate_pos] = NULL;
 
-                        C_HASH_MULTISET_ERASE_ALL_END
-                    }
+        ++_hash_multiset->migrate_pos;
+        --_step;
+    }
 
-                    #undef C_HASH_MULTISET_ERASE_ALL_BEGIN
-                    #undef C_HASH_MULTISET_ERASE_ALL_END
+    if ( (_hash_multiset->old_slots != NULL) &&
+         (_hash_multiset->migrate_pos == _hash_multiset->old_slots_count) )
+    {
+        memory_free(_hash_multiset, _hash_multiset->old_slots);
+        _hash_multiset->old_slots = NULL;
+        _hash_multiset->old_slots_count = 0;
+        _hash_multiset->migrate_pos = 0;
+    }
+}
 
-                    // Уникальных цепей стало меньше на одну.
-                    --_hash_multiset->uniques_count;
-                    // Элементов в хэш-мультимножестве стало меньше на количество элементов удаляемой цепи.
-                    _hash_multiset->nodes_count -= select_chain->count;
-                    // Запоминаем, сколько элементов было удалено.
-                    const size_t count = select_chain->count;
+// Возвращает количество старых слотов, переносимых при вставке: не меньше migrate_step
+// и достаточное, чтобы перестроение закончилось раньше, чем загруженность достигнет предела
+// (каждая новая уникальная цепочка добавляется отдельной вставкой), - иначе следующее расширение
+// завершило бы перестроение целиком за один вызов.
+static size_t migrate_insert_step(const c_hash_multiset *const _hash_multiset)
+{
+    if (_hash_multiset->old_slots == NULL) return _hash_multiset->migrate_step;
 
-                    // Ампутация цепи.
-                    if (prev_chain != NULL)
-                    {
-                        prev_chain->next_chain = select_chain->next_chain;
-                    } else {
-                        _hash_multiset->slots[presented_hash] = select_chain->next_chain;
-                    }
+    const size_t rest = _hash_multiset->old_slots_count - _hash_multiset->migrate_pos;
+    const size_t uniques_max = (size_t)( (double)_hash_multiset->max_load_factor * _hash_multiset->slots_count );
+    const size_t uniques_left = (uniques_max > _hash_multiset->uniques_count + 1) ?
+                                uniques_max - _hash_multiset->uniques_count - 1 : 1;
+    const size_t step = rest / uniques_left + 1;
 
-                    free(select_chain);
+    return (step > _hash_multiset->migrate_step) ? step : _hash_multiset->migrate_step;
+}
 
-                    return count;
-                }
+// Удаляет данные одной цепочки (если _del_data != NULL) и, если _release_items > 0,
+// освобождает ее внешний массив (хранение массивом). Узлы не освобождаются.
+static void del_chain_data(const c_hash_multiset *const _hash_multiset,
+                           const c_hash_multiset_chain *const _chain,
+                           void (*const _del_data)(void *const _data),
+                           const size_t _release_items)
+{
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+    {
+        if (_del_data != NULL)
+        {
+            for (size_t i = 0; i < _chain->count; ++i)
+            {
+                _del_data( chain_item(_chain, i) );
             }
-            prev_chain = select_chain;
-            select_chain = select_chain->next_chain;
         }
+        if ( (_release_items > 0) && (_chain->count > 1) )
+        {
+            memory_free(_hash_multiset, _chain->items);
+        }
+        return;
     }
 
-    return 0;
+    if (_del_data == NULL) return;
+
+    const c_hash_multiset_node *select_node = _chain->head;
+    while (select_node != NULL)
+    {
+        _del_data( select_node->data );
+        select_node = select_node->next_node;
+    }
 }
 
-// Возвращает количество слотов в хэш-мультимножестве.
-// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
-// код причины ошибки (> 0).
-// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
-// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
-size_t c_hash_multiset_slots_count(const c_hash_multiset *const _hash_multiset,
-                                   size_t *const _error)
+// Обходит все цепочки хэш-мультимножества, удаляет их данные (если _del_data != NULL)
+// и, если _release_items > 0, освобождает внешние массивы повторов.
+static void del_all_data(const c_hash_multiset *const _hash_multiset,
+                         void (*const _del_data)(void *const _data),
+                         const size_t _release_items)
 {
-    if (_hash_multiset == NULL)
+    size_t count = _hash_multiset->uniques_count;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
     {
-        error_set(_error, 1);
-        return 0;
+        for (size_t e = 0; (e < _hash_multiset->slots_count)&&(count > 0); ++e)
+        {
+            if ( (_hash_multiset->flat_ctrl[e] & C_HASH_MULTISET_CTRL_EMPTY) == 0 )
+            {
+                del_chain_data(_hash_multiset, &_hash_multiset->flat_entries[e], _del_data, _release_items);
+                --count;
+            }
+        }
+        return;
     }
 
-    return _hash_multiset->slots_count;
+    // Сначала неперенесенная часть старого массива слотов, затем новый массив.
+    for (size_t part = 0; part < 2; ++part)
+    {
+        c_hash_multiset_chain *const *const slots = (part == 0) ? _hash_multiset->old_slots :
+                                                                  _hash_multiset->slots;
+        const size_t slots_end = (part == 0) ? _hash_multiset->old_slots_count :
+                                               _hash_multiset->slots_count;
+        for (size_t s = (part == 0) ? _hash_multiset->migrate_pos : 0; (s < slots_end)&&(count > 0); ++s)
+        {
+            const c_hash_multiset_chain *select_chain = slots[s];
+            while (select_chain != NULL)
+            {
+                del_chain_data(_hash_multiset, select_chain, _del_data, _release_items);
+                select_chain = select_chain->next_chain;
+                --count;
+            }
+        }
+    }
 }
 
-// Возвращает количество узлов (объектов) в хэш-мультимножестве.
-// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
-// код причины ошибки (> 0).
-// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
-// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
-size_t c_hash_multiset_count(const c_hash_multiset *const _hash_multiset,
-                             size_t *const _error)
+// Задача параллельной операции: _task(_argument, i) для одного i.
+typedef struct s_c_hash_multiset_job
 {
-    if (_hash_multiset == NULL)
+    void (*task)(void *const _argument,
+                 const size_t _index);
+    void *argument;
+    size_t index;
+} c_hash_multiset_job;
+
+#if !defined(C_HASH_MULTISET_NO_THREADS)
+// Точка входа потока параллельной операции.
+static void *parallel_thread(void *const _job)
+{
+    const c_hash_multiset_job *const job = _job;
+    job->task(job->argument, job->index);
+    return NULL;
+}
+#endif
+
+// Выполняет _task(_argument, i) для всех i < _count (_count <= C_HASH_MULTISET_THREADS_MAX)
+// и возвращается после завершения всех задач.
+// Если задан исполнитель, задачи передаются ему. Иначе задача 0 выполняется вызывающим потоком,
+// остальные - отдельными потоками; если поток не удалось создать, его задача выполняется
+// вызывающим потоком.
+static void parallel_run(const c_hash_multiset_executor *const _executor,
+                         void (*const _task)(void *const _argument,
+                                             const size_t _index),
+                         void *const _argument,
+                         const size_t _count)
+{
+    if (_executor != NULL)
     {
-        error_set(_error, 1);
-        return 0;
+        _executor->run(_executor->context, _task, _argument, _count);
+        return;
     }
 
-    return _hash_multiset->nodes_count;
+#if !defined(C_HASH_MULTISET_NO_THREADS)
+    c_hash_multiset_job jobs[C_HASH_MULTISET_THREADS_MAX];
+    pthread_t threads[C_HASH_MULTISET_THREADS_MAX];
+    uint8_t started[C_HASH_MULTISET_THREADS_MAX];
+
+    for (size_t i = 1; i < _count; ++i)
+    {
+        jobs[i].task = _task;
+        jobs[i].argument = _argument;
+        jobs[i].index = i;
+        started[i] = (pthread_create(&threads[i], NULL, parallel_thread, &jobs[i]) == 0);
+    }
+
+    _task(_argument, 0);
+
+    for (size_t i = 1; i < _count; ++i)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        } else {
+            _task(_argument, i);
+        }
+    }
+#else
+    for (size_t i = 0; i < _count; ++i)
+    {
+        _task(_argument, i);
+    }
+#endif
 }
 
-// Возвращает количество уникальных объектов в хэш-мультимножестве.
-// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// Заполняет параметры создания хэш-мультимножества значениями по умолчанию.
+void c_hash_multiset_options_init(c_hash_multiset_options *const _options)
+{
+    if (_options == NULL) return;
+
+    _options->allocator = NULL;
+    _options->allocator_context = NULL;
+    _options->engine = C_HASH_MULTISET_ENGINE_CHAINED;
+    _options->migrate_step = 0;
+    _options->growth_policy = C_HASH_MULTISET_GROWTH_MODULO;
+    _options->growth_factor = C_HASH_MULTISET_GROWTH;
+    _options->min_load_factor = 0.0f;
+    _options->key_size = 0;
+    _options->storage = C_HASH_MULTISET_STORAGE_NODES;
+    _options->fast_clear = 0;
+}
+
+// Создает новое хэш-мультимножество.
+// Позволяет создавать хэш-мультимножество с нулем слотов.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
 // код причины ошибки (> 0).
-// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
-// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
-size_t c_hash_multiset_uniques_count(const c_hash_multiset *const _hash_multiset,
-                                     size_t *const _error)
+c_hash_multiset *c_hash_multiset_create(size_t (*const _hash_data)(const void *const _data),
+                                        size_t (*const _comp_data)(const void *const _data_a,
+                                                                   const void *const _data_b),
+                                        const size_t _slots_count,
+                                        const float _max_load_factor,
+                                        size_t *const _error)
 {
-    if (_hash_multiset == NULL)
+    return c_hash_multiset_create_ex(_hash_data, _comp_data, _slots_count, _max_load_factor,
+                                     NULL, _error);
+}
+
+// Создает новое хэш-мультимножество с заданными параметрами.
+// Если _options == NULL, используются параметры по умолчанию.
+// Вся память хэш-мультимножества (включая его самого) выделяется заданным распределителем.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_multiset *c_hash_multiset_create_ex(size_t (*const _hash_data)(const void *const _data),
+                                           size_t (*const _comp_data)(const void *const _data_a,
+                                                                      const void *const _data_b),
+                                           const size_t _slots_count,
+                                           const float _max_load_factor,
+                                           const c_hash_multiset_options *const _options,
+                                           size_t *const _error)
+{
+    c_hash_multiset_options options;
+    if (_options != NULL)
+    {
+        options = *_options;
+    } else {
+        c_hash_multiset_options_init(&options);
+    }
+
+    if (options.allocator == NULL)
+    {
+        options.allocator = &default_allocator;
+    }
+
+    if (_hash_data == NULL)
     {
         error_set(_error, 1);
-        return 0;
+        return NULL;
+    }
+    // Без функции сравнения можно обойтись только при хранении по значению.
+    if ( ( (_comp_data == NULL) && (options.key_size == 0) ) ||
+         (options.key_size > SIZE_MAX / 2) )
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if ( (_max_load_factor < C_HASH_MULTISET_MLF_MIN) ||
+         (_max_load_factor > C_HASH_MULTISET_MLF_MAX) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+    if ( (options.allocator->allocate == NULL) ||
+         (options.allocator->deallocate == NULL) )
+    {
+        error_set(_error, 7);
+        return NULL;
+    }
+    // Хранение массивом несовместимо с хранением по значению: копиям ключей негде лежать.
+    // Быстрая очистка есть только у цепочного движка: плоский обнуляет весь массив меток.
+    if ( ( (options.engine != C_HASH_MULTISET_ENGINE_CHAINED) &&
+           (options.engine != C_HASH_MULTISET_ENGINE_FLAT) ) ||
+         (options.storage > C_HASH_MULTISET_STORAGE_ARRAY) ||
+         ( (options.storage == C_HASH_MULTISET_STORAGE_ARRAY) && (options.key_size > 0) ) ||
+         ( (options.engine == C_HASH_MULTISET_ENGINE_FLAT) && (options.fast_clear != 0) ) )
+    {
+        error_set(_error, 8);
+        return NULL;
+    }
+    if (options.growth_policy > C_HASH_MULTISET_GROWTH_PRIME)
+    {
+        error_set(_error, 9);
+        return NULL;
+    }
+    if ( !(options.growth_factor > 1.0f) ||
+         (options.growth_factor > C_HASH_MULTISET_GROWTH_MAX) )
+    {
+        error_set(_error, 10);
+        return NULL;
     }
 
-    return _hash_multiset->uniques_count;
-}
+    if ( !(options.min_load_factor >= 0.0f) ||
+         (options.min_load_factor > _max_load_factor / 2.0f) )
+    {
+        error_set(_error, 11);
+        return NULL;
+    }
 
-// Возвращает коэф. максимальной загрузки хэш-мультимножества.
-// В случае ошибки возвращает 0.0f.
-float c_hash_multiset_max_load_factor(const c_hash_multiset *const _hash_multiset)
-{
-    if (_hash_multiset == NULL)
+    // Количество слотов, допустимое для политики роста.
+    size_t slots_count = 0;
+    if (_slots_count > 0)
     {
-        return 0.0f;
+        slots_count = (options.engine == C_HASH_MULTISET_ENGINE_FLAT) ?
+                      flat_round(_slots_count) :
+                      slots_round(options.growth_policy, _slots_count);
+        if (slots_count == 0)
+        {
+            error_set(_error, 4);
+            return NULL;
+        }
+    }
+
+    c_hash_multiset_chain **new_slots = NULL;
+
+    if ( (slots_count > 0) && (options.engine == C_HASH_MULTISET_ENGINE_CHAINED) )
+    {
+        const size_t new_slots_size = slots_count * sizeof(c_hash_multiset_chain*);
+        if ( (new_slots_size == 0) ||
+             (new_slots_size / slots_count != sizeof(c_hash_multiset_chain*)) )
+        {
+            error_set(_error, 4);
+            return NULL;
+        }
+
+        new_slots = options.allocator->allocate(options.allocator_context, new_slots_size);
+        if (new_slots == NULL)
+        {
+            error_set(_error, 5);
+            return NULL;
+        }
+
+        memset(new_slots, 0, new_slots_size);
+    }
+
+    c_hash_multiset *const new_hash_multiset = options.allocator->allocate(options.allocator_context,
+                                                                           sizeof(c_hash_multiset));
+    if (new_hash_multiset == NULL)
+    {
+        if (new_slots != NULL)
+        {
+            options.allocator->deallocate(options.allocator_context, new_slots);
+        }
+        error_set(_error, 6);
+        return NULL;
+    }
+
+    new_hash_multiset->hash_data = _hash_data;
+    new_hash_multiset->comp_data = _comp_data;
+
+    new_hash_multiset->slots_count = (new_slots != NULL) ? slots_count : 0;
+    new_hash_multiset->nodes_count = 0;
+    new_hash_multiset->uniques_count = 0;
+
+    new_hash_multiset->max_load_factor = _max_load_factor;
+    new_hash_multiset->min_load_factor = options.min_load_factor;
+
+    new_hash_multiset->slots = new_slots;
+
+    new_hash_multiset->growth_policy = options.growth_policy;
+    new_hash_multiset->growth_factor = options.growth_factor;
+    new_hash_multiset->slots_magic = slots_magic(options.growth_policy, slots_count);
+    new_hash_multiset->old_slots_magic = 0;
+
+    pool_init(&new_hash_multiset->chains_pool, sizeof(c_hash_multiset_chain));
+    // При хранении по значению ключ размещается в узле сразу за ним, размер узла выравнивается до 8 байт.
+    pool_init(&new_hash_multiset->nodes_pool,
+              (options.key_size > 0) ? (sizeof(c_hash_multiset_node) + options.key_size + 7) & ~(size_t)7 :
+                                       sizeof(c_hash_multiset_node));
+    new_hash_multiset->key_size = options.key_size;
+    new_hash_multiset->storage = options.storage;
+    new_hash_multiset->fast_clear = options.fast_clear;
+
+    new_hash_multiset->allocator = *options.allocator;
+    new_hash_multiset->allocator_context = options.allocator_context;
+
+    new_hash_multiset->migrate_step = options.migrate_step;
+    new_hash_multiset->old_slots = NULL;
+    new_hash_multiset->old_slots_count = 0;
+    new_hash_multiset->migrate_pos = 0;
+
+#if defined(C_HASH_MULTISET_COUNTERS)
+    memset(&new_hash_multiset->counters, 0, sizeof(new_hash_multiset->counters));
+#endif
+
+#if defined(C_HASH_MULTISET_LATENCY)
+    memset(&new_hash_multiset->hooks, 0, sizeof(c_hash_multiset_hooks));
+    memset(new_hash_multiset->latency, 0, sizeof(new_hash_multiset->latency));
+#endif
+
+    new_hash_multiset->engine = options.engine;
+    new_hash_multiset->flat_ctrl = NULL;
+    new_hash_multiset->flat_entries = NULL;
+    new_hash_multiset->flat_tombstones = 0;
+
+    if (options.engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        if (new_hash_multiset->max_load_factor > C_HASH_MULTISET_FLAT_MLF_MAX)
+        {
+            new_hash_multiset->max_load_factor = C_HASH_MULTISET_FLAT_MLF_MAX;
+        }
+
+        if (slots_count > 0)
+        {
+            if (flat_rehash(new_hash_multiset, slots_count) < 0)
+            {
+                options.allocator->deallocate(options.allocator_context, new_hash_multiset);
+                error_set(_error, 5);
+                return NULL;
+            }
+        }
+    }
+
+    return new_hash_multiset;
+}
+
+// Удаляет хэш-мультимножество.
+// Цепочки и узлы не освобождаются по одному, а возвращаются вместе с блоками пулов.
+// Если распределитель умеет освобождать все блоки разом, вся память хэш-мультимножества
+// возвращается одним вызовом release, без обхода слотов (если _del_data == NULL).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_delete(c_hash_multiset *const _hash_multiset,
+                                 void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+
+    if (_hash_multiset->allocator.release != NULL)
+    {
+        if (_del_data != NULL)
+        {
+            del_all_data(_hash_multiset, _del_data, 0);
+        }
+
+        _hash_multiset->allocator.release(_hash_multiset->allocator_context);
+
+        return 1;
+    }
+
+    if (c_hash_multiset_clear(_hash_multiset, _del_data) < 0)
+    {
+        return -1;
+    }
+
+    // Блоки, сохраненные быстрой очисткой.
+    pool_release(_hash_multiset, &_hash_multiset->chains_pool);
+    pool_release(_hash_multiset, &_hash_multiset->nodes_pool);
+
+    memory_free(_hash_multiset, _hash_multiset->slots);
+    memory_free(_hash_multiset, _hash_multiset->flat_entries);
+    memory_free(_hash_multiset, _hash_multiset->old_slots);
+
+    memory_free(_hash_multiset, _hash_multiset);
+
+    return 1;
+}
+
+// Вставка данных с известным хэшем в хэш-мультимножество.
+// В случае успешной вставки возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t insert_hashed(c_hash_multiset *const _hash_multiset,
+                               const void *const _data,
+                               const size_t _hash)
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        return flat_insert(_hash_multiset, _data, _hash);
+    }
+
+    // Продолжаем постепенное перестроение.
+    migrate(_hash_multiset, migrate_insert_step(_hash_multiset));
+
+    // Первым делом контролируем процесс увеличения количества слотов.
+
+    // Если слотов нет вообще.
+    if (_hash_multiset->slots_count == 0)
+    {
+        // Пытаемся расширить слоты.
+        if (c_hash_multiset_resize(_hash_multiset, C_HASH_MULTISET_0) <= 0)
+        {
+            return -3;
+        }
+    } else {
+        // Если слоты есть, то при достижении предела загруженности увеличиваем количество слотов.
+        const float load_factor = (float)_hash_multiset->uniques_count / _hash_multiset->slots_count;
+        if (load_factor >= _hash_multiset->max_load_factor)
+        {
+            // Определим новое количество слотов.
+            size_t new_slots_count = (size_t)(_hash_multiset->slots_count * _hash_multiset->growth_factor);
+            if (new_slots_count < _hash_multiset->slots_count)
+            {
+                return -4;
+            }
+            new_slots_count += 1;
+            if (new_slots_count == 0)
+            {
+                return -5;
+            }
+
+            // Пытаемся расширить слоты.
+            if (c_hash_multiset_resize(_hash_multiset, new_slots_count) < 0)
+            {
+                return -6;
+            }
+        }
+    }
+    // Вставляем данные в хэш-мультимножество.
+
+    // Слот, в котором находятся (или должны находиться) данные.
+    c_hash_multiset_chain **const slot = chained_slot(_hash_multiset, _hash);
+
+    // Попытаемся найти в нужном слоте уникальную цепочку с требуемыми данными.
+    c_hash_multiset_chain *select_chain = *slot;
+
+    while(select_chain != NULL)
+    {
+        if (_hash == select_chain->hash)
+        {
+            if (C_HASH_MULTISET_COMP_DATA(_hash_multiset, _data, chain_first(_hash_multiset, select_chain)) > 0)
+            {
+                break;
+            }
+        }
+        select_chain = select_chain->next_chain;
+    }
+
+    // Если цепочки не существует, то создаем ее.
+    size_t created = 0;
+    if (select_chain == NULL)
+    {
+        created = 1;
+        // Попытаемся создать цепочку.
+        c_hash_multiset_chain *const new_chain = pool_alloc(_hash_multiset, &_hash_multiset->chains_pool);
+        if (new_chain == NULL)
+        {
+            return -7;
+        }
+
+        // Встроим цепочку в слот.
+        new_chain->next_chain = *slot;
+        *slot = new_chain;
+
+        // Установим параметры цепи.
+        new_chain->head = NULL;
+        new_chain->count = 0;
+        new_chain->hash = _hash;
+
+        // Цепей стало больше.
+        ++_hash_multiset->uniques_count;
+
+        select_chain = new_chain;
+    }
+
+    // Добавим данные в требуемую цепочку.
+    // Если данные не удалось добавить, и если мы создавали цепочку, то удаляем ее,
+    // потому что пустая цепочка не должна существовать.
+    if (chain_push(_hash_multiset, select_chain, _data) < 0)
+    {
+        if (created == 1)
+        {
+            *slot = select_chain->next_chain;
+            pool_free(&_hash_multiset->chains_pool, select_chain);
+            --_hash_multiset->uniques_count;
+        }
+        return -8;
+    }
+
+    // Объектов в хэш-мультимножестве стало больше.
+    ++_hash_multiset->nodes_count;
+
+    return 1;
+}
+
+// Вставка данных в хэш-мультимножество.
+// В случае успешной вставки возвращает > 0, данные захватываются хэш-мультимножеством.
+// В случае ошибки возвращает < 0, данные не захватываются хэш-мультимножеством.
+ptrdiff_t c_hash_multiset_insert(c_hash_multiset *const _hash_multiset,
+                                 const void *const _data)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_INSERT);
+    const ptrdiff_t r_code = insert_hashed(_hash_multiset, _data, C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data));
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_INSERT);
+
+    return r_code;
+}
+
+// Вставка данных с известным хэшем в хэш-мультимножество
+// (_hash должен совпадать с результатом функции хэша для _data, сама функция не вызывается).
+// Возвращаемые значения - как у c_hash_multiset_insert().
+ptrdiff_t c_hash_multiset_insert_hashed(c_hash_multiset *const _hash_multiset,
+                                        const void *const _data,
+                                        const size_t _hash)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_INSERT);
+    const ptrdiff_t r_code = insert_hashed(_hash_multiset, _data, _hash);
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_INSERT);
+
+    return r_code;
+}
+
+// Удаление одной единицы данных с известным хэшем (аргументы уже проверены).
+static ptrdiff_t erase_hashed(c_hash_multiset *const _hash_multiset,
+                              const void *const _data,
+                              const size_t _hash,
+                              void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        return flat_erase(_hash_multiset, _data, _hash, _del_data);
+    }
+
+    // Продолжаем постепенное перестроение.
+    migrate(_hash_multiset, _hash_multiset->migrate_step);
+
+    // Слот, в котором находятся (или должны находиться) данные.
+    c_hash_multiset_chain **const slot = chained_slot(_hash_multiset, _hash);
+
+    // Поиск цепи с заданными данными.
+    c_hash_multiset_chain *select_chain = *slot,
+                          *prev_chain = NULL;
+    while (select_chain != NULL)
+    {
+        if (_hash == select_chain->hash)
+        {
+            if (C_HASH_MULTISET_COMP_DATA(_hash_multiset, _data, chain_first(_hash_multiset, select_chain)) > 0)
+            {
+                // Удаляем одну единицу данных из требуемой цепи.
+                chain_pop(_hash_multiset, select_chain, _del_data);
+
+                --_hash_multiset->nodes_count;
+
+                // Если цепочка опустела, удаляем ее, сшивая разрыв.
+                if (select_chain->count == 0)
+                {
+                    if (prev_chain != NULL)
+                    {
+                        prev_chain->next_chain = select_chain->next_chain;
+                    } else {
+                        *slot = select_chain->next_chain;
+                    }
+                    pool_free(&_hash_multiset->chains_pool, select_chain);
+
+                    --_hash_multiset->uniques_count;
+
+                    shrink(_hash_multiset);
+                }
+                return 1;
+            }
+        }
+        prev_chain = select_chain;
+        select_chain = select_chain->next_chain;
+    }
+
+    return 0;
+}
+
+// Удаляет из хэш-мультимножества одну единицу заданных данных.
+// В случае успешного удаления возвращает > 0.
+// В случае, если заданных данных в хэш-мультимножестве нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_erase(c_hash_multiset *const _hash_multiset,
+                                const void *const _data,
+                                void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_ERASE);
+    const ptrdiff_t r_code = erase_hashed(_hash_multiset, _data, C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data), _del_data);
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_ERASE);
+
+    return r_code;
+}
+
+// Удаляет из хэш-мультимножества одну единицу заданных данных с известным хэшем
+// (_hash должен совпадать с результатом функции хэша для _data, сама функция не вызывается).
+// Возвращаемые значения - как у c_hash_multiset_erase().
+ptrdiff_t c_hash_multiset_erase_hashed(c_hash_multiset *const _hash_multiset,
+                                       const void *const _data,
+                                       const size_t _hash,
+                                       void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_ERASE);
+    const ptrdiff_t r_code = erase_hashed(_hash_multiset, _data, _hash, _del_data);
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_ERASE);
+
+    return r_code;
+}
+
+// Перестраивает цепочную таблицу под заданное (уже приведенное) количество слотов,
+// отличное от текущего. Возвращаемые значения - как у c_hash_multiset_resize().
+static ptrdiff_t chained_resize(c_hash_multiset *const _hash_multiset,
+                                const size_t _slots_count)
+{
+    // Незаконченное постепенное перестроение завершается.
+    migrate(_hash_multiset, SIZE_MAX);
+
+    if (_slots_count == 0)
+    {
+        if (_hash_multiset->uniques_count != 0)
+        {
+            return -2;
+        }
+
+        memory_free(_hash_multiset, _hash_multiset->slots);
+        _hash_multiset->slots = NULL;
+
+        _hash_multiset->slots_count = 0;
+        _hash_multiset->slots_magic = 0;
+
+        return 1;
+    } else {
+        const size_t new_slots_size = _slots_count * sizeof(c_hash_multiset_chain*);
+        if ( (new_slots_size == 0) ||
+             (new_slots_size / _slots_count != sizeof(c_hash_multiset_chain*)) )
+        {
+            return -3;
+        }
+
+        c_hash_multiset_chain **const new_slots = memory_alloc(_hash_multiset, new_slots_size);
+        if (new_slots == NULL)
+        {
+            return -4;
+        }
+
+        memset(new_slots, 0, new_slots_size);
+
+        const uint64_t new_slots_magic = slots_magic(_hash_multiset->growth_policy, _slots_count);
+
+        // Первое размещение слотов перестроением не считается.
+        if (_hash_multiset->slots_count > 0)
+        {
+            C_HASH_MULTISET_COUNT(_hash_multiset, resizes);
+        }
+
+        // При постепенном перестроении текущие слоты становятся старыми и переносятся позже.
+        if ( (_hash_multiset->migrate_step > 0) && (_hash_multiset->uniques_count > 0) )
+        {
+            _hash_multiset->old_slots = _hash_multiset->slots;
+            _hash_multiset->old_slots_count = _hash_multiset->slots_count;
+            _hash_multiset->old_slots_magic = _hash_multiset->slots_magic;
+            _hash_multiset->migrate_pos = 0;
+
+            _hash_multiset->slots = new_slots;
+            _hash_multiset->slots_count = _slots_count;
+            _hash_multiset->slots_magic = new_slots_magic;
+
+            return 2;
+        }
+
+        // Если есть уникальные цепочки, которые необходимо перенести.
+        if (_hash_multiset->uniques_count > 0)
+        {
+            size_t count = _hash_multiset->uniques_count;
+            for (size_t s = 0; (s < _hash_multiset->slots_count)&&(count > 0); ++s)
+            {
+                if (_hash_multiset->slots[s] != NULL)
+                {
+                    c_hash_multiset_chain *select_chain = _hash_multiset->slots[s],
+                                          *relocate_chain;
+                    while (select_chain != NULL)
+                    {
+                        relocate_chain = select_chain;
+                        select_chain = select_chain->next_chain;
+
+                        // Хэш цепочки, приведенный к новому количеству слотов.
+                        const size_t presented_hash = slots_reduce(_hash_multiset->growth_policy,
+                                                                   relocate_chain->hash,
+                                                                   _slots_count,
+                                                                   new_slots_magic);
+
+                        // Перенос цепочки.
+                        relocate_chain->next_chain = new_slots[presented_hash];
+                        new_slots[presented_hash] = relocate_chain;
+
+                        --count;
+                    }
+                }
+            }
+
+        }
+
+        memory_free(_hash_multiset, _hash_multiset->slots);
+
+        // Используем новые слоты.
+        _hash_multiset->slots = new_slots;
+        _hash_multiset->slots_count = _slots_count;
+        _hash_multiset->slots_magic = new_slots_magic;
+
+        return 2;
+    }
+}
+
+// Задает хэш-мультимножеству новое количество слотов.
+// Позволяет расширить хэш-мультимножество с нулем слотов.
+// Если в хэш-мультимножестве есть хотя бы один элемент, то попытка задать нулевое количество слотов считается
+// ошибкой.
+// Если задано постепенное перестроение (migrate_step > 0), цепочки переносятся в новые слоты
+// не сразу, а понемногу при последующих вставках и удалениях (вставки переносят столько слотов,
+// чтобы перестроение закончилось до следующего расширения); незаконченное предыдущее
+// перестроение при этом сначала завершается. Новый массив слотов выделяется и обнуляется сразу,
+// за время, пропорциональное количеству слотов (но без обхода цепочек).
+// Если хэш-мультимножество перестраивается, функция возвращает > 0.
+// Если не перестраивается, функция возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_resize(c_hash_multiset *const _hash_multiset,
+                                 const size_t _slots_count)
+{
+    if (_hash_multiset == NULL) return -1;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        return flat_resize(_hash_multiset, _slots_count);
+    }
+
+    // Количество слотов, допустимое для политики роста.
+    size_t slots_count = 0;
+    if (_slots_count > 0)
+    {
+        slots_count = slots_round(_hash_multiset->growth_policy, _slots_count);
+        if (slots_count == 0)
+        {
+            return -3;
+        }
+    }
+
+    if (slots_count == _hash_multiset->slots_count) return 0;
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_RESIZE);
+    const ptrdiff_t r_code = chained_resize(_hash_multiset, slots_count);
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_RESIZE);
+
+    return r_code;
+}
+
+// Ищет цепочку (для плоского движка - запись) заданных данных с известным хэшем.
+// Хэш-мультимножество не должно быть пустым.
+// Если данных нет, возвращает NULL.
+static const c_hash_multiset_chain *find_hashed(const c_hash_multiset *const _hash_multiset,
+                                                const void *const _data,
+                                                const size_t _hash)
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        const size_t e = flat_find(_hash_multiset, _data, _hash);
+        return (e != SIZE_MAX) ? &_hash_multiset->flat_entries[e] : NULL;
+    }
+
+    const c_hash_multiset_chain *select_chain = *chained_slot(_hash_multiset, _hash);
+    while (select_chain != NULL)
+    {
+        if (_hash == select_chain->hash)
+        {
+            if (C_HASH_MULTISET_COMP_DATA(_hash_multiset, _data, chain_first(_hash_multiset, select_chain)) > 0)
+            {
+                return select_chain;
+            }
+        }
+        select_chain = select_chain->next_chain;
+    }
+
+    return NULL;
+}
+
+// Предвыборка слота (для плоского движка - группы управляющих байтов) данных с заданным хэшем.
+static void prefetch_slot(const c_hash_multiset *const _hash_multiset,
+                          const size_t _hash)
+{
+    if (_hash_multiset->slots_count == 0) return;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        const size_t groups_mask = _hash_multiset->slots_count / C_HASH_MULTISET_GROUP - 1;
+        const size_t g = (size_t)(flat_mix(_hash) >> 7) & groups_mask;
+        C_HASH_MULTISET_PREFETCH(_hash_multiset->flat_ctrl + g * C_HASH_MULTISET_GROUP);
+    } else {
+        C_HASH_MULTISET_PREFETCH(chained_slot(_hash_multiset, _hash));
+    }
+}
+
+// Предвыборка первой цепочки слота (для плоского движка - первой записи группы
+// с совпавшим отпечатком) данных с заданным хэшем.
+// Слот к этому моменту уже должен быть выбран prefetch_slot().
+static void prefetch_chain(const c_hash_multiset *const _hash_multiset,
+                           const size_t _hash)
+{
+    if (_hash_multiset->slots_count == 0) return;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        const uint64_t mix = flat_mix(_hash);
+        const size_t groups_mask = _hash_multiset->slots_count / C_HASH_MULTISET_GROUP - 1;
+        const size_t g = (size_t)(mix >> 7) & groups_mask;
+        const uint32_t matches = group_match(_hash_multiset->flat_ctrl + g * C_HASH_MULTISET_GROUP,
+                                             (uint8_t)(mix & C_HASH_MULTISET_CTRL_H2));
+        if (matches != 0)
+        {
+            C_HASH_MULTISET_PREFETCH(&_hash_multiset->flat_entries[g * C_HASH_MULTISET_GROUP + bit_first(matches)]);
+        }
+    } else {
+        const c_hash_multiset_chain *const select_chain = *chained_slot(_hash_multiset, _hash);
+        if (select_chain != NULL)
+        {
+            C_HASH_MULTISET_PREFETCH(select_chain);
+        }
+    }
+}
+
+// Предвыборка первого узла первой цепочки (записи), данные которого будут сравниваться.
+// Цепочка к этому моменту уже должна быть выбрана prefetch_chain().
+static void prefetch_node(const c_hash_multiset *const _hash_multiset,
+                          const size_t _hash)
+{
+    if (_hash_multiset->slots_count == 0) return;
+
+    const c_hash_multiset_chain *select_chain = NULL;
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        const uint64_t mix = flat_mix(_hash);
+        const size_t groups_mask = _hash_multiset->slots_count / C_HASH_MULTISET_GROUP - 1;
+        const size_t g = (size_t)(mix >> 7) & groups_mask;
+        const uint32_t matches = group_match(_hash_multiset->flat_ctrl + g * C_HASH_MULTISET_GROUP,
+                                             (uint8_t)(mix & C_HASH_MULTISET_CTRL_H2));
+        if (matches != 0)
+        {
+            select_chain = &_hash_multiset->flat_entries[g * C_HASH_MULTISET_GROUP + bit_first(matches)];
+        }
+    } else {
+        select_chain = *chained_slot(_hash_multiset, _hash);
+    }
+
+    if ( (select_chain != NULL) && (select_chain->hash == _hash) )
+    {
+        C_HASH_MULTISET_PREFETCH(select_chain->head);
+    }
+}
+
+// Вычисляет хэши очередной части пакета и запускает предвыборку для ее первых данных.
+// Для отсутствующих данных (NULL) хэш не вычисляется.
+static void batch_prepare(const c_hash_multiset *const _hash_multiset,
+                          const void *const *const _data,
+                          const size_t _count,
+                          size_t *const _hashes)
+{
+    for (size_t i = 0; i < _count; ++i)
+    {
+        _hashes[i] = (_data[i] != NULL) ? C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data[i]) : 0;
+    }
+
+    for (size_t i = 0; (i < 3 * C_HASH_MULTISET_PREFETCH_DISTANCE)&&(i < _count); ++i)
+    {
+        prefetch_slot(_hash_multiset, _hashes[i]);
+    }
+    for (size_t i = 0; (i < 2 * C_HASH_MULTISET_PREFETCH_DISTANCE)&&(i < _count); ++i)
+    {
+        prefetch_chain(_hash_multiset, _hashes[i]);
+    }
+    for (size_t i = 0; (i < C_HASH_MULTISET_PREFETCH_DISTANCE)&&(i < _count); ++i)
+    {
+        prefetch_node(_hash_multiset, _hashes[i]);
+    }
+}
+
+// Продолжает предвыборку пакета: пока обрабатываются i-ые данные, выбираются слоты
+// для данных на три дистанции предвыборки вперед, цепочки - на две и узлы - на одну.
+static void batch_prefetch(const c_hash_multiset *const _hash_multiset,
+                           const size_t *const _hashes,
+                           const size_t _count,
+                           const size_t _i)
+{
+    if (_i + 3 * C_HASH_MULTISET_PREFETCH_DISTANCE < _count)
+    {
+        prefetch_slot(_hash_multiset, _hashes[_i + 3 * C_HASH_MULTISET_PREFETCH_DISTANCE]);
+    }
+    if (_i + 2 * C_HASH_MULTISET_PREFETCH_DISTANCE < _count)
+    {
+        prefetch_chain(_hash_multiset, _hashes[_i + 2 * C_HASH_MULTISET_PREFETCH_DISTANCE]);
+    }
+    if (_i + C_HASH_MULTISET_PREFETCH_DISTANCE < _count)
+    {
+        prefetch_node(_hash_multiset, _hashes[_i + C_HASH_MULTISET_PREFETCH_DISTANCE]);
+    }
+}
+
+// Проверяет наличие заданных данных в хэш-мультимножестве.
+// Если данные есть, возвращает > 0.
+// Если данных нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_check(const c_hash_multiset *const _hash_multiset,
+                                const void *const _data)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    return c_hash_multiset_check_hashed(_hash_multiset, _data, C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data));
+}
+
+// Проверяет наличие заданных данных с известным хэшем в хэш-мультимножестве
+// (_hash должен совпадать с результатом функции хэша для _data, сама функция не вызывается).
+// Возвращаемые значения - как у c_hash_multiset_check().
+ptrdiff_t c_hash_multiset_check_hashed(const c_hash_multiset *const _hash_multiset,
+                                       const void *const _data,
+                                       const size_t _hash)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    if (find_hashed(_hash_multiset, _data, _hash) != NULL)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+// Возвращает количество заданных данных в хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_data_count(const c_hash_multiset *const _hash_multiset,
+                                  const void *const _data,
+                                  size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    return c_hash_multiset_data_count_hashed(_hash_multiset, _data, C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data), _error);
+}
+
+// Возвращает количество заданных данных с известным хэшем в хэш-мультимножестве
+// (_hash должен совпадать с результатом функции хэша для _data, сама функция не вызывается).
+// Возвращаемые значения - как у c_hash_multiset_data_count().
+size_t c_hash_multiset_data_count_hashed(const c_hash_multiset *const _hash_multiset,
+                                         const void *const _data,
+                                         const size_t _hash,
+                                         size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    const c_hash_multiset_chain *const select_chain = find_hashed(_hash_multiset, _data, _hash);
+    if (select_chain != NULL)
+    {
+        return select_chain->count;
+    }
+
+    return 0;
+}
+
+// Выполняет заданные действия над всеми данными цепочки.
+static void chain_for_each(const c_hash_multiset *const _hash_multiset,
+                           const c_hash_multiset_chain *const _chain,
+                           void (*const _action_data)(const void *const _data))
+{
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+    {
+        for (size_t i = 0; i < _chain->count; ++i)
+        {
+            _action_data( chain_item(_chain, i) );
+        }
+        return;
+    }
+
+    const c_hash_multiset_node *select_node = _chain->head;
+    while (select_node != NULL)
+    {
+        _action_data( select_node->data );
+        select_node = select_node->next_node;
+    }
+}
+
+// Проходит по всем данным хэш-мультимножества и выполняет над ними заданные действия.
+// В случае успешного выполнения возвращает > 0.
+// В случае, если в хэш-мультимножестве нет элементов, возвращает 0.
+// В случае ошибки < 0.
+ptrdiff_t c_hash_multiset_for_each(const c_hash_multiset *const _hash_multiset,
+                                   void (*const _action_data)(const void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_action_data == NULL) return -2;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    size_t count = _hash_multiset->uniques_count;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        for (size_t e = 0; (e < _hash_multiset->slots_count)&&(count > 0); ++e)
+        {
+            if ( (_hash_multiset->flat_ctrl[e] & C_HASH_MULTISET_CTRL_EMPTY) == 0 )
+            {
+                chain_for_each(_hash_multiset, &_hash_multiset->flat_entries[e], _action_data);
+                --count;
+            }
+        }
+        return 1;
+    }
+
+    // Сначала неперенесенная часть старого массива слотов, затем новый массив.
+    for (size_t part = 0; part < 2; ++part)
+    {
+        c_hash_multiset_chain *const *const slots = (part == 0) ? _hash_multiset->old_slots :
+                                                                  _hash_multiset->slots;
+        const size_t slots_end = (part == 0) ? _hash_multiset->old_slots_count :
+                                               _hash_multiset->slots_count;
+        for (size_t s = (part == 0) ? _hash_multiset->migrate_pos : 0; (s < slots_end)&&(count > 0); ++s)
+        {
+            if (slots[s] != NULL)
+            {
+                const c_hash_multiset_chain *select_chain = slots[s];
+                while (select_chain != NULL)
+                {
+                    chain_for_each(_hash_multiset, select_chain, _action_data);
+                    select_chain = select_chain->next_chain;
+                    --count;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Обнуляет слоты цепочного движка, в которых могут находиться цепочки пула: для каждой размеченной
+// цепочки пула (в том числе свободной - ее хэш остается прежним) обнуляется слот ее хэша.
+static void clear_chain_slots(c_hash_multiset *const _hash_multiset)
+{
+    const c_hash_multiset_pool *const pool = &_hash_multiset->chains_pool;
+    for (const c_hash_multiset_slab *select_slab = pool->slabs; select_slab != NULL; select_slab = select_slab->next_slab)
+    {
+        const uint8_t *const objects_end = pool_slab_end(pool, select_slab);
+        for (const uint8_t *object = (const uint8_t*)select_slab + C_HASH_MULTISET_SLAB_HEADER;
+             object < objects_end;
+             object += pool->object_size)
+        {
+            const c_hash_multiset_chain *const select_chain = (const c_hash_multiset_chain*)object;
+            _hash_multiset->slots[slots_reduce(_hash_multiset->growth_policy,
+                                               select_chain->hash,
+                                               _hash_multiset->slots_count,
+                                               _hash_multiset->slots_magic)] = NULL;
+        }
+    }
+}
+
+// Очищает хэш-мультимножество ото всех данных, количество слотов сохраняется.
+// Узлы обходятся только для удаления данных, сами цепочки и узлы возвращаются
+// вместе с блоками пулов (при хранении массивом цепочки обходятся и для освобождения массивов).
+// При быстрой очистке без _del_data последние блоки пулов сохраняются для новых вставок,
+// а в цепочном движке, если цепочек в пулах намного меньше, чем слотов, обнуляются только
+// слоты этих цепочек - время очистки зависит от вставленного с прошлой очистки, а не от размера таблицы.
+// В случае успешного очищения возвращает > 0.
+// Если очищать не от чего, возвращает 0.
+// В случае ошибвки возвращает < 0.
+ptrdiff_t c_hash_multiset_clear(c_hash_multiset *const _hash_multiset,
+                                void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_CLEAR);
+
+    // Функция удаления данных задана или есть внешние массивы повторов.
+    if ( (_del_data != NULL) || (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY) )
+    {
+        del_all_data(_hash_multiset, _del_data, 1);
+    }
+
+    const size_t fast = (_hash_multiset->fast_clear != 0) && (_del_data == NULL) &&
+                        (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_NODES);
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        memset(_hash_multiset->flat_ctrl, C_HASH_MULTISET_CTRL_EMPTY, _hash_multiset->slots_count);
+        _hash_multiset->flat_tombstones = 0;
+    } else {
+        if ( (fast != 0) &&
+             (pool_carved(&_hash_multiset->chains_pool) < _hash_multiset->slots_count / C_HASH_MULTISET_CLEAR_RATIO) )
+        {
+            clear_chain_slots(_hash_multiset);
+        } else {
+            memset(_hash_multiset->slots, 0, _hash_multiset->slots_count * sizeof(c_hash_multiset_chain*));
+        }
+
+        // Незаконченное постепенное перестроение больше не нужно.
+        memory_free(_hash_multiset, _hash_multiset->old_slots);
+        _hash_multiset->old_slots = NULL;
+        _hash_multiset->old_slots_count = 0;
+        _hash_multiset->migrate_pos = 0;
+    }
+
+    if (fast != 0)
+    {
+        pool_recycle(_hash_multiset, &_hash_multiset->chains_pool);
+        pool_recycle(_hash_multiset, &_hash_multiset->nodes_pool);
+    } else {
+        pool_release(_hash_multiset, &_hash_multiset->chains_pool);
+        pool_release(_hash_multiset, &_hash_multiset->nodes_pool);
+    }
+
+    _hash_multiset->nodes_count = 0;
+    _hash_multiset->uniques_count = 0;
+
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_CLEAR);
+
+    return 1;
+}
+
+// Удаление всех единиц данных с известным хэшем (аргументы уже проверены).
+static size_t erase_all_hashed(c_hash_multiset *const _hash_multiset,
+                               const void *const _data,
+                               const size_t _hash,
+                               void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        return flat_erase_all(_hash_multiset, _data, _hash, _del_data);
+    }
+
+    // Продолжаем постепенное перестроение.
+    migrate(_hash_multiset, _hash_multiset->migrate_step);
+
+    // Слот, в котором находятся (или должны находиться) данные.
+    c_hash_multiset_chain **const slot = chained_slot(_hash_multiset, _hash);
+
+    if (*slot != NULL)
+    {
+        c_hash_multiset_chain *select_chain = *slot,
+                              *prev_chain = NULL;
+
+        while (select_chain != NULL)
+        {
+            if (_hash == select_chain->hash)
+            {
+                if (C_HASH_MULTISET_COMP_DATA(_hash_multiset, _data, chain_first(_hash_multiset, select_chain)) > 0)
+                {
+                    // Удаляем данные заданной цепи.
+                    chain_drop(_hash_multiset, select_chain, _del_data);
+
+                    // Уникальных цепей стало меньше на одну.
+                    --_hash_multiset->uniques_count;
+                    // Элементов в хэш-мультимножестве стало меньше на количество элементов удаляемой цепи.
+                    _hash_multiset->nodes_count -= select_chain->count;
+                    // Запоминаем, сколько элементов было удалено.
+                    const size_t count = select_chain->count;
+
+                    // Ампутация цепи.
+                    if (prev_chain != NULL)
+                    {
+                        prev_chain->next_chain = select_chain->next_chain;
+                    } else {
+                        *slot = select_chain->next_chain;
+                    }
+
+                    pool_free(&_hash_multiset->chains_pool, select_chain);
+
+                    shrink(_hash_multiset);
+
+                    return count;
+                }
+            }
+            prev_chain = select_chain;
+            select_chain = select_chain->next_chain;
+        }
+    }
+
+    return 0;
+}
+
+// Удаляет из хэш-мультимножества все единицы заданных данных.
+// Возвращает количество удаленных элементов.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_erase_all(c_hash_multiset *const _hash_multiset,
+                                 const void *const _data,
+                                 void (* const _del_data)(void *const _data),
+                                 size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    if (_hash_multiset->uniques_count == 0)
+    {
+        return 0;
+    }
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_ERASE_ALL);
+    const size_t count = erase_all_hashed(_hash_multiset, _data, C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data), _del_data);
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_ERASE_ALL);
+
+    return count;
+}
+
+// Удаляет из хэш-мультимножества все единицы заданных данных с известным хэшем
+// (_hash должен совпадать с результатом функции хэша для _data, сама функция не вызывается).
+// Возвращаемые значения - как у c_hash_multiset_erase_all().
+size_t c_hash_multiset_erase_all_hashed(c_hash_multiset *const _hash_multiset,
+                                        const void *const _data,
+                                        const size_t _hash,
+                                        void (*const _del_data)(void *const _data),
+                                        size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    if (_hash_multiset->uniques_count == 0)
+    {
+        return 0;
+    }
+
+    C_HASH_MULTISET_TRACE_BEGIN(_hash_multiset, C_HASH_MULTISET_OP_ERASE_ALL);
+    const size_t count = erase_all_hashed(_hash_multiset, _data, _hash, _del_data);
+    C_HASH_MULTISET_TRACE_END(_hash_multiset, C_HASH_MULTISET_OP_ERASE_ALL);
+
+    return count;
+}
+
+// Возвращает количество слотов в хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_slots_count(const c_hash_multiset *const _hash_multiset,
+                                   size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return _hash_multiset->slots_count;
+}
+
+// Возвращает количество узлов (объектов) в хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_count(const c_hash_multiset *const _hash_multiset,
+                             size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return _hash_multiset->nodes_count;
+}
+
+// Возвращает количество уникальных объектов в хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_uniques_count(const c_hash_multiset *const _hash_multiset,
+                                     size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return _hash_multiset->uniques_count;
+}
+
+// Возвращает коэф. максимальной загрузки хэш-мультимножества.
+// В случае ошибки возвращает 0.0f.
+float c_hash_multiset_max_load_factor(const c_hash_multiset *const _hash_multiset)
+{
+    if (_hash_multiset == NULL)
+    {
+        return 0.0f;
     }
 
     return _hash_multiset->max_load_factor;
 }
+
+// Заранее расширяет хэш-мультимножество так, чтобы в него можно было вставить _uniques_count
+// уникальных данных без перестроений.
+// Если расширение не требуется, возвращает 0.
+// Если хэш-мультимножество перестраивается, возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_reserve(c_hash_multiset *const _hash_multiset,
+                                  const size_t _uniques_count)
+{
+    if (_hash_multiset == NULL) return -1;
+
+    const float slots_count = _uniques_count / _hash_multiset->max_load_factor + 1.0f;
+    if (slots_count >= (float)SIZE_MAX)
+    {
+        return -2;
+    }
+
+    const size_t new_slots_count = (size_t)slots_count;
+    if (new_slots_count <= _hash_multiset->slots_count)
+    {
+        return 0;
+    }
+
+    if (c_hash_multiset_resize(_hash_multiset, new_slots_count) < 0)
+    {
+        return -3;
+    }
+
+    return 1;
+}
+
+// Уменьшает количество слотов до минимального, при котором не превышается максимальная
+// загруженность. Пустое хэш-мультимножество освобождает слоты полностью.
+// Если хэш-мультимножество перестраивается, возвращает > 0.
+// Если не перестраивается, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_shrink_to_fit(c_hash_multiset *const _hash_multiset)
+{
+    if (_hash_multiset == NULL) return -1;
+
+    size_t new_slots_count = 0;
+    if (_hash_multiset->uniques_count > 0)
+    {
+        new_slots_count = (size_t)(_hash_multiset->uniques_count / _hash_multiset->max_load_factor) + 1;
+    }
+
+    if (new_slots_count >= _hash_multiset->slots_count)
+    {
+        return 0;
+    }
+
+    const ptrdiff_t r_code = c_hash_multiset_resize(_hash_multiset, new_slots_count);
+    if (r_code < 0)
+    {
+        return -2;
+    }
+
+    return r_code;
+}
+
+// Вставляет в хэш-мультимножество _count данных из массива _data.
+// Сначала вычисляются хэши части пакета, затем данные вставляются с предвыборкой слотов
+// и цепочек на несколько данных вперед, так что задержки памяти перекрываются.
+// Если _results != NULL, в _results[i] помещается результат вставки _data[i]
+// (как у c_hash_multiset_insert()).
+// Если вставлены все данные, возвращает > 0.
+// Если хотя бы одни данные не вставлены, возвращает 0.
+// В случае ошибки возвращает < 0, никакие данные не вставляются.
+ptrdiff_t c_hash_multiset_insert_batch(c_hash_multiset *const _hash_multiset,
+                                       const void *const *const _data,
+                                       const size_t _count,
+                                       ptrdiff_t *const _results)
+{
+    if (_hash_multiset == NULL) return -1;
+    if ( (_data == NULL) && (_count > 0) ) return -2;
+
+    ptrdiff_t r_code = 1;
+
+    size_t hashes[C_HASH_MULTISET_BATCH];
+    for (size_t b = 0; b < _count; b += C_HASH_MULTISET_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MULTISET_BATCH) ? _count - b : C_HASH_MULTISET_BATCH;
+        const void *const *const data = _data + b;
+
+        batch_prepare(_hash_multiset, data, count, hashes);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            batch_prefetch(_hash_multiset, hashes, count, i);
+
+            const ptrdiff_t i_code = (data[i] != NULL) ? insert_hashed(_hash_multiset, data[i], hashes[i]) : -2;
+            if (i_code <= 0)
+            {
+                r_code = 0;
+            }
+            if (_results != NULL)
+            {
+                _results[b + i] = i_code;
+            }
+        }
+    }
+
+    return r_code;
+}
+
+// Проверяет наличие в хэш-мультимножестве каждых из _count данных массива _data.
+// В _results[i] помещается результат проверки _data[i] (как у c_hash_multiset_check()).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_check_batch(const c_hash_multiset *const _hash_multiset,
+                                      const void *const *const _data,
+                                      const size_t _count,
+                                      ptrdiff_t *const _results)
+{
+    if (_hash_multiset == NULL) return -1;
+    if ( (_data == NULL) && (_count > 0) ) return -2;
+    if ( (_results == NULL) && (_count > 0) ) return -3;
+
+    size_t hashes[C_HASH_MULTISET_BATCH];
+    for (size_t b = 0; b < _count; b += C_HASH_MULTISET_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MULTISET_BATCH) ? _count - b : C_HASH_MULTISET_BATCH;
+        const void *const *const data = _data + b;
+
+        if (_hash_multiset->uniques_count == 0)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                _results[b + i] = (data[i] != NULL) ? 0 : -2;
+            }
+            continue;
+        }
+
+        batch_prepare(_hash_multiset, data, count, hashes);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            batch_prefetch(_hash_multiset, hashes, count, i);
+
+            if (data[i] == NULL)
+            {
+                _results[b + i] = -2;
+            } else {
+                _results[b + i] = (find_hashed(_hash_multiset, data[i], hashes[i]) != NULL) ? 1 : 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Определяет количество в хэш-мультимножестве каждых из _count данных массива _data.
+// В _counts[i] помещается количество _data[i] (для _data[i] == NULL - 0).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_data_count_batch(const c_hash_multiset *const _hash_multiset,
+                                           const void *const *const _data,
+                                           const size_t _count,
+                                           size_t *const _counts)
+{
+    if (_hash_multiset == NULL) return -1;
+    if ( (_data == NULL) && (_count > 0) ) return -2;
+    if ( (_counts == NULL) && (_count > 0) ) return -3;
+
+    if (_hash_multiset->uniques_count == 0)
+    {
+        for (size_t i = 0; i < _count; ++i)
+        {
+            _counts[i] = 0;
+        }
+        return 1;
+    }
+
+    size_t hashes[C_HASH_MULTISET_BATCH];
+    for (size_t b = 0; b < _count; b += C_HASH_MULTISET_BATCH)
+    {
+        const size_t count = (_count - b < C_HASH_MULTISET_BATCH) ? _count - b : C_HASH_MULTISET_BATCH;
+        const void *const *const data = _data + b;
+
+        batch_prepare(_hash_multiset, data, count, hashes);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            batch_prefetch(_hash_multiset, hashes, count, i);
+
+            _counts[b + i] = 0;
+            if (data[i] != NULL)
+            {
+                const c_hash_multiset_chain *const select_chain = find_hashed(_hash_multiset, data[i], hashes[i]);
+                if (select_chain != NULL)
+                {
+                    _counts[b + i] = select_chain->count;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Возвращает количество потоков параллельной операции над _slots_count слотами.
+static size_t parallel_count(const size_t _threads_count,
+                             const size_t _slots_count)
+{
+    size_t threads_count = (_threads_count < C_HASH_MULTISET_THREADS_MAX) ? _threads_count :
+                                                                            C_HASH_MULTISET_THREADS_MAX;
+    if (threads_count > _slots_count / C_HASH_MULTISET_PARALLEL_MIN)
+    {
+        threads_count = _slots_count / C_HASH_MULTISET_PARALLEL_MIN;
+    }
+    return (threads_count > 0) ? threads_count : 1;
+}
+
+// Определяет диапазон слотов [*_begin, *_end) задачи _index из _threads_count.
+static void parallel_range(const size_t _slots_count,
+                           const size_t _threads_count,
+                           const size_t _index,
+                           size_t *const _begin,
+                           size_t *const _end)
+{
+    const size_t chunk = _slots_count / _threads_count,
+                 rest = _slots_count % _threads_count;
+    *_begin = _index * chunk + ( (_index < rest) ? _index : rest );
+    *_end = *_begin + chunk + ( (_index < rest) ? 1 : 0 );
+}
+
+// Состояние параллельного слияния.
+typedef struct s_c_hash_multiset_merge_state
+{
+    c_hash_multiset *destination,
+                    *source;
+    size_t threads_count;
+    // Результаты задач: количество цепочек источника, слитых с цепочками приемника,
+    // и список освободившихся при этом цепочек (первый и последний объекты).
+    size_t merged[C_HASH_MULTISET_THREADS_MAX];
+    void *free_first[C_HASH_MULTISET_THREADS_MAX],
+         *free_last[C_HASH_MULTISET_THREADS_MAX];
+} c_hash_multiset_merge_state;
+
+// Задача слияния: переносит цепочки источника из своего диапазона слотов в те же слоты приемника.
+// Диапазоны задач не пересекаются, поэтому задачи не синхронизируются.
+static void merge_range(void *const _merge,
+                        const size_t _index)
+{
+    c_hash_multiset_merge_state *const merge = _merge;
+    c_hash_multiset *const destination = merge->destination;
+    c_hash_multiset *const source = merge->source;
+
+    size_t slots_begin,
+           slots_end;
+    parallel_range(destination->slots_count, merge->threads_count, _index, &slots_begin, &slots_end);
+
+    size_t merged = 0;
+    void *free_first = NULL,
+         *free_last = NULL;
+
+    for (size_t s = slots_begin; s < slots_end; ++s)
+    {
+        c_hash_multiset_chain *select_chain = source->slots[s],
+                              *move_chain;
+        source->slots[s] = NULL;
+
+        // Цепочки источника уникальны, поэтому сравниваются только с исходными цепочками приемника.
+        c_hash_multiset_chain *const destination_head = destination->slots[s];
+
+        while (select_chain != NULL)
+        {
+            move_chain = select_chain;
+            select_chain = select_chain->next_chain;
+
+            // Хэш заново не вычисляется, сравнивается сохраненный.
+            c_hash_multiset_chain *target_chain = destination_head;
+            while (target_chain != NULL)
+            {
+                if (move_chain->hash == target_chain->hash)
+                {
+                    if (C_HASH_MULTISET_COMP_DATA(destination, chain_first(destination, move_chain), chain_first(destination, target_chain)) > 0)
+                    {
+                        break;
+                    }
+                }
+                target_chain = target_chain->next_chain;
+            }
+
+            if (target_chain == NULL)
+            {
+                // Таких данных в приемнике нет - переносим цепочку целиком.
+                move_chain->next_chain = destination->slots[s];
+                destination->slots[s] = move_chain;
+                continue;
+            }
+
+            // Подвешиваем более короткий список узлов к более длинному.
+            c_hash_multiset_node *short_head = move_chain->head,
+                                 *long_head = target_chain->head;
+            if (target_chain->count < move_chain->count)
+            {
+                short_head = target_chain->head;
+                long_head = move_chain->head;
+            }
+            c_hash_multiset_node *tail_node = short_head;
+            while (tail_node->next_node != NULL)
+            {
+                tail_node = tail_node->next_node;
+            }
+            tail_node->next_node = long_head;
+
+            target_chain->head = short_head;
+            target_chain->count += move_chain->count;
+
+            // Освободившаяся цепочка возвращается в пул после завершения всех задач.
+            *(void**)move_chain = free_first;
+            free_first = move_chain;
+            if (free_last == NULL)
+            {
+                free_last = move_chain;
+            }
+
+            ++merged;
+        }
+    }
+
+    merge->merged[_index] = merged;
+    merge->free_first[_index] = free_first;
+    merge->free_last[_index] = free_last;
+}
+
+// Переносит все данные хэш-мультимножества _source в хэш-мультимножество _destination,
+// после чего _source становится пустым (количество его слотов сохраняется).
+// Хэш-мультимножества должны использовать цепочный движок с хранением повторов узлами (слияние
+// массивов потребовало бы выделений памяти в параллельных задачах), одни и те же функции хэша и сравнения,
+// одну политику роста, один размер ключа и один распределитель без release (цепочки, узлы и блоки пулов источника
+// переходят к приемнику без копирования).
+// Источник приводится к количеству слотов приемника, так что цепочка из слота s источника
+// может оказаться только в слоте s приемника; диапазоны слотов обрабатываются параллельно
+// не более чем _threads_count потоками, хэш данных заново не вычисляется.
+// Если данные перенесены, возвращает > 0.
+// Если источник пуст, возвращает 0.
+// В случае ошибки возвращает < 0, данные не переносятся:
+// -1...-6 - неверные аргументы, оба хэш-мультимножества остаются прежними;
+// -7 - не удалось расширить приемник, -8 - не удалось перестроить источник. В этих случаях
+// данные обоих остаются на месте, но незаконченные постепенные перестроения обоих завершены,
+// а при -8 приемник может быть уже расширен.
+ptrdiff_t c_hash_multiset_merge(c_hash_multiset *const _destination,
+                                c_hash_multiset *const _source,
+                                const size_t _threads_count)
+{
+    if (_destination == NULL) return -1;
+    if (_source == NULL) return -2;
+    if (_destination == _source) return -3;
+
+    if ( (_destination->engine != C_HASH_MULTISET_ENGINE_CHAINED) ||
+         (_source->engine != C_HASH_MULTISET_ENGINE_CHAINED) ||
+         (_destination->storage != C_HASH_MULTISET_STORAGE_NODES) ||
+         (_source->storage != C_HASH_MULTISET_STORAGE_NODES) )
+    {
+        return -4;
+    }
+    if ( (_destination->hash_data != _source->hash_data) ||
+         (_destination->comp_data != _source->comp_data) ||
+         (_destination->growth_policy != _source->growth_policy) ||
+         (_destination->key_size != _source->key_size) )
+    {
+        return -5;
+    }
+    if ( (_destination->allocator.allocate != _source->allocator.allocate) ||
+         (_destination->allocator.deallocate != _source->allocator.deallocate) ||
+         (_destination->allocator_context != _source->allocator_context) ||
+         (_destination->allocator.release != NULL) ||
+         (_source->allocator.release != NULL) )
+    {
+        return -6;
+    }
+
+    if (_source->uniques_count == 0) return 0;
+
+    // Незаконченные постепенные перестроения завершаются.
+    migrate(_destination, SIZE_MAX);
+    migrate(_source, SIZE_MAX);
+
+    // Расширяем приемник в расчете на то, что все уникальные данные источника новые.
+    const size_t uniques_count = _destination->uniques_count + _source->uniques_count;
+    if ( (_destination->slots_count == 0) ||
+         ((float)uniques_count / _destination->slots_count >= _destination->max_load_factor) )
+    {
+        const float slots_count = uniques_count / _destination->max_load_factor + 1.0f;
+        if (slots_count >= (float)SIZE_MAX)
+        {
+            return -7;
+        }
+
+        size_t new_slots_count = (size_t)(_destination->slots_count * _destination->growth_factor) + 1;
+        if (new_slots_count < (size_t)slots_count)
+        {
+            new_slots_count = (size_t)slots_count;
+        }
+
+        if (c_hash_multiset_resize(_destination, new_slots_count) < 0)
+        {
+            return -7;
+        }
+        migrate(_destination, SIZE_MAX);
+    }
+
+    // Приводим источник к количеству слотов приемника.
+    if (c_hash_multiset_resize(_source, _destination->slots_count) < 0)
+    {
+        return -8;
+    }
+    migrate(_source, SIZE_MAX);
+
+    c_hash_multiset_merge_state merge;
+    merge.destination = _destination;
+    merge.source = _source;
+    merge.threads_count = parallel_count(_threads_count, _destination->slots_count);
+
+    parallel_run(NULL, merge_range, &merge, merge.threads_count);
+
+    // Цепочки и узлы источника теперь принадлежат приемнику.
+    pool_adopt(&_destination->chains_pool, &_source->chains_pool);
+    pool_adopt(&_destination->nodes_pool, &_source->nodes_pool);
+
+    size_t merged = 0;
+    for (size_t i = 0; i < merge.threads_count; ++i)
+    {
+        merged += merge.merged[i];
+        if (merge.free_first[i] != NULL)
+        {
+            *(void**)merge.free_last[i] = _destination->chains_pool.free_list;
+            _destination->chains_pool.free_list = merge.free_first[i];
+        }
+    }
+
+    _destination->uniques_count = uniques_count - merged;
+    _destination->nodes_count += _source->nodes_count;
+
+    _source->uniques_count = 0;
+    _source->nodes_count = 0;
+
+    return 1;
+}
+
+// Возвращает количество позиций обхода хэш-мультимножества: для плоского движка - позиции таблицы,
+// для цепочного - сначала неперенесенная часть старого массива слотов, затем новый массив.
+static size_t positions_count(const c_hash_multiset *const _hash_multiset)
+{
+    size_t positions_count = _hash_multiset->slots_count;
+    if (_hash_multiset->old_slots != NULL)
+    {
+        positions_count += _hash_multiset->old_slots_count - _hash_multiset->migrate_pos;
+    }
+    return positions_count;
+}
+
+// Возвращает первую цепочку (для плоского движка - запись) позиции обхода или NULL.
+static const c_hash_multiset_chain *position_chain(const c_hash_multiset *const _hash_multiset,
+                                                   const size_t _position)
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        if ( (_hash_multiset->flat_ctrl[_position] & C_HASH_MULTISET_CTRL_EMPTY) != 0 )
+        {
+            return NULL;
+        }
+        return &_hash_multiset->flat_entries[_position];
+    }
+
+    const size_t old_count = (_hash_multiset->old_slots != NULL) ?
+                             _hash_multiset->old_slots_count - _hash_multiset->migrate_pos : 0;
+    if (_position < old_count)
+    {
+        return _hash_multiset->old_slots[_hash_multiset->migrate_pos + _position];
+    }
+    return _hash_multiset->slots[_position - old_count];
+}
+
+// Возвращает следующую цепочку той же позиции обхода или NULL.
+static const c_hash_multiset_chain *position_chain_next(const c_hash_multiset *const _hash_multiset,
+                                                        const c_hash_multiset_chain *const _chain)
+{
+    // Записи плоского движка не связаны.
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        return NULL;
+    }
+    return _chain->next_chain;
+}
+
+// Состояние параллельного обхода.
+typedef struct s_c_hash_multiset_visit_state
+{
+    const c_hash_multiset *hash_multiset;
+    size_t threads_count,
+           positions_count;
+    // Задана одна из функций.
+    void (*action_data)(const void *const _data);
+    void (*del_data)(void *const _data);
+} c_hash_multiset_visit_state;
+
+// Задача параллельного обхода: вызывает функцию для данных всех узлов своего диапазона позиций.
+// Позиции цепочного движка - сначала неперенесенная часть старого массива слотов, затем новый массив.
+static void visit_range(void *const _visit,
+                        const size_t _index)
+{
+    const c_hash_multiset_visit_state *const visit = _visit;
+    const c_hash_multiset *const hash_multiset = visit->hash_multiset;
+
+    size_t positions_begin,
+           positions_end;
+    parallel_range(visit->positions_count, visit->threads_count, _index, &positions_begin, &positions_end);
+
+    for (size_t p = positions_begin; p < positions_end; ++p)
+    {
+        const c_hash_multiset_chain *select_chain = position_chain(hash_multiset, p);
+        while (select_chain != NULL)
+        {
+            if (hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+            {
+                for (size_t i = 0; i < select_chain->count; ++i)
+                {
+                    if (visit->action_data != NULL)
+                    {
+                        visit->action_data( chain_item(select_chain, i) );
+                    } else {
+                        visit->del_data( chain_item(select_chain, i) );
+                    }
+                }
+            } else {
+                const c_hash_multiset_node *select_node = select_chain->head;
+                while (select_node != NULL)
+                {
+                    if (visit->action_data != NULL)
+                    {
+                        visit->action_data( select_node->data );
+                    } else {
+                        visit->del_data( select_node->data );
+                    }
+                    select_node = select_node->next_node;
+                }
+            }
+            select_chain = position_chain_next(hash_multiset, select_chain);
+        }
+    }
+}
+
+// Параллельно вызывает одну из функций для данных всех узлов хэш-мультимножества.
+static void visit_all(const c_hash_multiset *const _hash_multiset,
+                      void (*const _action_data)(const void *const _data),
+                      void (*const _del_data)(void *const _data),
+                      const size_t _threads_count,
+                      const c_hash_multiset_executor *const _executor)
+{
+    c_hash_multiset_visit_state visit;
+    visit.hash_multiset = _hash_multiset;
+    visit.positions_count = positions_count(_hash_multiset);
+    visit.threads_count = parallel_count(_threads_count, visit.positions_count);
+    visit.action_data = _action_data;
+    visit.del_data = _del_data;
+
+    parallel_run(_executor, visit_range, &visit, visit.threads_count);
+}
+
+// Параллельный вариант c_hash_multiset_for_each(): массив слотов делится на диапазоны, которые
+// обходятся не более чем _threads_count потоками (или задачами исполнителя _executor, если он задан).
+// _action_data вызывается одновременно из нескольких потоков (для разных данных) и должна
+// быть к этому готова; порядок вызовов не определен.
+// В случае успешного выполнения возвращает > 0.
+// В случае, если в хэш-мультимножестве нет элементов, возвращает 0.
+// В случае ошибки < 0.
+ptrdiff_t c_hash_multiset_for_each_parallel(const c_hash_multiset *const _hash_multiset,
+                                            void (*const _action_data)(const void *const _data),
+                                            const size_t _threads_count,
+                                            const c_hash_multiset_executor *const _executor)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_action_data == NULL) return -2;
+    if ( (_executor != NULL) && (_executor->run == NULL) ) return -3;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    visit_all(_hash_multiset, _action_data, NULL, _threads_count, _executor);
+
+    return 1;
+}
+
+// Параллельный вариант c_hash_multiset_clear(): данные удаляются параллельно по диапазонам
+// слотов, счетчики обнуляются один раз после завершения всех потоков.
+// _del_data вызывается одновременно из нескольких потоков (для разных данных) и должна
+// быть к этому готова.
+// В случае успешного очищения возвращает > 0.
+// Если очищать не от чего, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_clear_parallel(c_hash_multiset *const _hash_multiset,
+                                         void (*const _del_data)(void *const _data),
+                                         const size_t _threads_count,
+                                         const c_hash_multiset_executor *const _executor)
+{
+    if (_hash_multiset == NULL) return -1;
+    if ( (_executor != NULL) && (_executor->run == NULL) ) return -2;
+
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    if (_del_data != NULL)
+    {
+        visit_all(_hash_multiset, NULL, _del_data, _threads_count, _executor);
+    }
+
+    // Данные уже удалены, остается вернуть память пулов.
+    return c_hash_multiset_clear(_hash_multiset, NULL);
+}
+
+// Параллельный вариант c_hash_multiset_delete(): данные удаляются параллельно по диапазонам слотов.
+// _del_data вызывается одновременно из нескольких потоков (для разных данных) и должна
+// быть к этому готова.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_delete_parallel(c_hash_multiset *const _hash_multiset,
+                                          void (*const _del_data)(void *const _data),
+                                          const size_t _threads_count,
+                                          const c_hash_multiset_executor *const _executor)
+{
+    if (_hash_multiset == NULL) return -1;
+    if ( (_executor != NULL) && (_executor->run == NULL) ) return -2;
+
+    if ( (_del_data != NULL) && (_hash_multiset->uniques_count > 0) )
+    {
+        visit_all(_hash_multiset, NULL, _del_data, _threads_count, _executor);
+    }
+
+    return c_hash_multiset_delete(_hash_multiset, NULL);
+}
+
+// Подготавливает курсор к обходу хэш-мультимножества с начала.
+// Если _uniques == 0, курсор выдает каждую единицу данных (вместе с количеством таких данных),
+// иначе - каждые уникальные данные один раз, не обходя узлы.
+// Курсор действителен, пока хэш-мультимножество не изменяется (вставки и удаления, в том числе
+// продолжающие постепенное перестроение, делают его недействительным).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_iter_init(const c_hash_multiset *const _hash_multiset,
+                                    c_hash_multiset_iter *const _iter,
+                                    const size_t _uniques)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_iter == NULL) return -2;
+
+    _iter->position = 0;
+    _iter->chain = NULL;
+    _iter->node = NULL;
+    _iter->index = 0;
+    _iter->uniques = _uniques;
+
+    return 1;
+}
+
+// Выдает очередные данные курсора: в *_data помещаются данные, в *_count (если _count != NULL) -
+// количество таких данных в хэш-мультимножестве.
+// Если данные выданы, возвращает > 0.
+// Если обход завершен, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_iter_next(const c_hash_multiset *const _hash_multiset,
+                                    c_hash_multiset_iter *const _iter,
+                                    const void **const _data,
+                                    size_t *const _count)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_iter == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    for (;;)
+    {
+        // Очередной узел текущей цепочки.
+        if (_iter->node != NULL)
+        {
+            const c_hash_multiset_node *const select_node = _iter->node;
+            const c_hash_multiset_chain *const select_chain = _iter->chain;
+
+            *_data = select_node->data;
+            if (_count != NULL)
+            {
+                *_count = select_chain->count;
+            }
+
+            _iter->node = select_node->next_node;
+            return 1;
+        }
+
+        // Очередные данные массива текущей цепочки (хранение массивом).
+        if ( (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY) &&
+             (_iter->uniques == 0) && (_iter->chain != NULL) )
+        {
+            const c_hash_multiset_chain *const select_chain = _iter->chain;
+            if (_iter->index < select_chain->count)
+            {
+                *_data = chain_item(select_chain, _iter->index++);
+                if (_count != NULL)
+                {
+                    *_count = select_chain->count;
+                }
+                return 1;
+            }
+        }
+
+        // Переходим к следующей цепочке: в той же позиции или в следующих.
+        const c_hash_multiset_chain *select_chain = NULL;
+        if (_iter->chain != NULL)
+        {
+            select_chain = position_chain_next(_hash_multiset, _iter->chain);
+        }
+        if (select_chain == NULL)
+        {
+            const size_t positions_end = positions_count(_hash_multiset);
+            while ( (select_chain == NULL) && (_iter->position < positions_end) )
+            {
+                select_chain = position_chain(_hash_multiset, _iter->position++);
+            }
+        }
+
+        _iter->chain = select_chain;
+
+        if (select_chain == NULL)
+        {
+            return 0;
+        }
+
+        if (_iter->uniques != 0)
+        {
+            *_data = chain_first(_hash_multiset, select_chain);
+            if (_count != NULL)
+            {
+                *_count = select_chain->count;
+            }
+            return 1;
+        }
+
+        if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+        {
+            _iter->index = 0;
+        } else {
+            _iter->node = select_chain->head;
+        }
+    }
+}
+
+// Продолжает обход курсором не более чем на _steps данных, вызывая для каждых
+// _action_data(_context, данные, количество).
+// Если _action_data возвращает 0, обход прерывается (курсор остается на следующих данных).
+// Если обход не завершен (исчерпан бюджет или обход прерван), возвращает > 0.
+// Если обход завершен, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_iter_steps(const c_hash_multiset *const _hash_multiset,
+                                     c_hash_multiset_iter *const _iter,
+                                     size_t (*const _action_data)(void *const _context,
+                                                                  const void *const _data,
+                                                                  const size_t _count),
+                                     void *const _context,
+                                     const size_t _steps)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_iter == NULL) return -2;
+    if (_action_data == NULL) return -3;
+
+    const void *data;
+    size_t count;
+    for (size_t i = 0; i < _steps; ++i)
+    {
+        if (c_hash_multiset_iter_next(_hash_multiset, _iter, &data, &count) == 0)
+        {
+            return 0;
+        }
+        if (_action_data(_context, data, count) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 1;
+}
+
+// Определяет, расширится ли хэш-мультимножество при вставке новых уникальных данных.
+static size_t insert_grows(const c_hash_multiset *const _hash_multiset)
+{
+    if (_hash_multiset->slots_count == 0)
+    {
+        return 1;
+    }
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        const size_t used = _hash_multiset->uniques_count + _hash_multiset->flat_tombstones + 1;
+        return (float)used > _hash_multiset->slots_count * _hash_multiset->max_load_factor;
+    }
+
+    const float load_factor = (float)_hash_multiset->uniques_count / _hash_multiset->slots_count;
+    return load_factor >= _hash_multiset->max_load_factor;
+}
+
+// Заполняет ячейку результатом поиска данных ячейки (_entry->data, _entry->hash).
+// Если данные найдены, возвращает > 0, иначе 0.
+static ptrdiff_t entry_probe(const c_hash_multiset *const _hash_multiset,
+                             c_hash_multiset_entry *const _entry)
+{
+    _entry->chain = NULL;
+    _entry->link = NULL;
+    _entry->position = SIZE_MAX;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        if (_hash_multiset->uniques_count == 0) return 0;
+
+        const size_t e = flat_find(_hash_multiset, _entry->data, _entry->hash);
+        if (e == SIZE_MAX) return 0;
+
+        _entry->chain = &_hash_multiset->flat_entries[e];
+        _entry->position = e;
+        return 1;
+    }
+
+    if (_hash_multiset->slots_count == 0) return 0;
+
+    // Новая цепочка вставляется по связи, на которой закончился поиск, - в конец слота.
+    c_hash_multiset_chain **link = chained_slot(_hash_multiset, _entry->hash);
+    while (*link != NULL)
+    {
+        c_hash_multiset_chain *const select_chain = *link;
+        if (_entry->hash == select_chain->hash)
+        {
+            if (C_HASH_MULTISET_COMP_DATA(_hash_multiset, _entry->data, chain_first(_hash_multiset, select_chain)) > 0)
+            {
+                _entry->chain = select_chain;
+                _entry->link = link;
+                return 1;
+            }
+        }
+        link = &select_chain->next_chain;
+    }
+
+    _entry->link = link;
+    return 0;
+}
+
+// Ищет заданные данные и заполняет ячейку: найденной цепочкой или, если данных нет,
+// местом их вставки. Через ячейку данные затем вставляются, считаются и удаляются без
+// повторного поиска.
+// Ячейка действительна до следующего изменения хэш-мультимножества не через нее
+// (изменения через ячейку оставляют ее действительной).
+// Если данные найдены, возвращает > 0.
+// Если данных нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_entry_find(const c_hash_multiset *const _hash_multiset,
+                                     const void *const _data,
+                                     c_hash_multiset_entry *const _entry)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+    if (_entry == NULL) return -3;
+
+    _entry->data = _data;
+    _entry->hash = C_HASH_MULTISET_HASH_DATA(_hash_multiset, _data);
+
+    return entry_probe(_hash_multiset, _entry);
+}
+
+// Возвращает количество данных ячейки в хэш-мультимножестве.
+// В случае ошибки возвращает 0.
+size_t c_hash_multiset_entry_count(const c_hash_multiset_entry *const _entry)
+{
+    if ( (_entry == NULL) || (_entry->chain == NULL) ) return 0;
+
+    return ((const c_hash_multiset_chain*)_entry->chain)->count;
+}
+
+// Вставляет через ячейку данные _data, идентичные данным, по которым ячейка найдена
+// (например, копию ключа поиска, созданную только при его отсутствии).
+// Если вставка расширяет хэш-мультимножество, место вставки ищется заново, ячейка обновляется
+// и дальше ссылается на _data (прежние данные ячейки могли быть удалены при удалении через нее).
+// В случае успешной вставки возвращает > 0, данные захватываются хэш-мультимножеством.
+// В случае ошибки возвращает < 0, данные не захватываются хэш-мультимножеством.
+ptrdiff_t c_hash_multiset_entry_insert(c_hash_multiset *const _hash_multiset,
+                                       c_hash_multiset_entry *const _entry,
+                                       const void *const _data)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_entry == NULL) return -2;
+    if (_data == NULL) return -3;
+
+    _entry->data = _data;
+
+    if ( (_entry->chain == NULL) && (insert_grows(_hash_multiset) != 0) )
+    {
+        const ptrdiff_t r_code = insert_hashed(_hash_multiset, _data, _entry->hash);
+        entry_probe(_hash_multiset, _entry);
+        return r_code;
+    }
+
+    // Новая цепочка продолжает постепенное перестроение, как и обычная вставка
+    // (перенос цепочек меняет место вставки, поэтому оно ищется заново).
+    if ( (_entry->chain == NULL) && (_hash_multiset->old_slots != NULL) )
+    {
+        migrate(_hash_multiset, migrate_insert_step(_hash_multiset));
+        entry_probe(_hash_multiset, _entry);
+    }
+
+    if (_entry->chain == NULL)
+    {
+        if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+        {
+            _entry->position = flat_occupy(_hash_multiset, _entry->hash);
+            _entry->chain = &_hash_multiset->flat_entries[_entry->position];
+        } else {
+            c_hash_multiset_chain *const new_chain = pool_alloc(_hash_multiset, &_hash_multiset->chains_pool);
+            if (new_chain == NULL)
+            {
+                return -5;
+            }
+
+            c_hash_multiset_chain **const link = _entry->link;
+            new_chain->next_chain = *link;
+            new_chain->head = NULL;
+            new_chain->count = 0;
+            new_chain->hash = _entry->hash;
+            *link = new_chain;
+
+            ++_hash_multiset->uniques_count;
+
+            _entry->chain = new_chain;
+        }
+    }
+
+    c_hash_multiset_chain *const select_chain = _entry->chain;
+    if (chain_push(_hash_multiset, select_chain, _data) < 0)
+    {
+        // Пустая цепочка (запись) существовать не должна.
+        if (select_chain->count == 0)
+        {
+            if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+            {
+                flat_vacate(_hash_multiset, _entry->position);
+                _entry->position = SIZE_MAX;
+            } else {
+                c_hash_multiset_chain **const link = _entry->link;
+                *link = select_chain->next_chain;
+                pool_free(&_hash_multiset->chains_pool, select_chain);
+                --_hash_multiset->uniques_count;
+            }
+            _entry->chain = NULL;
+        }
+        return -4;
+    }
+
+    ++_hash_multiset->nodes_count;
+
+    return 1;
+}
+
+// Заполняет ячейку местом вставки данных, о которых известно, что их в хэш-мультимножестве нет.
+// Ищет только по хэшу и не сравнивает данные: данные ячейки к этому моменту могут быть уже
+// удалены функцией _del_data.
+static void entry_probe_vacant(const c_hash_multiset *const _hash_multiset,
+                               c_hash_multiset_entry *const _entry)
+{
+    _entry->chain = NULL;
+    _entry->link = NULL;
+    _entry->position = SIZE_MAX;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT) return;
+    if (_hash_multiset->slots_count == 0) return;
+
+    c_hash_multiset_chain **link = chained_slot(_hash_multiset, _entry->hash);
+    while (*link != NULL)
+    {
+        link = &(*link)->next_chain;
+    }
+
+    _entry->link = link;
+}
+
+// Убирает опустевшую цепочку (запись) ячейки из хэш-мультимножества.
+// Если после этого хэш-мультимножество сжалось, место вставки ищется заново (только по хэшу).
+static void entry_vacate(c_hash_multiset *const _hash_multiset,
+                         c_hash_multiset_entry *const _entry)
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        flat_vacate(_hash_multiset, _entry->position);
+        _entry->position = SIZE_MAX;
+    } else {
+        c_hash_multiset_chain **const link = _entry->link;
+        c_hash_multiset_chain *const delete_chain = *link;
+        *link = delete_chain->next_chain;
+        pool_free(&_hash_multiset->chains_pool, delete_chain);
+        --_hash_multiset->uniques_count;
+    }
+    _entry->chain = NULL;
+
+    const size_t slots_count = _hash_multiset->slots_count;
+    shrink(_hash_multiset);
+    if (_hash_multiset->slots_count != slots_count)
+    {
+        entry_probe_vacant(_hash_multiset, _entry);
+    }
+}
+
+// Удаляет через ячейку одну единицу ее данных.
+// В случае успешного удаления возвращает > 0.
+// В случае, если данных ячейки в хэш-мультимножестве нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_entry_erase(c_hash_multiset *const _hash_multiset,
+                                      c_hash_multiset_entry *const _entry,
+                                      void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_entry == NULL) return -2;
+
+    if (_entry->chain == NULL) return 0;
+
+    c_hash_multiset_chain *const select_chain = _entry->chain;
+
+    chain_pop(_hash_multiset, select_chain, _del_data);
+
+    --_hash_multiset->nodes_count;
+
+    if (select_chain->count == 0)
+    {
+        entry_vacate(_hash_multiset, _entry);
+    }
+
+    return 1;
+}
+
+// Удаляет через ячейку все единицы ее данных.
+// Возвращает количество удаленных элементов.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_entry_erase_all(c_hash_multiset *const _hash_multiset,
+                                       c_hash_multiset_entry *const _entry,
+                                       void (*const _del_data)(void *const _data),
+                                       size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_entry == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    if (_entry->chain == NULL) return 0;
+
+    c_hash_multiset_chain *const select_chain = _entry->chain;
+
+    chain_drop(_hash_multiset, select_chain, _del_data);
+
+    const size_t count = select_chain->count;
+    _hash_multiset->nodes_count -= count;
+
+    entry_vacate(_hash_multiset, _entry);
+
+    return count;
+}
+
+// Возвращает данные, которые удалит chain_pop(): при хранении узлами - данные первого узла,
+// при хранении массивом - последнюю единицу массива.
+static const void *chain_last(const c_hash_multiset *const _hash_multiset,
+                              const c_hash_multiset_chain *const _chain)
+{
+    if (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+    {
+        return chain_item(_chain, _chain->count - 1);
+    }
+    return _chain->head->data;
+}
+
+// Возвращает количество единиц в хэш-мультимножестве _hash_multiset данных цепочки _chain
+// хэш-мультимножества _owner (хэш цепочки заново не вычисляется).
+static size_t algebra_count(const c_hash_multiset *const _hash_multiset,
+                            const c_hash_multiset *const _owner,
+                            const c_hash_multiset_chain *const _chain)
+{
+    if (_hash_multiset->uniques_count == 0) return 0;
+
+    const c_hash_multiset_chain *const select_chain = find_hashed(_hash_multiset,
+                                                                  chain_first(_owner, _chain),
+                                                                  _chain->hash);
+    return (select_chain != NULL) ? select_chain->count : 0;
+}
+
+// Ищет в хэш-мультимножестве цепочку данных с известным хэшем, в пустом возвращает NULL.
+static c_hash_multiset_chain *algebra_find(const c_hash_multiset *const _hash_multiset,
+                                           const void *const _data,
+                                           const size_t _hash)
+{
+    if (_hash_multiset->uniques_count == 0) return NULL;
+
+    return (c_hash_multiset_chain*)find_hashed(_hash_multiset, _data, _hash);
+}
+
+// Добавляет в цепочку _chain (если NULL - создает ее вставкой) единицу данных с известным хэшем.
+// В случае успеха возвращает > 0, в *_chain помещается цепочка данных.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t algebra_push(c_hash_multiset *const _hash_multiset,
+                              c_hash_multiset_chain **const _chain,
+                              const void *const _data,
+                              const size_t _hash)
+{
+    if (*_chain != NULL)
+    {
+        if (chain_push(_hash_multiset, *_chain, _data) < 0)
+        {
+            return -1;
+        }
+        ++_hash_multiset->nodes_count;
+        return 1;
+    }
+
+    if (insert_hashed(_hash_multiset, _data, _hash) < 0)
+    {
+        return -2;
+    }
+    *_chain = algebra_find(_hash_multiset, _data, _hash);
+
+    return 1;
+}
+
+// Добавляет в хэш-мультимножество первые _count единиц цепочки _chain хэш-мультимножества _source,
+// источник не изменяется (добавляются те же указатели, при хранении по значению - копии ключей).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t algebra_copy(c_hash_multiset *const _hash_multiset,
+                              const c_hash_multiset *const _source,
+                              const c_hash_multiset_chain *const _chain,
+                              const size_t _count)
+{
+    if (_count == 0) return 1;
+
+    c_hash_multiset_chain *target_chain = algebra_find(_hash_multiset, chain_first(_source, _chain), _chain->hash);
+
+    const c_hash_multiset_node *select_node = (_source->storage == C_HASH_MULTISET_STORAGE_NODES) ?
+                                              _chain->head : NULL;
+    for (size_t i = 0; i < _count; ++i)
+    {
+        const void *data;
+        if (select_node != NULL)
+        {
+            data = select_node->data;
+            select_node = select_node->next_node;
+        } else {
+            data = chain_item(_chain, i);
+        }
+
+        if (algebra_push(_hash_multiset, &target_chain, data, _chain->hash) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+// Переносит в хэш-мультимножество _count единиц цепочки _chain хэш-мультимножества _source:
+// единица сначала добавляется, затем снимается с цепочки источника (данные не удаляются).
+// Опустевшая цепочка источника остается на месте (см. drop_empty_chains()).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0, единицы, перенесенные до ошибки, остаются в хэш-мультимножестве.
+static ptrdiff_t algebra_move(c_hash_multiset *const _hash_multiset,
+                              c_hash_multiset *const _source,
+                              c_hash_multiset_chain *const _chain,
+                              const size_t _count)
+{
+    if (_count == 0) return 1;
+
+    c_hash_multiset_chain *target_chain = algebra_find(_hash_multiset, chain_first(_source, _chain), _chain->hash);
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        // При хранении по значению ключ копируется до того, как узел источника освобождается.
+        if (algebra_push(_hash_multiset, &target_chain, chain_last(_source, _chain), _chain->hash) < 0)
+        {
+            return -1;
+        }
+        chain_pop(_source, _chain, NULL);
+        --_source->nodes_count;
+    }
+
+    return 1;
+}
+
+// Удаляет из хэш-мультимножества цепочки (для плоского движка - записи), опустевшие
+// при поэлементном переносе или удалении единиц, после чего при необходимости сжимает слоты.
+static void drop_empty_chains(c_hash_multiset *const _hash_multiset)
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        for (size_t e = 0; e < _hash_multiset->slots_count; ++e)
+        {
+            if ( ( (_hash_multiset->flat_ctrl[e] & C_HASH_MULTISET_CTRL_EMPTY) == 0 ) &&
+                 (_hash_multiset->flat_entries[e].count == 0) )
+            {
+                flat_vacate(_hash_multiset, e);
+            }
+        }
+    } else {
+        // Неперенесенная часть старого массива слотов, затем новый массив.
+        for (size_t part = 0; part < 2; ++part)
+        {
+            c_hash_multiset_chain **const slots = (part == 0) ? _hash_multiset->old_slots : _hash_multiset->slots;
+            const size_t begin = (part == 0) ? _hash_multiset->migrate_pos : 0;
+            const size_t end = (part == 0) ? _hash_multiset->old_slots_count : _hash_multiset->slots_count;
+            if (slots == NULL) continue;
+
+            for (size_t s = begin; s < end; ++s)
+            {
+                c_hash_multiset_chain **link = &slots[s];
+                while (*link != NULL)
+                {
+                    c_hash_multiset_chain *const select_chain = *link;
+                    if (select_chain->count == 0)
+                    {
+                        *link = select_chain->next_chain;
+                        pool_free(&_hash_multiset->chains_pool, select_chain);
+                        --_hash_multiset->uniques_count;
+                    } else {
+                        link = &select_chain->next_chain;
+                    }
+                }
+            }
+        }
+    }
+
+    shrink(_hash_multiset);
+}
+
+// Создает пустое хэш-мультимножество с параметрами _hash_multiset для результата операции.
+// Распределитель с release принадлежит только одному хэш-мультимножеству, поэтому в этом случае
+// результат использует распределитель по умолчанию.
+static c_hash_multiset *algebra_create(const c_hash_multiset *const _hash_multiset)
+{
+    c_hash_multiset_options options;
+    c_hash_multiset_options_init(&options);
+
+    if (_hash_multiset->allocator.release == NULL)
+    {
+        options.allocator = &_hash_multiset->allocator;
+        options.allocator_context = _hash_multiset->allocator_context;
+    }
+    options.engine = _hash_multiset->engine;
+    options.migrate_step = _hash_multiset->migrate_step;
+    options.growth_policy = _hash_multiset->growth_policy;
+    options.growth_factor = _hash_multiset->growth_factor;
+    options.min_load_factor = _hash_multiset->min_load_factor;
+    options.key_size = _hash_multiset->key_size;
+    options.storage = _hash_multiset->storage;
+    options.fast_clear = _hash_multiset->fast_clear;
+
+    return c_hash_multiset_create_ex(_hash_multiset->hash_data, _hash_multiset->comp_data,
+                                     0, _hash_multiset->max_load_factor, &options, NULL);
+}
+
+// Количество единиц цепочки левого операнда, попадающих в результат операции.
+static size_t algebra_left_count(const size_t _operation,
+                                 const size_t _left_count,
+                                 const size_t _right_count)
+{
+    switch (_operation)
+    {
+        case C_HASH_MULTISET_ALGEBRA_INTERSECTION:
+            return (_left_count < _right_count) ? _left_count : _right_count;
+        case C_HASH_MULTISET_ALGEBRA_DIFFERENCE:
+            return (_left_count > _right_count) ? _left_count - _right_count : 0;
+        default:
+            return _left_count;
+    }
+}
+
+// Количество единиц цепочки правого операнда, попадающих в результат операции
+// (пересечение и разность правых единиц не берут).
+static size_t algebra_right_count(const size_t _operation,
+                                  const size_t _left_count,
+                                  const size_t _right_count)
+{
+    switch (_operation)
+    {
+        case C_HASH_MULTISET_ALGEBRA_SUM:
+            return _right_count;
+        case C_HASH_MULTISET_ALGEBRA_UNION:
+            return (_right_count > _left_count) ? _right_count - _left_count : 0;
+        default:
+            return 0;
+    }
+}
+
+// Записывает результат операции в новое хэш-мультимножество, операнды не изменяются.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t algebra_result(const size_t _operation,
+                                const c_hash_multiset *const _left,
+                                const c_hash_multiset *const _right,
+                                c_hash_multiset **const _result)
+{
+    c_hash_multiset *const new_hash_multiset = algebra_create(_left);
+    if (new_hash_multiset == NULL)
+    {
+        return -1;
+    }
+
+    // Расширяем результат заранее в расчете на то, что все уникальные данные операндов различны.
+    size_t uniques_count = _left->uniques_count;
+    if ( (_operation == C_HASH_MULTISET_ALGEBRA_SUM) ||
+         (_operation == C_HASH_MULTISET_ALGEBRA_UNION) )
+    {
+        uniques_count += _right->uniques_count;
+    } else if ( (_operation == C_HASH_MULTISET_ALGEBRA_INTERSECTION) &&
+                (_right->uniques_count < uniques_count) ) {
+        uniques_count = _right->uniques_count;
+    }
+    c_hash_multiset_reserve(new_hash_multiset, uniques_count);
+
+    ptrdiff_t r_code = 1;
+
+    // Цепочка за цепочкой: количество единиц в другом операнде определяется одним поиском по хэшу цепочки.
+    for (size_t p = 0; (p < positions_count(_left)) && (r_code > 0); ++p)
+    {
+        for (const c_hash_multiset_chain *select_chain = position_chain(_left, p);
+             (select_chain != NULL) && (r_code > 0);
+             select_chain = position_chain_next(_left, select_chain))
+        {
+            const size_t right_count = (_operation != C_HASH_MULTISET_ALGEBRA_SUM) ?
+                                       algebra_count(_right, _left, select_chain) : 0;
+            r_code = algebra_copy(new_hash_multiset, _left, select_chain,
+                                  algebra_left_count(_operation, select_chain->count, right_count));
+        }
+    }
+
+    if ( (_operation == C_HASH_MULTISET_ALGEBRA_SUM) ||
+         (_operation == C_HASH_MULTISET_ALGEBRA_UNION) )
+    {
+        for (size_t p = 0; (p < positions_count(_right)) && (r_code > 0); ++p)
+        {
+            for (const c_hash_multiset_chain *select_chain = position_chain(_right, p);
+                 (select_chain != NULL) && (r_code > 0);
+                 select_chain = position_chain_next(_right, select_chain))
+            {
+                const size_t left_count = (_operation != C_HASH_MULTISET_ALGEBRA_SUM) ?
+                                          algebra_count(_left, _right, select_chain) : 0;
+                r_code = algebra_copy(new_hash_multiset, _right, select_chain,
+                                      algebra_right_count(_operation, left_count, select_chain->count));
+            }
+        }
+    }
+
+    if (r_code < 0)
+    {
+        c_hash_multiset_delete(new_hash_multiset, NULL);
+        return -2;
+    }
+
+    *_result = new_hash_multiset;
+
+    return 1;
+}
+
+// Записывает результат операции в левый операнд.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t algebra_in_place(const size_t _operation,
+                                  c_hash_multiset *const _left,
+                                  c_hash_multiset *const _right,
+                                  void (*const _del_data)(void *const _data))
+{
+    if ( (_operation == C_HASH_MULTISET_ALGEBRA_INTERSECTION) ||
+         (_operation == C_HASH_MULTISET_ALGEBRA_DIFFERENCE) )
+    {
+        // Правый операнд не изменяется, из цепочек левого удаляются лишние единицы.
+        for (size_t p = 0; p < positions_count(_left); ++p)
+        {
+            for (c_hash_multiset_chain *select_chain = (c_hash_multiset_chain*)position_chain(_left, p);
+                 select_chain != NULL;
+                 select_chain = (c_hash_multiset_chain*)position_chain_next(_left, select_chain))
+            {
+                const size_t right_count = algebra_count(_right, _left, select_chain);
+                const size_t count = select_chain->count -
+                                     algebra_left_count(_operation, select_chain->count, right_count);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    chain_pop(_left, select_chain, _del_data);
+                }
+                _left->nodes_count -= count;
+            }
+        }
+        drop_empty_chains(_left);
+
+        return 1;
+    }
+
+    if (_operation == C_HASH_MULTISET_ALGEBRA_SUM)
+    {
+        // Совместимые хэш-мультимножества сливаются без поэлементного переноса:
+        // цепочки и узлы правого операнда переходят к левому вместе с блоками пулов.
+        const ptrdiff_t r_code = c_hash_multiset_merge(_left, _right, 1);
+        if (r_code >= 0)
+        {
+            return 1;
+        }
+        if ( (r_code != -4) && (r_code != -5) && (r_code != -6) )
+        {
+            return -1;
+        }
+    }
+
+    c_hash_multiset_reserve(_left, _left->uniques_count + _right->uniques_count);
+
+    for (size_t p = 0; p < positions_count(_right); ++p)
+    {
+        for (c_hash_multiset_chain *select_chain = (c_hash_multiset_chain*)position_chain(_right, p);
+             select_chain != NULL;
+             select_chain = (c_hash_multiset_chain*)position_chain_next(_right, select_chain))
+        {
+            const size_t left_count = (_operation != C_HASH_MULTISET_ALGEBRA_SUM) ?
+                                      algebra_count(_left, _right, select_chain) : 0;
+            if (algebra_move(_left, _right, select_chain,
+                             algebra_right_count(_operation, left_count, select_chain->count)) < 0)
+            {
+                drop_empty_chains(_right);
+                return -2;
+            }
+        }
+    }
+
+    // Оставшиеся в правом операнде единицы в результат не вошли.
+    c_hash_multiset_clear(_right, _del_data);
+
+    return 1;
+}
+
+// Общая часть операций алгебры хэш-мультимножеств.
+static ptrdiff_t algebra(const size_t _operation,
+                         c_hash_multiset *const _left,
+                         c_hash_multiset *const _right,
+                         c_hash_multiset **const _result,
+                         void (*const _del_data)(void *const _data))
+{
+    if (_left == NULL) return -1;
+    if (_right == NULL) return -2;
+    if ( (_result == NULL) && (_left == _right) ) return -3;
+
+    if ( (_left->hash_data != _right->hash_data) ||
+         (_left->comp_data != _right->comp_data) ||
+         (_left->key_size != _right->key_size) )
+    {
+        return -4;
+    }
+
+    if (_result != NULL)
+    {
+        *_result = NULL;
+        if (algebra_result(_operation, _left, _right, _result) < 0)
+        {
+            return -5;
+        }
+    } else {
+        if (algebra_in_place(_operation, _left, _right, _del_data) < 0)
+        {
+            return -5;
+        }
+    }
+
+    return 1;
+}
+
+// Сумма хэш-мультимножеств: количество единиц каждых данных - l + r.
+// Если _result == NULL, все единицы _right переносятся в _left (совместимые хэш-мультимножества
+// цепочного движка с хранением узлами сливаются c_hash_multiset_merge() без копирования узлов,
+// иначе единицы переносятся поэлементно), после чего _right становится пустым.
+// Если _result != NULL, операнды не изменяются, а в *_result помещается новое хэш-мультимножество
+// с параметрами _left; оно ссылается на данные операндов (при хранении по значению - хранит копии),
+// поэтому удалять его следует без функции удаления данных.
+// Хэш-мультимножества должны использовать одни и те же функции хэша и сравнения и один размер ключа.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0 (в том числе -5 при нехватке памяти: при _result == NULL единицы,
+// перенесенные до ошибки, остаются в _left, остальные - в _right, ни одна единица не теряется).
+ptrdiff_t c_hash_multiset_sum(c_hash_multiset *const _left,
+                              c_hash_multiset *const _right,
+                              c_hash_multiset **const _result)
+{
+    return algebra(C_HASH_MULTISET_ALGEBRA_SUM, _left, _right, _result, NULL);
+}
+
+// Объединение хэш-мультимножеств: количество единиц каждых данных - max(l, r).
+// Если _result == NULL, в _left переносятся недостающие единицы _right, остальные единицы _right
+// удаляются с помощью _del_data (если != NULL), и _right становится пустым.
+// Если _result != NULL, операнды не изменяются (_del_data не используется), результат - как в
+// c_hash_multiset_sum().
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_union(c_hash_multiset *const _left,
+                                c_hash_multiset *const _right,
+                                c_hash_multiset **const _result,
+                                void (*const _del_data)(void *const _data))
+{
+    return algebra(C_HASH_MULTISET_ALGEBRA_UNION, _left, _right, _result, _del_data);
+}
+
+// Пересечение хэш-мультимножеств: количество единиц каждых данных - min(l, r).
+// Если _result == NULL, лишние единицы _left удаляются с помощью _del_data (если != NULL),
+// _right не изменяется.
+// Если _result != NULL, операнды не изменяются (_del_data не используется), результат - как в
+// c_hash_multiset_sum().
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_intersection(c_hash_multiset *const _left,
+                                       c_hash_multiset *const _right,
+                                       c_hash_multiset **const _result,
+                                       void (*const _del_data)(void *const _data))
+{
+    return algebra(C_HASH_MULTISET_ALGEBRA_INTERSECTION, _left, _right, _result, _del_data);
+}
+
+// Разность хэш-мультимножеств: количество единиц каждых данных - max(0, l - r).
+// Если _result == NULL, лишние единицы _left удаляются с помощью _del_data (если != NULL),
+// _right не изменяется.
+// Если _result != NULL, операнды не изменяются (_del_data не используется), результат - как в
+// c_hash_multiset_sum().
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_difference(c_hash_multiset *const _left,
+                                     c_hash_multiset *const _right,
+                                     c_hash_multiset **const _result,
+                                     void (*const _del_data)(void *const _data))
+{
+    return algebra(C_HASH_MULTISET_ALGEBRA_DIFFERENCE, _left, _right, _result, _del_data);
+}
+
+// Возвращает номер столбца гистограммы статистики для значения, столбцы которой - степени двойки.
+static size_t stats_log_bucket(size_t _value)
+{
+    size_t bucket = 0;
+    while ( (_value > 1) && (bucket < C_HASH_MULTISET_STATS_BUCKETS - 1) )
+    {
+        _value >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+// Возвращает количество байт, выделенных пулом под блоки.
+static size_t stats_pool_bytes(const c_hash_multiset_pool *const _pool)
+{
+    size_t bytes = 0;
+    for (const c_hash_multiset_slab *select_slab = _pool->slabs; select_slab != NULL; select_slab = select_slab->next_slab)
+    {
+        bytes += C_HASH_MULTISET_SLAB_HEADER + select_slab->capacity * _pool->object_size;
+    }
+    return bytes;
+}
+
+// Возвращает количество байт внешнего массива повторов цепочки (0, если массива нет).
+static size_t stats_items_bytes(const c_hash_multiset *const _hash_multiset,
+                                const c_hash_multiset_chain *const _chain)
+{
+    if ( (_hash_multiset->storage != C_HASH_MULTISET_STORAGE_ARRAY) || (_chain->count < 2) )
+    {
+        return 0;
+    }
+    return sizeof(c_hash_multiset_items) + _chain->items->capacity * sizeof(void*);
+}
+
+// Сравнение хэшей для сортировки.
+static int stats_hash_order(const void *const _a,
+                            const void *const _b)
+{
+    const size_t a = *(const size_t*)_a,
+                 b = *(const size_t*)_b;
+    return (a > b) - (a < b);
+}
+
+// Заполняет _stats структурной статистикой хэш-мультимножества: гистограммами цепочек в слотах
+// и повторов в цепочках, совпадениями полных хэшей, пустыми слотами и памятью по категориям.
+// Обходит все слоты; для плоского движка совпадения хэшей находятся сортировкой хэшей
+// во временном массиве.
+// Счетчики вызовов и перестроений заполняются, только если библиотека собрана
+// с C_HASH_MULTISET_COUNTERS (иначе 0).
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_stats(const c_hash_multiset *const _hash_multiset,
+                                c_hash_multiset_stats_report *const _stats)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_stats == NULL) return -2;
+
+    memset(_stats, 0, sizeof(c_hash_multiset_stats_report));
+
+    _stats->slots_count = _hash_multiset->slots_count;
+    _stats->nodes_count = _hash_multiset->nodes_count;
+    _stats->uniques_count = _hash_multiset->uniques_count;
+    _stats->max_load_factor = _hash_multiset->max_load_factor;
+    if (_hash_multiset->slots_count > 0)
+    {
+        _stats->load_factor = (float)_hash_multiset->uniques_count / _hash_multiset->slots_count;
+    }
+
+    // Память внешних массивов повторов (хранение массивом).
+    size_t memory_items = 0;
+
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        size_t *hashes = NULL;
+        if (_hash_multiset->uniques_count > 0)
+        {
+            hashes = memory_alloc(_hash_multiset, _hash_multiset->uniques_count * sizeof(size_t));
+            if (hashes == NULL)
+            {
+                return -3;
+            }
+        }
+
+        size_t h = 0;
+        for (size_t e = 0; e < _hash_multiset->slots_count; ++e)
+        {
+            const uint8_t ctrl = _hash_multiset->flat_ctrl[e];
+            if ( (ctrl & C_HASH_MULTISET_CTRL_EMPTY) != 0 )
+            {
+                ++_stats->chains_histogram[0];
+                ++_stats->empty_slots;
+                if (ctrl == C_HASH_MULTISET_CTRL_DELETED)
+                {
+                    ++_stats->tombstones;
+                }
+                continue;
+            }
+
+            const c_hash_multiset_chain *const select_entry = &_hash_multiset->flat_entries[e];
+            ++_stats->chains_histogram[1];
+            ++_stats->duplicates_histogram[stats_log_bucket(select_entry->count)];
+            if (select_entry->count > _stats->max_duplicates)
+            {
+                _stats->max_duplicates = select_entry->count;
+            }
+            memory_items += stats_items_bytes(_hash_multiset, select_entry);
+            hashes[h++] = select_entry->hash;
+        }
+        _stats->max_chains = (_hash_multiset->uniques_count > 0) ? 1 : 0;
+
+        if (h > 1)
+        {
+            qsort(hashes, h, sizeof(size_t), stats_hash_order);
+            for (size_t i = 1; i < h; ++i)
+            {
+                if (hashes[i] == hashes[i - 1])
+                {
+                    ++_stats->hash_collisions;
+                }
+            }
+        }
+        memory_free(_hash_multiset, hashes);
+
+        _stats->memory_slots = _hash_multiset->slots_count * (sizeof(c_hash_multiset_chain) + 1);
+    } else {
+        // Сначала неперенесенная часть старого массива слотов, затем новый массив.
+        for (size_t part = 0; part < 2; ++part)
+        {
+            c_hash_multiset_chain *const *const slots = (part == 0) ? _hash_multiset->old_slots :
+                                                                      _hash_multiset->slots;
+            const size_t slots_end = (part == 0) ? _hash_multiset->old_slots_count :
+                                                   _hash_multiset->slots_count;
+            for (size_t s = (part == 0) ? _hash_multiset->migrate_pos : 0; s < slots_end; ++s)
+            {
+                size_t chains = 0;
+                for (const c_hash_multiset_chain *select_chain = slots[s]; select_chain != NULL; select_chain = select_chain->next_chain)
+                {
+                    ++chains;
+                    ++_stats->duplicates_histogram[stats_log_bucket(select_chain->count)];
+                    if (select_chain->count > _stats->max_duplicates)
+                    {
+                        _stats->max_duplicates = select_chain->count;
+                    }
+                    memory_items += stats_items_bytes(_hash_multiset, select_chain);
+
+                    // Цепочки с одинаковым полным хэшем всегда оказываются в одном слоте.
+                    for (const c_hash_multiset_chain *prev_chain = slots[s]; prev_chain != select_chain; prev_chain = prev_chain->next_chain)
+                    {
+                        if (prev_chain->hash == select_chain->hash)
+                        {
+                            ++_stats->hash_collisions;
+                            break;
+                        }
+                    }
+                }
+
+                // Пустые слоты считаются только в новом массиве.
+                if ( (chains == 0) && (part == 1) )
+                {
+                    ++_stats->empty_slots;
+                }
+                if ( (chains > 0) || (part == 1) )
+                {
+                    ++_stats->chains_histogram[(chains < C_HASH_MULTISET_STATS_BUCKETS) ? chains :
+                                                                                       C_HASH_MULTISET_STATS_BUCKETS - 1];
+                }
+                if (chains > _stats->max_chains)
+                {
+                    _stats->max_chains = chains;
+                }
+            }
+        }
+
+        _stats->memory_slots = (_hash_multiset->slots_count + _hash_multiset->old_slots_count) *
+                               sizeof(c_hash_multiset_chain*);
+        _stats->memory_chains = _hash_multiset->uniques_count * sizeof(c_hash_multiset_chain);
+    }
+
+    // При хранении массивом узлов нет, вместо них учитываются внешние массивы повторов.
+    const size_t memory_pool_nodes = (_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY) ? 0 :
+                                     _hash_multiset->nodes_count * _hash_multiset->nodes_pool.object_size;
+    _stats->memory_nodes = memory_pool_nodes + memory_items;
+
+    // Память пулов, не занятая цепочками и узлами (заголовки блоков, свободные и неразмеченные объекты).
+    const size_t pools_bytes = stats_pool_bytes(&_hash_multiset->chains_pool) +
+                               stats_pool_bytes(&_hash_multiset->nodes_pool);
+    _stats->memory_pools_free = pools_bytes - _stats->memory_chains - memory_pool_nodes;
+
+    _stats->memory_total = sizeof(c_hash_multiset) + _stats->memory_slots + pools_bytes + memory_items;
+
+#if defined(C_HASH_MULTISET_COUNTERS)
+    _stats->hash_calls = _hash_multiset->counters.hash_calls;
+    _stats->comp_calls = _hash_multiset->counters.comp_calls;
+    _stats->resizes = _hash_multiset->counters.resizes;
+#endif
+
+    return 1;
+}
+
+#if defined(C_HASH_MULTISET_LATENCY)
+// Задает обработчики начала и конца перестроения и очистки хэш-мультимножества
+// (_hooks == NULL - обработчиков нет). Обработчики вызываются в потоке операции.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_set_hooks(c_hash_multiset *const _hash_multiset,
+                                    const c_hash_multiset_hooks *const _hooks)
+{
+    if (_hash_multiset == NULL) return -1;
+
+    if (_hooks != NULL)
+    {
+        _hash_multiset->hooks = *_hooks;
+    } else {
+        memset(&_hash_multiset->hooks, 0, sizeof(c_hash_multiset_hooks));
+    }
+
+    return 1;
+}
+
+// Копирует в _report гистограммы задержек операций хэш-мультимножества.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_latency(const c_hash_multiset *const _hash_multiset,
+                                  c_hash_multiset_latency_report *const _report)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_report == NULL) return -2;
+
+    memcpy(_report->histogram, _hash_multiset->latency, sizeof(_report->histogram));
+
+    return 1;
+}
+
+// Обнуляет гистограммы задержек операций хэш-мультимножества.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_latency_reset(c_hash_multiset *const _hash_multiset)
+{
+    if (_hash_multiset == NULL) return -1;
+
+    memset(_hash_multiset->latency, 0, sizeof(_hash_multiset->latency));
+
+    return 1;
+}
+#endif
+
+// Размер буфера потока снимка.
+#define C_HASH_MULTISET_STREAM_BUFFER ( (size_t) 8192 )
+
+// Начальный размер буфера сериализованных данных.
+#define C_HASH_MULTISET_SNAPSHOT_DATA ( (size_t) 256 )
+
+// Версия формата снимка.
+#define C_HASH_MULTISET_SNAPSHOT_VERSION ( (uint8_t) 1 )
+
+// Буферизованный поток снимка.
+typedef struct s_c_hash_multiset_stream
+{
+    FILE *file;
+    // Позиция в буфере и количество байт в буфере (при чтении).
+    size_t position,
+           size;
+    uint8_t buffer[C_HASH_MULTISET_STREAM_BUFFER];
+} c_hash_multiset_stream;
+
+// Записывает содержимое буфера потока в файл.
+// В случае успеха возвращает > 0, в случае ошибки записи - < 0.
+static ptrdiff_t stream_flush(c_hash_multiset_stream *const _stream)
+{
+    if ( (_stream->position > 0) &&
+         (fwrite(_stream->buffer, 1, _stream->position, _stream->file) != _stream->position) )
+    {
+        return -1;
+    }
+    _stream->position = 0;
+    return 1;
+}
+
+// Записывает байты в поток.
+// В случае успеха возвращает > 0, в случае ошибки записи - < 0.
+static ptrdiff_t stream_write(c_hash_multiset_stream *const _stream,
+                              const void *const _bytes,
+                              const size_t _size)
+{
+    if (_size > C_HASH_MULTISET_STREAM_BUFFER - _stream->position)
+    {
+        if (stream_flush(_stream) < 0)
+        {
+            return -1;
+        }
+        // Большой блок пишется напрямую.
+        if (_size > C_HASH_MULTISET_STREAM_BUFFER)
+        {
+            return (fwrite(_bytes, 1, _size, _stream->file) == _size) ? 1 : -1;
+        }
+    }
+    memcpy(_stream->buffer + _stream->position, _bytes, _size);
+    _stream->position += _size;
+    return 1;
+}
+
+// Читает байты из потока.
+// В случае успеха возвращает > 0, если файл закончился раньше или произошла ошибка чтения - < 0.
+static ptrdiff_t stream_read(c_hash_multiset_stream *const _stream,
+                             void *const _bytes,
+                             const size_t _size)
+{
+    uint8_t *bytes = _bytes;
+    size_t size = _size;
+    while (size > 0)
+    {
+        if (_stream->position == _stream->size)
+        {
+            // Большой остаток читается напрямую.
+            if (size >= C_HASH_MULTISET_STREAM_BUFFER)
+            {
+                return (fread(bytes, 1, size, _stream->file) == size) ? 1 : -1;
+            }
+            _stream->position = 0;
+            _stream->size = fread(_stream->buffer, 1, C_HASH_MULTISET_STREAM_BUFFER, _stream->file);
+            if (_stream->size == 0)
+            {
+                return -1;
+            }
+        }
+        size_t part = _stream->size - _stream->position;
+        if (part > size)
+        {
+            part = size;
+        }
+        memcpy(bytes, _stream->buffer + _stream->position, part);
+        _stream->position += part;
+        bytes += part;
+        size -= part;
+    }
+    return 1;
+}
+
+// Возвращает файлу байты, прочитанные в буфер потока сверх нужного, так что файл оказывается
+// сразу за прочитанными данными.
+// В случае успеха возвращает > 0, если позиционирование файла невозможно - < 0.
+static ptrdiff_t stream_unread(c_hash_multiset_stream *const _stream)
+{
+    const size_t rest = _stream->size - _stream->position;
+    if (rest == 0) return 1;
+
+    if (fseek(_stream->file, -(long)rest, SEEK_CUR) != 0)
+    {
+        return -1;
+    }
+    _stream->position = _stream->size;
+    return 1;
+}
+
+// Записывает 64-битное число в порядке little-endian.
+static ptrdiff_t stream_write_u64(c_hash_multiset_stream *const _stream,
+                                  const uint64_t _value)
+{
+    uint8_t bytes[8];
+    for (size_t i = 0; i < 8; ++i)
+    {
+        bytes[i] = (uint8_t)(_value >> (8 * i));
+    }
+    return stream_write(_stream, bytes, 8);
+}
+
+// Читает 64-битное число в порядке little-endian.
+static ptrdiff_t stream_read_u64(c_hash_multiset_stream *const _stream,
+                                 uint64_t *const _value)
+{
+    uint8_t bytes[8];
+    if (stream_read(_stream, bytes, 8) < 0)
+    {
+        return -1;
+    }
+    *_value = 0;
+    for (size_t i = 0; i < 8; ++i)
+    {
+        *_value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return 1;
+}
+
+// Записывает число переменной длины (по 7 бит в байте, старший бит - признак продолжения).
+static ptrdiff_t stream_write_varint(c_hash_multiset_stream *const _stream,
+                                     uint64_t _value)
+{
+    uint8_t bytes[10];
+    size_t size = 0;
+    while (_value >= 0x80)
+    {
+        bytes[size++] = (uint8_t)(_value | 0x80);
+        _value >>= 7;
+    }
+    bytes[size++] = (uint8_t)_value;
+    return stream_write(_stream, bytes, size);
+}
+
+// Читает число переменной длины.
+// В случае ошибки чтения или неверной записи числа возвращает < 0.
+static ptrdiff_t stream_read_varint(c_hash_multiset_stream *const _stream,
+                                    uint64_t *const _value)
+{
+    *_value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7)
+    {
+        uint8_t byte;
+        if (stream_read(_stream, &byte, 1) < 0)
+        {
+            return -1;
+        }
+        *_value |= (uint64_t)(byte & 0x7F) << shift;
+        if ( (byte & 0x80) == 0 )
+        {
+            return 1;
+        }
+    }
+    return -2;
+}
+
+// Сохраняет хэш-мультимножество в файл компактным снимком:
+// заголовок (сигнатура "CHMS", версия, размер хэша, количество слотов, уникальных данных и
+// элементов, максимальная загруженность), затем для каждых уникальных данных - хранимый хэш,
+// количество повторов и данные, сериализованные функцией _serialize_data.
+// _serialize_data помещает представление данных в _buffer, если оно умещается в _size байт,
+// и возвращает размер представления (если он больше _size, функция вызывается еще раз
+// с буфером достаточного размера); в случае ошибки возвращает SIZE_MAX.
+// Сохраняются данные первого узла каждой цепочки, повторы должны быть равны им.
+// Файл открывается и закрывается вызывающим, запись начинается с текущей позиции.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_save(const c_hash_multiset *const _hash_multiset,
+                               FILE *const _file,
+                               size_t (*const _serialize_data)(const void *const _data,
+                                                               void *const _buffer,
+                                                               const size_t _size))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_file == NULL) return -2;
+    if (_serialize_data == NULL) return -3;
+
+    c_hash_multiset_stream stream;
+    stream.file = _file;
+    stream.position = 0;
+    stream.size = 0;
+
+    size_t data_capacity = C_HASH_MULTISET_SNAPSHOT_DATA;
+    void *data_buffer = memory_alloc(_hash_multiset, data_capacity);
+    if (data_buffer == NULL)
+    {
+        return -4;
+    }
+
+    uint32_t load_factor_bits;
+    memcpy(&load_factor_bits, &_hash_multiset->max_load_factor, sizeof(uint32_t));
+
+    const uint8_t header[6] = { 'C', 'H', 'M', 'S', C_HASH_MULTISET_SNAPSHOT_VERSION, (uint8_t)sizeof(size_t) };
+    ptrdiff_t r_code = stream_write(&stream, header, sizeof(header));
+    if (r_code > 0) r_code = stream_write_u64(&stream, _hash_multiset->slots_count);
+    if (r_code > 0) r_code = stream_write_u64(&stream, _hash_multiset->uniques_count);
+    if (r_code > 0) r_code = stream_write_u64(&stream, _hash_multiset->nodes_count);
+    if (r_code > 0) r_code = stream_write_u64(&stream, load_factor_bits);
+    if (r_code < 0)
+    {
+        memory_free(_hash_multiset, data_buffer);
+        return -6;
+    }
+
+    const size_t positions = positions_count(_hash_multiset);
+    for (size_t p = 0; p < positions; ++p)
+    {
+        for (const c_hash_multiset_chain *select_chain = position_chain(_hash_multiset, p);
+             select_chain != NULL;
+             select_chain = position_chain_next(_hash_multiset, select_chain))
+        {
+            size_t size = _serialize_data(chain_first(_hash_multiset, select_chain), data_buffer, data_capacity);
+            if ( (size != SIZE_MAX) && (size > data_capacity) )
+            {
+                memory_free(_hash_multiset, data_buffer);
+                data_capacity = size;
+                data_buffer = memory_alloc(_hash_multiset, data_capacity);
+                if (data_buffer == NULL)
+                {
+                    return -4;
+                }
+                size = _serialize_data(chain_first(_hash_multiset, select_chain), data_buffer, data_capacity);
+            }
+            if ( (size == SIZE_MAX) || (size > data_capacity) )
+            {
+                memory_free(_hash_multiset, data_buffer);
+                return -5;
+            }
+
+            r_code = stream_write_u64(&stream, select_chain->hash);
+            if (r_code > 0) r_code = stream_write_varint(&stream, select_chain->count);
+            if (r_code > 0) r_code = stream_write_varint(&stream, size);
+            if (r_code > 0) r_code = stream_write(&stream, data_buffer, size);
+            if (r_code < 0)
+            {
+                memory_free(_hash_multiset, data_buffer);
+                return -6;
+            }
+        }
+    }
+
+    memory_free(_hash_multiset, data_buffer);
+
+    if (stream_flush(&stream) < 0)
+    {
+        return -6;
+    }
+
+    return 1;
+}
+
+// Создает в хэш-мультимножестве пустую цепочку (для плоского движка - запись) уникальных данных
+// с известным хэшем без поиска и сравнения (данные заведомо отсутствуют в хэш-мультимножестве,
+// место под них есть).
+// В случае ошибки возвращает NULL.
+static c_hash_multiset_chain *place_empty(c_hash_multiset *const _hash_multiset,
+                                          const size_t _hash)
+{
+    if (_hash_multiset->engine == C_HASH_MULTISET_ENGINE_FLAT)
+    {
+        return &_hash_multiset->flat_entries[flat_occupy(_hash_multiset, _hash)];
+    }
+
+    c_hash_multiset_chain *const new_chain = pool_alloc(_hash_multiset, &_hash_multiset->chains_pool);
+    if (new_chain == NULL)
+    {
+        return NULL;
+    }
+    c_hash_multiset_chain **const slot = chained_slot(_hash_multiset, _hash);
+    new_chain->next_chain = *slot;
+    *slot = new_chain;
+    new_chain->head = NULL;
+    new_chain->count = 0;
+    new_chain->hash = _hash;
+
+    ++_hash_multiset->uniques_count;
+
+    return new_chain;
+}
+
+// Встраивает в хэш-мультимножество уникальные данные с известным хэшем и готовой цепочкой
+// (собранной вне хэш-мультимножества), см. place_empty().
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t place_unique(c_hash_multiset *const _hash_multiset,
+                              const size_t _hash,
+                              const c_hash_multiset_chain *const _pending)
+{
+    c_hash_multiset_chain *const select_chain = place_empty(_hash_multiset, _hash);
+    if (select_chain == NULL)
+    {
+        return -1;
+    }
+
+    select_chain->head = _pending->head;
+    select_chain->count = _pending->count;
+
+    _hash_multiset->nodes_count += _pending->count;
+
+    return 1;
+}
+
+// Загружает хэш-мультимножество из снимка, сохраненного c_hash_multiset_save().
+// Функция хэша должна совпадать с использованной при сохранении: хэши не вычисляются заново,
+// функция сравнения не вызывается, слоты размещаются один раз под итоговое количество уникальных данных.
+// _deserialize_data создает данные из представления размером _size байт
+// (для каждого повтора - отдельно), в случае ошибки возвращает NULL.
+// _del_data (может быть NULL) удаляет уже созданные данные, если загрузка не удалась
+// (при хранении по значению - каждые созданные данные сразу после копирования в узел).
+// Параметры создания (_options, может быть NULL) - как у c_hash_multiset_create_ex(),
+// количество слотов и максимальная загруженность берутся из снимка.
+// Файл читается с текущей позиции до конца снимка, после успешной загрузки он стоит сразу
+// за снимком: байты, прочитанные в буфер сверх снимка, возвращаются файлу fseek() (если файл
+// не допускает позиционирования, а за снимком есть данные, загрузка завершается ошибкой 9).
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_multiset *c_hash_multiset_load(FILE *const _file,
+                                      size_t (*const _hash_data)(const void *const _data),
+                                      size_t (*const _comp_data)(const void *const _data_a,
+                                                                 const void *const _data_b),
+                                      void *(*const _deserialize_data)(const void *const _buffer,
+                                                                       const size_t _size),
+                                      void (*const _del_data)(void *const _data),
+                                      const c_hash_multiset_options *const _options,
+                                      size_t *const _error)
+{
+    if (_file == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_deserialize_data == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+
+    c_hash_multiset_stream stream;
+    stream.file = _file;
+    stream.position = 0;
+    stream.size = 0;
+
+    uint8_t header[6];
+    uint64_t slots_count,
+             uniques_count,
+             nodes_count,
+             load_factor_bits;
+    if ( (stream_read(&stream, header, sizeof(header)) < 0) ||
+         (stream_read_u64(&stream, &slots_count) < 0) ||
+         (stream_read_u64(&stream, &uniques_count) < 0) ||
+         (stream_read_u64(&stream, &nodes_count) < 0) ||
+         (stream_read_u64(&stream, &load_factor_bits) < 0) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+    if ( (memcmp(header, "CHMS", 4) != 0) ||
+         (header[4] != C_HASH_MULTISET_SNAPSHOT_VERSION) ||
+         (header[5] != sizeof(size_t)) ||
+         (slots_count > SIZE_MAX) || (uniques_count > nodes_count) || (nodes_count > SIZE_MAX) ||
+         (load_factor_bits > UINT32_MAX) )
+    {
+        error_set(_error, 4);
+        return NULL;
+    }
+
+    const uint32_t load_factor_bits_32 = (uint32_t)load_factor_bits;
+    float max_load_factor;
+    memcpy(&max_load_factor, &load_factor_bits_32, sizeof(float));
+
+    c_hash_multiset *const new_hash_multiset = c_hash_multiset_create_ex(_hash_data, _comp_data,
+                                                                         (size_t)slots_count,
+                                                                         max_load_factor,
+                                                                         _options,
+                                                                         NULL);
+    if (new_hash_multiset == NULL)
+    {
+        error_set(_error, 5);
+        return NULL;
+    }
+
+    // Слоты под все уникальные данные размещаются сразу (движок или политика роста
+    // могли отличаться от сохраненных).
+    if (c_hash_multiset_reserve(new_hash_multiset, (size_t)uniques_count) < 0)
+    {
+        c_hash_multiset_delete(new_hash_multiset, NULL);
+        error_set(_error, 6);
+        return NULL;
+    }
+
+    size_t data_capacity = C_HASH_MULTISET_SNAPSHOT_DATA;
+    void *data_buffer = memory_alloc(new_hash_multiset, data_capacity);
+    size_t code = (data_buffer == NULL) ? 6 : 0;
+
+    // Копии, хранимые по значению, не удаляются _del_data.
+    void (*const del_placed)(void *const _data) = (new_hash_multiset->key_size > 0) ? NULL : _del_data;
+
+    size_t nodes_loaded = 0;
+    for (uint64_t u = 0; (u < uniques_count) && (code == 0); ++u)
+    {
+        uint64_t hash,
+                 count,
+                 size;
+        if ( (stream_read_u64(&stream, &hash) < 0) ||
+             (stream_read_varint(&stream, &count) < 0) ||
+             (stream_read_varint(&stream, &size) < 0) )
+        {
+            code = 3;
+            break;
+        }
+        if ( (hash > SIZE_MAX) || (count == 0) || (count > nodes_count - nodes_loaded) || (size > SIZE_MAX) )
+        {
+            code = 4;
+            break;
+        }
+
+        if (size > data_capacity)
+        {
+            memory_free(new_hash_multiset, data_buffer);
+            data_capacity = (size_t)size;
+            data_buffer = memory_alloc(new_hash_multiset, data_capacity);
+            if (data_buffer == NULL)
+            {
+                code = 6;
+                break;
+            }
+        }
+        if (stream_read(&stream, data_buffer, (size_t)size) < 0)
+        {
+            code = 3;
+            break;
+        }
+
+        // Повторы собираются в отдельную цепочку и встраиваются вместе с ней.
+        c_hash_multiset_chain pending;
+        pending.head = NULL;
+        pending.count = 0;
+        for (uint64_t c = 0; c < count; ++c)
+        {
+            void *const new_data = _deserialize_data(data_buffer, (size_t)size);
+            if (new_data == NULL)
+            {
+                code = 7;
+                break;
+            }
+            if (chain_push(new_hash_multiset, &pending, new_data) < 0)
+            {
+                if (_del_data != NULL)
+                {
+                    _del_data(new_data);
+                }
+                code = 6;
+                break;
+            }
+            // При хранении по значению созданные данные скопированы в узел и больше не нужны.
+            if ( (new_hash_multiset->key_size > 0) && (_del_data != NULL) )
+            {
+                _del_data(new_data);
+            }
+        }
+        if ( (code == 0) && (place_unique(new_hash_multiset, (size_t)hash, &pending) < 0) )
+        {
+            code = 6;
+        }
+        if (code != 0)
+        {
+            // Данные, не попавшие в хэш-мультимножество, удаляются здесь.
+            chain_drop(new_hash_multiset, &pending, del_placed);
+            break;
+        }
+        nodes_loaded += (size_t)count;
+    }
+
+    memory_free(new_hash_multiset, data_buffer);
+
+    if ( (code == 0) && (nodes_loaded != nodes_count) )
+    {
+        code = 8;
+    }
+    // Файл остается сразу за снимком, за которым могут следовать другие данные.
+    if ( (code == 0) && (stream_unread(&stream) < 0) )
+    {
+        code = 9;
+    }
+    if (code != 0)
+    {
+        c_hash_multiset_delete(new_hash_multiset, del_placed);
+        error_set(_error, code);
+        return NULL;
+    }
+
+    return new_hash_multiset;
+}
+
+// Запись массива при построении хэш-мультимножества из массива: хэш, данные
+// и (после группировки) номер группы равных данных.
+typedef struct s_c_hash_multiset_record
+{
+    size_t hash;
+    const void *data;
+    size_t id;
+} c_hash_multiset_record;
+
+// Группа равных данных части массива: хэш, количество данных и цепочка, в которую они раскладываются.
+typedef struct s_c_hash_multiset_unique
+{
+    size_t hash,
+           count;
+    c_hash_multiset_chain *chain;
+} c_hash_multiset_unique;
+
+// Возвращает перемешанный хэш записи: старшие биты - номер части, следующие - позиция в таблице
+// группировки части (умножение на константу Фибоначчи распределяет равномерно и слабый хэш).
+static size_t record_mix(const size_t _hash)
+{
+    return (size_t)(_hash * (size_t)11400714819323198485ull);
+}
+
+// Создает хэш-мультимножество из массива _data (_count данных) без поэлементной вставки:
+// 1) хэши всех данных вычисляются одним проходом, и данные раскладываются по частям по старшим битам
+//    перемешанного хэша так, чтобы таблица группировки одной части помещалась в кэш;
+// 2) в каждой части равные данные группируются и получают номера групп;
+// 3) слоты размещаются один раз под итоговое количество уникальных данных, цепочки и узлы
+//    выделяются из пулов двумя блоками, цепочки встраиваются без поиска (см. place_empty()),
+//    и данные части раскладываются по цепочкам своих групп (при хранении массивом внешние
+//    массивы выделяются сразу нужной вместимости).
+// Параметры создания (_max_load_factor, _options, может быть NULL) - как у c_hash_multiset_create_ex().
+// В случае ошибки данные пользователя не удаляются.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0): коды c_hash_multiset_create_ex(), 12 - _data == NULL при _count > 0
+// или данные массива равны NULL, 13 - не хватило памяти.
+c_hash_multiset *c_hash_multiset_create_from_array(size_t (*const _hash_data)(const void *const _data),
+                                                   size_t (*const _comp_data)(const void *const _data_a,
+                                                                              const void *const _data_b),
+                                                   const void *const *const _data,
+                                                   const size_t _count,
+                                                   const float _max_load_factor,
+                                                   const c_hash_multiset_options *const _options,
+                                                   size_t *const _error)
+{
+    if ( (_data == NULL) && (_count > 0) )
+    {
+        error_set(_error, 12);
+        return NULL;
+    }
+    for (size_t i = 0; i < _count; ++i)
+    {
+        if (_data[i] == NULL)
+        {
+            error_set(_error, 12);
+            return NULL;
+        }
+    }
+
+    c_hash_multiset *const new_hash_multiset = c_hash_multiset_create_ex(_hash_data, _comp_data, 0,
+                                                                         _max_load_factor, _options,
+                                                                         _error);
+    if (new_hash_multiset == NULL)
+    {
+        return NULL;
+    }
+
+    if (_count == 0)
+    {
+        return new_hash_multiset;
+    }
+
+    // Количество частей - степень двойки.
+    size_t parts_bits = 0;
+    while ( ((size_t)1 << parts_bits) < C_HASH_MULTISET_BULK_PARTS_MAX &&
+            (_count >> parts_bits) > C_HASH_MULTISET_BULK_PART )
+    {
+        ++parts_bits;
+    }
+    const size_t parts_count = (size_t)1 << parts_bits;
+
+    // Хэши данных, границы частей (и номера первых групп частей), записи по частям.
+    size_t *const hashes = (_count <= SIZE_MAX / sizeof(c_hash_multiset_record)) ?
+                           memory_alloc(new_hash_multiset, _count * sizeof(size_t)) : NULL;
+    size_t *const parts = memory_alloc(new_hash_multiset, (parts_count + 1) * 2 * sizeof(size_t));
+    c_hash_multiset_record *const records = (hashes != NULL) ?
+                                            memory_alloc(new_hash_multiset, _count * sizeof(c_hash_multiset_record)) : NULL;
+    if ( (hashes == NULL) || (parts == NULL) || (records == NULL) )
+    {
+        memory_free(new_hash_multiset, hashes);
+        memory_free(new_hash_multiset, parts);
+        memory_free(new_hash_multiset, records);
+        c_hash_multiset_delete(new_hash_multiset, NULL);
+        error_set(_error, 13);
+        return NULL;
+    }
+    size_t *const parts_ids = parts + parts_count + 1;
+
+    // Проход вычисления хэшей не обращается к таблицам.
+    for (size_t i = 0; i < _count; ++i)
+    {
+        hashes[i] = C_HASH_MULTISET_HASH_DATA(new_hash_multiset, _data[i]);
+    }
+
+    memset(parts, 0, (parts_count + 1) * sizeof(size_t));
+    for (size_t i = 0; i < _count; ++i)
+    {
+        ++parts[(parts_bits > 0) ? (record_mix(hashes[i]) >> (sizeof(size_t) * 8 - parts_bits)) + 1 : 1];
+    }
+    size_t part_max = 0;
+    for (size_t p = 0; p < parts_count; ++p)
+    {
+        if (parts[p + 1] > part_max)
+        {
+            part_max = parts[p + 1];
+        }
+        parts[p + 1] += parts[p];
+    }
+
+    // Раскладка по частям: parts[p] временно указывает на конец заполненной части p.
+    for (size_t i = 0; i < _count; ++i)
+    {
+        const size_t p = (parts_bits > 0) ? record_mix(hashes[i]) >> (sizeof(size_t) * 8 - parts_bits) : 0;
+        c_hash_multiset_record *const new_record = &records[parts[p]++];
+        new_record->hash = hashes[i];
+        new_record->data = _data[i];
+    }
+    for (size_t p = parts_count; p > 0; --p)
+    {
+        parts[p] = parts[p - 1];
+    }
+    parts[0] = 0;
+
+    memory_free(new_hash_multiset, hashes);
+
+    // Таблица группировки части (номера записей, SIZE_MAX - пусто) и группы части.
+    size_t table_count = 16;
+    while (table_count < part_max * 2)
+    {
+        table_count *= 2;
+    }
+    size_t *const table = (table_count <= SIZE_MAX / sizeof(size_t)) ?
+                          memory_alloc(new_hash_multiset, table_count * sizeof(size_t)) : NULL;
+    c_hash_multiset_unique *const uniques = memory_alloc(new_hash_multiset, part_max * sizeof(c_hash_multiset_unique));
+    size_t code = ( (table == NULL) || (uniques == NULL) ) ? 13 : 0;
+
+    // Группировка: номера групп выдаются подряд, так что группы части - непрерывный диапазон номеров.
+    size_t uniques_count = 0;
+    for (size_t p = 0; (p < parts_count) && (code == 0); ++p)
+    {
+        parts_ids[p] = uniques_count;
+
+        const size_t part_count = parts[p + 1] - parts[p];
+        if (part_count == 0) continue;
+
+        size_t part_table_count = 16;
+        while (part_table_count < part_count * 2)
+        {
+            part_table_count *= 2;
+        }
+        const size_t table_mask = part_table_count - 1;
+        size_t part_table_bits = 0;
+        while (((size_t)1 << part_table_bits) < part_table_count)
+        {
+            ++part_table_bits;
+        }
+        memset(table, 0xFF, part_table_count * sizeof(size_t));
+
+        c_hash_multiset_record *const part_records = records + parts[p];
+        for (size_t r = 0; r < part_count; ++r)
+        {
+            c_hash_multiset_record *const select_record = &part_records[r];
+            size_t t = (record_mix(select_record->hash) << parts_bits) >> (sizeof(size_t) * 8 - part_table_bits);
+            while (table[t] != SIZE_MAX)
+            {
+                const c_hash_multiset_record *const group_record = &part_records[table[t]];
+                if ( (group_record->hash == select_record->hash) &&
+                     (C_HASH_MULTISET_COMP_DATA(new_hash_multiset, select_record->data, group_record->data) > 0) )
+                {
+                    break;
+                }
+                t = (t + 1) & table_mask;
+            }
+
+            if (table[t] == SIZE_MAX)
+            {
+                table[t] = r;
+                select_record->id = uniques_count++;
+            } else {
+                select_record->id = part_records[table[t]].id;
+            }
+        }
+    }
+    parts_ids[parts_count] = uniques_count;
+
+    memory_free(new_hash_multiset, table);
+
+    // Слоты, цепочки и узлы размещаются сразу под итоговое количество.
+    if ( (code == 0) &&
+         ( (c_hash_multiset_reserve(new_hash_multiset, uniques_count) < 0) ||
+           ( (new_hash_multiset->engine == C_HASH_MULTISET_ENGINE_CHAINED) &&
+             (pool_reserve(new_hash_multiset, &new_hash_multiset->chains_pool, uniques_count) < 0) ) ||
+           ( (new_hash_multiset->storage == C_HASH_MULTISET_STORAGE_NODES) &&
+             (pool_reserve(new_hash_multiset, &new_hash_multiset->nodes_pool, _count) < 0) ) ) )
+    {
+        code = 13;
+    }
+
+    for (size_t p = 0; (p < parts_count) && (code == 0); ++p)
+    {
+        const c_hash_multiset_record *const part_records = records + parts[p];
+        const size_t part_count = parts[p + 1] - parts[p];
+        const size_t id_first = parts_ids[p],
+                     part_uniques = parts_ids[p + 1] - id_first;
+
+        for (size_t u = 0; u < part_uniques; ++u)
+        {
+            uniques[u].count = 0;
+        }
+        for (size_t r = 0; r < part_count; ++r)
+        {
+            c_hash_multiset_unique *const select_unique = &uniques[part_records[r].id - id_first];
+            select_unique->hash = part_records[r].hash;
+            ++select_unique->count;
+        }
+
+        // Цепочки групп части встраиваются пустыми.
+        size_t placed = 0;
+        for (; placed < part_uniques; ++placed)
+        {
+            c_hash_multiset_unique *const select_unique = &uniques[placed];
+            if (placed + C_HASH_MULTISET_PREFETCH_DISTANCE < part_uniques)
+            {
+                prefetch_slot(new_hash_multiset, select_unique[C_HASH_MULTISET_PREFETCH_DISTANCE].hash);
+            }
+
+            c_hash_multiset_chain *const new_chain = place_empty(new_hash_multiset, select_unique->hash);
+            if (new_chain == NULL)
+            {
+                code = 13;
+                break;
+            }
+            select_unique->chain = new_chain;
+
+            if ( (new_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY) && (select_unique->count > 1) )
+            {
+                const size_t capacity = (select_unique->count > C_HASH_MULTISET_ITEMS_MIN) ? select_unique->count :
+                                                                                             C_HASH_MULTISET_ITEMS_MIN;
+                c_hash_multiset_items *const new_items = (capacity <= (SIZE_MAX - sizeof(c_hash_multiset_items)) / sizeof(void*)) ?
+                                                         memory_alloc(new_hash_multiset, sizeof(c_hash_multiset_items) +
+                                                                                         capacity * sizeof(void*)) : NULL;
+                if (new_items == NULL)
+                {
+                    code = 13;
+                    break;
+                }
+                new_items->capacity = capacity;
+                new_chain->items = new_items;
+            }
+        }
+
+        if (code != 0)
+        {
+            // Цепочки части пусты, уже выделенные внешние массивы освобождаются здесь.
+            for (size_t u = 0; u < placed; ++u)
+            {
+                if ( (new_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY) && (uniques[u].count > 1) )
+                {
+                    memory_free(new_hash_multiset, uniques[u].chain->items);
+                    uniques[u].chain->items = NULL;
+                }
+            }
+            break;
+        }
+
+        for (size_t r = 0; r < part_count; ++r)
+        {
+            const c_hash_multiset_unique *const select_unique = &uniques[part_records[r].id - id_first];
+            c_hash_multiset_chain *const select_chain = select_unique->chain;
+            if (new_hash_multiset->storage == C_HASH_MULTISET_STORAGE_ARRAY)
+            {
+                if (select_unique->count == 1)
+                {
+                    select_chain->data = (void*)part_records[r].data;
+                } else {
+                    select_chain->items->data[select_chain->count] = (void*)part_records[r].data;
+                }
+                ++select_chain->count;
+            } else {
+                // Узлы размечены заранее, выделение не может завершиться ошибкой.
+                chain_push(new_hash_multiset, select_chain, part_records[r].data);
+            }
+        }
+        new_hash_multiset->nodes_count += part_count;
+    }
+
+    memory_free(new_hash_multiset, uniques);
+    memory_free(new_hash_multiset, records);
+    memory_free(new_hash_multiset, parts);
+
+    if (code != 0)
+    {
+        c_hash_multiset_delete(new_hash_multiset, NULL);
+        error_set(_error, code);
+        return NULL;
+    }
+
+    return new_hash_multiset;
+}
@@ -16,9 +16,214 @@
 #define C_HASH_MULTISET_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 typedef struct s_c_hash_multiset c_hash_multiset;
 
+// Движок на основе хэш-таблицы с цепочками (по умолчанию).
+#define C_HASH_MULTISET_ENGINE_CHAINED ( (size_t) 0 )
+
+// Движок на основе открытой адресации: группы из 16 однобайтовых отпечатков хэша
+// сканируются одной SSE2-командой, уникальные данные и их количество хранятся прямо в таблице.
+// Количество слотов округляется вверх до степени двойки (не меньше 16),
+// max_load_factor ограничивается сверху значением 0.875.
+#define C_HASH_MULTISET_ENGINE_FLAT ( (size_t) 1 )
+
+// Хранение повторов узлами: каждая единица данных - отдельный узел списка цепочки (по умолчанию).
+#define C_HASH_MULTISET_STORAGE_NODES ( (size_t) 0 )
+
+// Хранение повторов массивом: единственная единица данных хранится прямо в цепочке, повторы -
+// в одном растущем блоке указателей. Удаление снимает последнюю единицу за O(1), удаление всех
+// единиц освобождает один блок, обход повторов идет по непрерывной памяти.
+// Несовместимо с хранением по значению (key_size > 0).
+#define C_HASH_MULTISET_STORAGE_ARRAY ( (size_t) 1 )
+
+// Распределитель памяти хэш-мультимножества.
+typedef struct s_c_hash_multiset_allocator
+{
+    // Выделяет блок памяти заданного размера, в случае ошибки возвращает NULL.
+    void *(*allocate)(void *const _context,
+                      const size_t _size);
+    // Освобождает блок памяти.
+    void (*deallocate)(void *const _context,
+                       void *const _block);
+    // Необязательная (может быть NULL) функция, освобождающая разом все блоки контекста.
+    // Вызывается при удалении хэш-мультимножества вместо поблочного освобождения,
+    // поэтому контекст должен принадлежать только одному хэш-мультимножеству.
+    void (*release)(void *const _context);
+} c_hash_multiset_allocator;
+
+// Политика роста: любое количество слотов, номер слота - остаток от деления хэша (по умолчанию).
+#define C_HASH_MULTISET_GROWTH_MODULO ( (size_t) 0 )
+
+// Политика роста: количество слотов - степень двойки, номер слота - младшие биты хэша.
+#define C_HASH_MULTISET_GROWTH_POW2 ( (size_t) 1 )
+
+// Политика роста: любое количество слотов, номер слота - старшая половина произведения
+// хэша на количество слотов (Lemire). Требует хэша, равномерного в старших битах.
+#define C_HASH_MULTISET_GROWTH_FASTRANGE ( (size_t) 2 )
+
+// Политика роста: количество слотов - простое число из таблицы, остаток от деления
+// вычисляется умножением на заранее вычисленную константу (до 2^32 слотов).
+#define C_HASH_MULTISET_GROWTH_PRIME ( (size_t) 3 )
+
+// Исполнитель параллельных операций (вместо встроенных потоков).
+typedef struct s_c_hash_multiset_executor
+{
+    // Выполняет _task(_argument, i) для всех i < _count (задачи независимы и могут выполняться
+    // одновременно) и возвращается только после завершения всех задач.
+    void (*run)(void *const _context,
+                void (*const _task)(void *const _argument,
+                                    const size_t _index),
+                void *const _argument,
+                const size_t _count);
+    void *context;
+} c_hash_multiset_executor;
+
+// Курсор обхода хэш-мультимножества.
+// Поля - внутреннее состояние курсора, задаются c_hash_multiset_iter_init().
+typedef struct s_c_hash_multiset_iter
+{
+    size_t position;
+    const void *chain;
+    const void *node;
+    size_t index,
+           uniques;
+} c_hash_multiset_iter;
+
+// Ячейка - результат поиска данных (c_hash_multiset_entry_find()): найденная цепочка
+// или место вставки отсутствующих данных.
+// Поля - внутреннее состояние ячейки.
+typedef struct s_c_hash_multiset_entry
+{
+    const void *data;
+    size_t hash;
+    void *chain;
+    void *link;
+    size_t position;
+} c_hash_multiset_entry;
+
+#if defined(C_HASH_MULTISET_LATENCY)
+#include <stdint.h>
+
+// Операции, задержки которых измеряются, если библиотека собрана с C_HASH_MULTISET_LATENCY.
+// Вставка (c_hash_multiset_insert(), c_hash_multiset_insert_hashed()).
+#define C_HASH_MULTISET_OP_INSERT ( (size_t) 0 )
+// Удаление одной единицы (c_hash_multiset_erase(), c_hash_multiset_erase_hashed()).
+#define C_HASH_MULTISET_OP_ERASE ( (size_t) 1 )
+// Удаление всех единиц (c_hash_multiset_erase_all(), c_hash_multiset_erase_all_hashed()).
+#define C_HASH_MULTISET_OP_ERASE_ALL ( (size_t) 2 )
+// Очистка (c_hash_multiset_clear()).
+#define C_HASH_MULTISET_OP_CLEAR ( (size_t) 3 )
+// Перестроение слотов, в том числе вызванное вставкой или удалением
+// (задержка перестроения входит и в задержку вызвавшей его операции).
+#define C_HASH_MULTISET_OP_RESIZE ( (size_t) 4 )
+
+#define C_HASH_MULTISET_OPS_COUNT ( (size_t) 5 )
+
+// Количество столбцов гистограммы задержек: столбец i - задержки от 2^i до 2^(i+1)-1 нс
+// (последний столбец - не меньше).
+#define C_HASH_MULTISET_LATENCY_BUCKETS ( (size_t) 32 )
+
+// Обработчики начала и конца перестроения и очистки (например, для передачи в трассировщик).
+typedef struct s_c_hash_multiset_hooks
+{
+    // Вызывается перед операцией, может быть NULL.
+    void (*begin)(void *const _context,
+                  const size_t _operation);
+    // Вызывается после операции с ее задержкой, может быть NULL.
+    void (*end)(void *const _context,
+                const size_t _operation,
+                const uint64_t _nanoseconds);
+    void *context;
+} c_hash_multiset_hooks;
+
+// Гистограммы задержек операций (c_hash_multiset_latency()).
+typedef struct s_c_hash_multiset_latency_report
+{
+    uint64_t histogram[C_HASH_MULTISET_OPS_COUNT][C_HASH_MULTISET_LATENCY_BUCKETS];
+} c_hash_multiset_latency_report;
+#endif
+
+// Количество столбцов гистограмм статистики.
+#define C_HASH_MULTISET_STATS_BUCKETS ( (size_t) 16 )
+
+// Структурная статистика хэш-мультимножества (c_hash_multiset_stats()).
+typedef struct s_c_hash_multiset_stats
+{
+    size_t slots_count,
+           nodes_count,
+           uniques_count;
+    float max_load_factor,
+          load_factor;
+    // chains_histogram[i] - количество слотов с i цепочками (последний столбец - с не меньшим
+    // количеством), для плоского движка - пустых (0) и занятых (1) позиций.
+    size_t chains_histogram[C_HASH_MULTISET_STATS_BUCKETS];
+    // duplicates_histogram[i] - количество цепочек, в которых от 2^i до 2^(i+1)-1 одинаковых данных
+    // (последний столбец - не меньше).
+    size_t duplicates_histogram[C_HASH_MULTISET_STATS_BUCKETS];
+    // Наибольшее количество цепочек в слоте и одинаковых данных в цепочке.
+    size_t max_chains,
+           max_duplicates;
+    // Количество цепочек, полный хэш которых совпал с хэшем другой цепочки (разные данные).
+    size_t hash_collisions;
+    // Количество пустых слотов и удаленных позиций плоского движка.
+    size_t empty_slots,
+           tombstones;
+    // Память в байтах: слоты (для плоского движка - записи и управляющие байты), цепочки,
+    // узлы (при хранении массивом - внешние массивы повторов), незанятая память пулов
+    // и вся память хэш-мультимножества.
+    size_t memory_slots,
+           memory_chains,
+           memory_nodes,
+           memory_pools_free,
+           memory_total;
+    // Вызовы функций хэша и сравнения и перестроения слотов
+    // (только если библиотека собрана с C_HASH_MULTISET_COUNTERS, иначе 0).
+    size_t hash_calls,
+           comp_calls,
+           resizes;
+} c_hash_multiset_stats_report;
+
+// Параметры создания хэш-мультимножества.
+// Перед заполнением должны быть инициализированы c_hash_multiset_options_init().
+typedef struct s_c_hash_multiset_options
+{
+    // Распределитель памяти (NULL - malloc/free) и его контекст.
+    const c_hash_multiset_allocator *allocator;
+    void *allocator_context;
+    // Движок (C_HASH_MULTISET_ENGINE_*).
+    size_t engine;
+    // Постепенное перестроение цепочного движка: количество старых слотов, переносимых
+    // в новый массив при каждой вставке и удалении. 0 - перестроение выполняется сразу целиком.
+    // Вставки при необходимости переносят больше, чтобы перестроение заканчивалось до следующего
+    // расширения; выделение и обнуление нового массива слотов остаются пропорциональны его размеру.
+    size_t migrate_step;
+    // Политика роста цепочного движка (C_HASH_MULTISET_GROWTH_*).
+    size_t growth_policy;
+    // Коэф. роста количества слотов при расширении (> 1.0, по умолчанию 1.75).
+    float growth_factor;
+    // Минимальная загруженность: при ее снижении удаления сжимают слоты (0 - не сжимать).
+    // Должна быть не больше половины max_load_factor.
+    float min_load_factor;
+    // Хранение по значению: размер ключа в байтах (0 - хранятся указатели на данные пользователя).
+    // Вставляемые данные (_key_size байт) копируются в узел, функции обхода и удаления получают
+    // указатель на копию (_del_data не должна ее освобождать), данные пользователя после вставки
+    // не нужны. Если функция сравнения не задана (NULL), ключи сравниваются memcmp().
+    size_t key_size;
+    // Хранение повторов (C_HASH_MULTISET_STORAGE_*).
+    size_t storage;
+    // Быстрая очистка (!= 0), только для цепочного движка: c_hash_multiset_clear() без функции
+    // удаления данных сохраняет блоки пулов для новых вставок и обнуляет только слоты цепочек,
+    // вставленных с прошлой очистки (если их намного меньше, чем слотов), - так очистка
+    // хэш-мультимножества, однажды разросшегося, а затем многократно используемого для небольшого
+    // количества данных, не обходит весь массив слотов. С функцией удаления данных и при хранении
+    // массивом очистка обычная. С плоским движком c_hash_multiset_create_ex() возвращает ошибку 8.
+    size_t fast_clear;
+} c_hash_multiset_options;
+
+void c_hash_multiset_options_init(c_hash_multiset_options *const _options);
+
 c_hash_multiset *c_hash_multiset_create(size_t (*const _hash_data)(const void *const _data),
                                         size_t (*const _comp_data)(const void *const _data_a,
                                                                    const void *const _data_b),
@@ -26,6 +231,23 @@ c_hash_multiset *c_hash_multiset_create(size_t (*const _hash_data)(const void *c
                                         const float _max_load_factor,
                                         size_t *const _error);
 
+c_hash_multiset *c_hash_multiset_create_ex(size_t (*const _hash_data)(const void *const _data),
+                                           size_t (*const _comp_data)(const void *const _data_a,
+                                                                      const void *const _data_b),
+                                           const size_t _slots_count,
+                                           const float _max_load_factor,
+                                           const c_hash_multiset_options *const _options,
+                                           size_t *const _error);
+
+c_hash_multiset *c_hash_multiset_create_from_array(size_t (*const _hash_data)(const void *const _data),
+                                                   size_t (*const _comp_data)(const void *const _data_a,
+                                                                              const void *const _data_b),
+                                                   const void *const *const _data,
+                                                   const size_t _count,
+                                                   const float _max_load_factor,
+                                                   const c_hash_multiset_options *const _options,
+                                                   size_t *const _error);
+
 ptrdiff_t c_hash_multiset_delete(c_hash_multiset *const _hash_multiset,
                                  void (*const _del_data)(void *const _data));
 
@@ -68,4 +290,151 @@ size_t c_hash_multiset_uniques_count(const c_hash_multiset *const _hash_multiset
 
 float c_hash_multiset_max_load_factor(const c_hash_multiset *const _hash_multiset);
 
+ptrdiff_t c_hash_multiset_reserve(c_hash_multiset *const _hash_multiset,
+                                  const size_t _uniques_count);
+
+ptrdiff_t c_hash_multiset_shrink_to_fit(c_hash_multiset *const _hash_multiset);
+
+ptrdiff_t c_hash_multiset_insert_batch(c_hash_multiset *const _hash_multiset,
+                                       const void *const *const _data,
+                                       const size_t _count,
+                                       ptrdiff_t *const _results);
+
+ptrdiff_t c_hash_multiset_check_batch(const c_hash_multiset *const _hash_multiset,
+                                      const void *const *const _data,
+                                      const size_t _count,
+                                      ptrdiff_t *const _results);
+
+ptrdiff_t c_hash_multiset_data_count_batch(const c_hash_multiset *const _hash_multiset,
+                                           const void *const *const _data,
+                                           const size_t _count,
+                                           size_t *const _counts);
+
+ptrdiff_t c_hash_multiset_merge(c_hash_multiset *const _destination,
+                                c_hash_multiset *const _source,
+                                const size_t _threads_count);
+
+ptrdiff_t c_hash_multiset_for_each_parallel(const c_hash_multiset *const _hash_multiset,
+                                            void (*const _action_data)(const void *const _data),
+                                            const size_t _threads_count,
+                                            const c_hash_multiset_executor *const _executor);
+
+ptrdiff_t c_hash_multiset_clear_parallel(c_hash_multiset *const _hash_multiset,
+                                         void (*const _del_data)(void *const _data),
+                                         const size_t _threads_count,
+                                         const c_hash_multiset_executor *const _executor);
+
+ptrdiff_t c_hash_multiset_delete_parallel(c_hash_multiset *const _hash_multiset,
+                                          void (*const _del_data)(void *const _data),
+                                          const size_t _threads_count,
+                                          const c_hash_multiset_executor *const _executor);
+
+ptrdiff_t c_hash_multiset_iter_init(const c_hash_multiset *const _hash_multiset,
+                                    c_hash_multiset_iter *const _iter,
+                                    const size_t _uniques);
+
+ptrdiff_t c_hash_multiset_iter_next(const c_hash_multiset *const _hash_multiset,
+                                    c_hash_multiset_iter *const _iter,
+                                    const void **const _data,
+                                    size_t *const _count);
+
+ptrdiff_t c_hash_multiset_iter_steps(const c_hash_multiset *const _hash_multiset,
+                                     c_hash_multiset_iter *const _iter,
+                                     size_t (*const _action_data)(void *const _context,
+                                                                  const void *const _data,
+                                                                  const size_t _count),
+                                     void *const _context,
+                                     const size_t _steps);
+
+ptrdiff_t c_hash_multiset_insert_hashed(c_hash_multiset *const _hash_multiset,
+                                        const void *const _data,
+                                        const size_t _hash);
+
+ptrdiff_t c_hash_multiset_erase_hashed(c_hash_multiset *const _hash_multiset,
+                                       const void *const _data,
+                                       const size_t _hash,
+                                       void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_multiset_check_hashed(const c_hash_multiset *const _hash_multiset,
+                                       const void *const _data,
+                                       const size_t _hash);
+
+size_t c_hash_multiset_data_count_hashed(const c_hash_multiset *const _hash_multiset,
+                                         const void *const _data,
+                                         const size_t _hash,
+                                         size_t *const _error);
+
+size_t c_hash_multiset_erase_all_hashed(c_hash_multiset *const _hash_multiset,
+                                        const void *const _data,
+                                        const size_t _hash,
+                                        void (*const _del_data)(void *const _data),
+                                        size_t *const _error);
+
+ptrdiff_t c_hash_multiset_entry_find(const c_hash_multiset *const _hash_multiset,
+                                     const void *const _data,
+                                     c_hash_multiset_entry *const _entry);
+
+size_t c_hash_multiset_entry_count(const c_hash_multiset_entry *const _entry);
+
+ptrdiff_t c_hash_multiset_entry_insert(c_hash_multiset *const _hash_multiset,
+                                       c_hash_multiset_entry *const _entry,
+                                       const void *const _data);
+
+ptrdiff_t c_hash_multiset_entry_erase(c_hash_multiset *const _hash_multiset,
+                                      c_hash_multiset_entry *const _entry,
+                                      void (*const _del_data)(void *const _data));
+
+size_t c_hash_multiset_entry_erase_all(c_hash_multiset *const _hash_multiset,
+                                       c_hash_multiset_entry *const _entry,
+                                       void (*const _del_data)(void *const _data),
+                                       size_t *const _error);
+
+ptrdiff_t c_hash_multiset_sum(c_hash_multiset *const _left,
+                              c_hash_multiset *const _right,
+                              c_hash_multiset **const _result);
+
+ptrdiff_t c_hash_multiset_union(c_hash_multiset *const _left,
+                                c_hash_multiset *const _right,
+                                c_hash_multiset **const _result,
+                                void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_multiset_intersection(c_hash_multiset *const _left,
+                                       c_hash_multiset *const _right,
+                                       c_hash_multiset **const _result,
+                                       void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_multiset_difference(c_hash_multiset *const _left,
+                                     c_hash_multiset *const _right,
+                                     c_hash_multiset **const _result,
+                                     void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_multiset_stats(const c_hash_multiset *const _hash_multiset,
+                                c_hash_multiset_stats_report *const _stats);
+
+ptrdiff_t c_hash_multiset_save(const c_hash_multiset *const _hash_multiset,
+                               FILE *const _file,
+                               size_t (*const _serialize_data)(const void *const _data,
+                                                               void *const _buffer,
+                                                               const size_t _size));
+
+c_hash_multiset *c_hash_multiset_load(FILE *const _file,
+                                      size_t (*const _hash_data)(const void *const _data),
+                                      size_t (*const _comp_data)(const void *const _data_a,
+                                                                 const void *const _data_b),
+                                      void *(*const _deserialize_data)(const void *const _buffer,
+                                                                       const size_t _size),
+                                      void (*const _del_data)(void *const _data),
+                                      const c_hash_multiset_options *const _options,
+                                      size_t *const _error);
+
+#if defined(C_HASH_MULTISET_LATENCY)
+ptrdiff_t c_hash_multiset_set_hooks(c_hash_multiset *const _hash_multiset,
+                                    const c_hash_multiset_hooks *const _hooks);
+
+ptrdiff_t c_hash_multiset_latency(const c_hash_multiset *const _hash_multiset,
+                                  c_hash_multiset_latency_report *const _report);
+
+ptrdiff_t c_hash_multiset_latency_reset(c_hash_multiset *const _hash_multiset);
+#endif
+
 #endif
@@ -0,0 +1,986 @@
+﻿/*
+    Файл реализации конкурентного хэш-мультимножества c_hash_multiset_concurrent
+    Писатели блокируют только свою полосу слотов, читатели (check, data_count) не блокируются,
+    освобождаемые цепочки и узлы возвращаются после эпохи, в которой их могли видеть читатели.
+
+    Лицензия: GPLv3
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "c_hash_multiset_concurrent.h"
+
+// Количество слотов, задаваемое хэш-мультимножеству, созданному с нулем слотов.
+#define C_HASH_MULTISET_CONCURRENT_0 ( (size_t) 1024 )
+
+// Минимально возможное значение max_load_factor.
+#define C_HASH_MULTISET_CONCURRENT_MLF_MIN ( (float) 0.01f )
+
+// Максимально возможное значение max_load_factor.
+#define C_HASH_MULTISET_CONCURRENT_MLF_MAX ( (float) 16.0f )
+
+// Количество полос блокировок писателей.
+// Количество слотов всегда кратно количеству полос, поэтому полоса данных (хэш по модулю
+// количества полос) не зависит от количества слотов и не меняется при перестроении.
+#define C_HASH_MULTISET_CONCURRENT_STRIPES ( (size_t) 64 )
+
+// Количество счетчиков читателей каждой эпохи (читатели распределяются по ним по номеру потока).
+#define C_HASH_MULTISET_CONCURRENT_READERS ( (size_t) 64 )
+
+// Количество отложенных к освобождению объектов, при котором писатель запускает их освобождение.
+#define C_HASH_MULTISET_CONCURRENT_RETIRED ( (size_t) 1024 )
+
+// Размер, до которого дополняются счетчики и блокировки, чтобы не делить строку кэша.
+#define C_HASH_MULTISET_CONCURRENT_LINE ( (size_t) 128 )
+
+typedef struct s_c_hash_multiset_concurrent_node c_hash_multiset_concurrent_node;
+
+typedef struct s_c_hash_multiset_concurrent_chain c_hash_multiset_concurrent_chain;
+
+typedef struct s_c_hash_multiset_concurrent_table c_hash_multiset_concurrent_table;
+
+// Читатели узлы не обходят, поэтому после извлечения узла из цепочки next_node
+// используется как связь списка отложенных к освобождению узлов.
+struct s_c_hash_multiset_concurrent_node
+{
+    struct s_c_hash_multiset_concurrent_node *next_node;
+    void *data;
+    // Функция удаления данных, вызываемая при освобождении узла.
+    void (*del_data)(void *const _data);
+};
+
+struct s_c_hash_multiset_concurrent_chain
+{
+    _Atomic(struct s_c_hash_multiset_concurrent_chain*) next_chain;
+    _Atomic(c_hash_multiset_concurrent_node*) head;
+    atomic_size_t count;
+    size_t hash;
+
+    // Читатель может стоять на удаленной цепочке и идти дальше по next_chain,
+    // поэтому для списка отложенных к освобождению цепочек используется отдельная связь.
+    struct s_c_hash_multiset_concurrent_chain *retired_next;
+    // Узлы, освобождаемые вместе с цепочкой, и функция удаления их данных.
+    c_hash_multiset_concurrent_node *retired_nodes;
+    void (*del_data)(void *const _data);
+};
+
+// Массив слотов. Перестроение создает новый массив и публикует его целиком.
+struct s_c_hash_multiset_concurrent_table
+{
+    size_t slots_count;
+    struct s_c_hash_multiset_concurrent_table *retired_next;
+    _Atomic(c_hash_multiset_concurrent_chain*) slots[];
+};
+
+// Блокировка полосы, дополненная до строки кэша.
+typedef union u_c_hash_multiset_concurrent_stripe
+{
+    pthread_mutex_t mutex;
+    uint8_t line[C_HASH_MULTISET_CONCURRENT_LINE];
+} c_hash_multiset_concurrent_stripe;
+
+// Счетчик читателей, дополненный до строки кэша.
+typedef union u_c_hash_multiset_concurrent_readers
+{
+    atomic_size_t count;
+    uint8_t line[C_HASH_MULTISET_CONCURRENT_LINE];
+} c_hash_multiset_concurrent_readers;
+
+struct s_c_hash_multiset_concurrent
+{
+    // Функция, генерирующая хэш на основе данных.
+    size_t (*hash_data)(const void *const _data);
+    // Функция детального сравнения данных.
+    // В случае идентичности данных должна возвращать > 0, иначе 0.
+    size_t (*comp_data)(const void *const _data_a,
+                        const void *const _data_b);
+
+    float max_load_factor;
+
+    _Atomic(c_hash_multiset_concurrent_table*) table;
+
+    atomic_size_t slots_count,
+                  nodes_count,
+                  uniques_count;
+
+    c_hash_multiset_concurrent_stripe stripes[C_HASH_MULTISET_CONCURRENT_STRIPES];
+
+    // Эпоха и счетчики читателей для четной и нечетной эпох.
+    atomic_size_t epoch;
+    c_hash_multiset_concurrent_readers readers[2][C_HASH_MULTISET_CONCURRENT_READERS];
+
+    // Отложенные к освобождению объекты (под retire_lock).
+    pthread_mutex_t retire_lock;
+    c_hash_multiset_concurrent_node *retired_nodes;
+    c_hash_multiset_concurrent_chain *retired_chains;
+    c_hash_multiset_concurrent_table *retired_tables;
+    size_t retired_count;
+
+    // Ожидание завершения эпох выполняется одним потоком за раз.
+    pthread_mutex_t sync_lock;
+};
+
+// Счетчик потоков, обращавшихся к конкурентным хэш-мультимножествам.
+static atomic_size_t threads_count;
+
+// Номер текущего потока (SIZE_MAX - еще не назначен).
+static _Thread_local size_t thread_index = SIZE_MAX;
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
+    {
+        *_error = _code;
+    }
+}
+
+// Возвращает номер счетчика читателей текущего потока.
+static size_t reader_index(void)
+{
+    if (thread_index == SIZE_MAX)
+    {
+        thread_index = atomic_fetch_add(&threads_count, 1);
+    }
+    return thread_index % C_HASH_MULTISET_CONCURRENT_READERS;
+}
+
+// Входит в секцию читателя и возвращает эпоху, в которой читатель зарегистрирован.
+// Пока читатель не вышел из секции, ни один объект, который он мог увидеть, не освобождается.
+static size_t reader_enter(c_hash_multiset_concurrent *const _hash_multiset,
+                           const size_t _index)
+{
+    for (;;)
+    {
+        const size_t epoch = atomic_load(&_hash_multiset->epoch);
+        atomic_fetch_add(&_hash_multiset->readers[epoch & 1][_index].count, 1);
+        // Если эпоха успела смениться, писатель мог не увидеть регистрацию - повторяем.
+        if (atomic_load(&_hash_multiset->epoch) == epoch)
+        {
+            return epoch;
+        }
+        atomic_fetch_sub(&_hash_multiset->readers[epoch & 1][_index].count, 1);
+    }
+}
+
+// Выходит из секции читателя.
+static void reader_exit(c_hash_multiset_concurrent *const _hash_multiset,
+                        const size_t _index,
+                        const size_t _epoch)
+{
+    atomic_fetch_sub(&_hash_multiset->readers[_epoch & 1][_index].count, 1);
+}
+
+// Дожидается, пока завершатся все секции читателей, начатые до вызова.
+// Эпоха сменяется дважды, чтобы дождаться читателей обеих четностей.
+static void synchronize(c_hash_multiset_concurrent *const _hash_multiset)
+{
+    pthread_mutex_lock(&_hash_multiset->sync_lock);
+
+    for (size_t flip = 0; flip < 2; ++flip)
+    {
+        const size_t epoch = atomic_fetch_add(&_hash_multiset->epoch, 1);
+        for (size_t r = 0; r < C_HASH_MULTISET_CONCURRENT_READERS; ++r)
+        {
+            while (atomic_load(&_hash_multiset->readers[epoch & 1][r].count) != 0)
+            {
+                sched_yield();
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&_hash_multiset->sync_lock);
+}
+
+// Откладывает освобождение узла (и удаление его данных) до завершения текущих читателей.
+static void retire_node(c_hash_multiset_concurrent *const _hash_multiset,
+                        c_hash_multiset_concurrent_node *const _node,
+                        void (*const _del_data)(void *const _data))
+{
+    pthread_mutex_lock(&_hash_multiset->retire_lock);
+
+    _node->del_data = _del_data;
+    _node->next_node = _hash_multiset->retired_nodes;
+    _hash_multiset->retired_nodes = _node;
+    ++_hash_multiset->retired_count;
+
+    pthread_mutex_unlock(&_hash_multiset->retire_lock);
+}
+
+// Откладывает освобождение цепочки и заданного списка узлов до завершения текущих читателей.
+static void retire_chain(c_hash_multiset_concurrent *const _hash_multiset,
+                         c_hash_multiset_concurrent_chain *const _chain,
+                         c_hash_multiset_concurrent_node *const _nodes,
+                         void (*const _del_data)(void *const _data))
+{
+    pthread_mutex_lock(&_hash_multiset->retire_lock);
+
+    _chain->retired_nodes = _nodes;
+    _chain->del_data = _del_data;
+    _chain->retired_next = _hash_multiset->retired_chains;
+    _hash_multiset->retired_chains = _chain;
+    ++_hash_multiset->retired_count;
+
+    pthread_mutex_unlock(&_hash_multiset->retire_lock);
+}
+
+// Откладывает освобождение массива слотов до завершения текущих читателей.
+static void retire_table(c_hash_multiset_concurrent *const _hash_multiset,
+                         c_hash_multiset_concurrent_table *const _table)
+{
+    pthread_mutex_lock(&_hash_multiset->retire_lock);
+
+    _table->retired_next = _hash_multiset->retired_tables;
+    _hash_multiset->retired_tables = _table;
+    ++_hash_multiset->retired_count;
+
+    pthread_mutex_unlock(&_hash_multiset->retire_lock);
+}
+
+// Освобождает отложенные объекты, если их накопилось достаточно (или всегда, если _force != 0).
+// Не должна вызываться из секции читателя.
+static void reclaim(c_hash_multiset_concurrent *const _hash_multiset,
+                    const size_t _force)
+{
+    pthread_mutex_lock(&_hash_multiset->retire_lock);
+
+    if ( (_hash_multiset->retired_count == 0) ||
+         ( (_force == 0) && (_hash_multiset->retired_count < C_HASH_MULTISET_CONCURRENT_RETIRED) ) )
+    {
+        pthread_mutex_unlock(&_hash_multiset->retire_lock);
+        return;
+    }
+
+    c_hash_multiset_concurrent_node *select_node = _hash_multiset->retired_nodes,
+                                    *delete_node;
+    c_hash_multiset_concurrent_chain *select_chain = _hash_multiset->retired_chains,
+                                     *delete_chain;
+    c_hash_multiset_concurrent_table *select_table = _hash_multiset->retired_tables,
+                                     *delete_table;
+
+    _hash_multiset->retired_nodes = NULL;
+    _hash_multiset->retired_chains = NULL;
+    _hash_multiset->retired_tables = NULL;
+    _hash_multiset->retired_count = 0;
+
+    pthread_mutex_unlock(&_hash_multiset->retire_lock);
+
+    // Все, кто мог видеть извлеченные объекты, должны уйти.
+    synchronize(_hash_multiset);
+
+    while (select_node != NULL)
+    {
+        delete_node = select_node;
+        select_node = select_node->next_node;
+        if (delete_node->del_data != NULL)
+        {
+            delete_node->del_data( delete_node->data );
+        }
+        free(delete_node);
+    }
+
+    while (select_chain != NULL)
+    {
+        delete_chain = select_chain;
+        select_chain = select_chain->retired_next;
+
+        select_node = delete_chain->retired_nodes;
+        while (select_node != NULL)
+        {
+            delete_node = select_node;
+            select_node = select_node->next_node;
+            if (delete_chain->del_data != NULL)
+            {
+                delete_chain->del_data( delete_node->data );
+            }
+            free(delete_node);
+        }
+
+        free(delete_chain);
+    }
+
+    while (select_table != NULL)
+    {
+        delete_table = select_table;
+        select_table = select_table->retired_next;
+        free(delete_table);
+    }
+}
+
+// Создает пустой массив слотов.
+// В случае ошибки возвращает NULL.
+static c_hash_multiset_concurrent_table *table_create(const size_t _slots_count)
+{
+    if (_slots_count > (SIZE_MAX - sizeof(c_hash_multiset_concurrent_table)) /
+                       sizeof(_Atomic(c_hash_multiset_concurrent_chain*)))
+    {
+        return NULL;
+    }
+
+    c_hash_multiset_concurrent_table *const new_table = malloc(sizeof(c_hash_multiset_concurrent_table) +
+                                                               _slots_count * sizeof(_Atomic(c_hash_multiset_concurrent_chain*)));
+    if (new_table == NULL)
+    {
+        return NULL;
+    }
+
+    new_table->slots_count = _slots_count;
+    new_table->retired_next = NULL;
+    for (size_t s = 0; s < _slots_count; ++s)
+    {
+        atomic_init(&new_table->slots[s], NULL);
+    }
+
+    return new_table;
+}
+
+// Приводит количество слотов к кратному количеству полос.
+// В случае переполнения возвращает 0.
+static size_t slots_round(const size_t _slots_count)
+{
+    const size_t stripes = C_HASH_MULTISET_CONCURRENT_STRIPES;
+    if (_slots_count > SIZE_MAX - stripes)
+    {
+        return 0;
+    }
+    return (_slots_count + stripes - 1) / stripes * stripes;
+}
+
+// Блокирует все полосы (всегда в одном порядке).
+static void lock_all(c_hash_multiset_concurrent *const _hash_multiset)
+{
+    for (size_t i = 0; i < C_HASH_MULTISET_CONCURRENT_STRIPES; ++i)
+    {
+        pthread_mutex_lock(&_hash_multiset->stripes[i].mutex);
+    }
+}
+
+// Разблокирует все полосы.
+static void unlock_all(c_hash_multiset_concurrent *const _hash_multiset)
+{
+    for (size_t i = C_HASH_MULTISET_CONCURRENT_STRIPES; i > 0; --i)
+    {
+        pthread_mutex_unlock(&_hash_multiset->stripes[i - 1].mutex);
+    }
+}
+
+// Если предел загруженности достигнут, расширяет слоты.
+// Писатели на время перестроения блокируются, читатели - нет: новый массив строится из копий
+// заголовков цепочек (узлы общие) и публикуется целиком, а старый массив и старые заголовки
+// освобождаются после завершения читателей, которые могли их видеть.
+// В случае успеха или если расширение не требуется, возвращает >= 0.
+// В случае ошибки возвращает < 0.
+static ptrdiff_t grow(c_hash_multiset_concurrent *const _hash_multiset)
+{
+    const float load_factor = (float)atomic_load(&_hash_multiset->uniques_count) /
+                              atomic_load(&_hash_multiset->slots_count);
+    if (load_factor < _hash_multiset->max_load_factor)
+    {
+        return 0;
+    }
+
+    lock_all(_hash_multiset);
+
+    c_hash_multiset_concurrent_table *const old_table = atomic_load(&_hash_multiset->table);
+
+    // Пока ждали блокировок, расширить мог другой писатель.
+    if ((float)atomic_load(&_hash_multiset->uniques_count) / old_table->slots_count < _hash_multiset->max_load_factor)
+    {
+        unlock_all(_hash_multiset);
+        return 0;
+    }
+
+    const size_t new_slots_count = slots_round((size_t)(old_table->slots_count * 1.75f) + 1);
+    if (new_slots_count <= old_table->slots_count)
+    {
+        unlock_all(_hash_multiset);
+        return -1;
+    }
+
+    c_hash_multiset_concurrent_table *const new_table = table_create(new_slots_count);
+    if (new_table == NULL)
+    {
+        unlock_all(_hash_multiset);
+        return -2;
+    }
+
+    // Копируем заголовки цепочек в новый массив, хэш заново не вычисляется.
+    for (size_t s = 0; s < old_table->slots_count; ++s)
+    {
+        const c_hash_multiset_concurrent_chain *select_chain = atomic_load(&old_table->slots[s]);
+        while (select_chain != NULL)
+        {
+            c_hash_multiset_concurrent_chain *const new_chain = malloc(sizeof(c_hash_multiset_concurrent_chain));
+            if (new_chain == NULL)
+            {
+                // Откатываемся: освобождаем уже созданные копии, старый массив остается в работе.
+                for (size_t n = 0; n < new_table->slots_count; ++n)
+                {
+                    c_hash_multiset_concurrent_chain *delete_chain = atomic_load(&new_table->slots[n]),
+                                                     *next_chain;
+                    while (delete_chain != NULL)
+                    {
+                        next_chain = atomic_load(&delete_chain->next_chain);
+                        free(delete_chain);
+                        delete_chain = next_chain;
+                    }
+                }
+                free(new_table);
+                unlock_all(_hash_multiset);
+                return -3;
+            }
+
+            const size_t presented_hash = select_chain->hash % new_slots_count;
+
+            atomic_init(&new_chain->head, atomic_load(&select_chain->head));
+            atomic_init(&new_chain->count, atomic_load(&select_chain->count));
+            new_chain->hash = select_chain->hash;
+            new_chain->retired_next = NULL;
+            new_chain->retired_nodes = NULL;
+            new_chain->del_data = NULL;
+            atomic_init(&new_chain->next_chain, atomic_load(&new_table->slots[presented_hash]));
+            atomic_store_explicit(&new_table->slots[presented_hash], new_chain, memory_order_relaxed);
+
+            select_chain = atomic_load(&select_chain->next_chain);
+        }
+    }
+
+    // Публикуем новый массив.
+    atomic_store_explicit(&_hash_multiset->table, new_table, memory_order_release);
+    atomic_store(&_hash_multiset->slots_count, new_slots_count);
+
+    // Старые заголовки (без узлов) и старый массив освобождаются позже.
+    for (size_t s = 0; s < old_table->slots_count; ++s)
+    {
+        c_hash_multiset_concurrent_chain *select_chain = atomic_load(&old_table->slots[s]);
+        while (select_chain != NULL)
+        {
+            retire_chain(_hash_multiset, select_chain, NULL, NULL);
+            select_chain = atomic_load(&select_chain->next_chain);
+        }
+    }
+    retire_table(_hash_multiset, old_table);
+
+    unlock_all(_hash_multiset);
+
+    reclaim(_hash_multiset, 0);
+
+    return 1;
+}
+
+// Ищет цепочку заданных данных в массиве слотов.
+// Если _link != NULL, в него помещается связь, указывающая на найденную цепочку.
+// Если цепочки нет, возвращает NULL.
+static c_hash_multiset_concurrent_chain *chain_find(const c_hash_multiset_concurrent *const _hash_multiset,
+                                                    c_hash_multiset_concurrent_table *const _table,
+                                                    const void *const _data,
+                                                    const size_t _hash,
+                                                    _Atomic(c_hash_multiset_concurrent_chain*) **const _link)
+{
+    _Atomic(c_hash_multiset_concurrent_chain*) *link = &_table->slots[_hash % _table->slots_count];
+
+    c_hash_multiset_concurrent_chain *select_chain = atomic_load_explicit(link, memory_order_acquire);
+    while (select_chain != NULL)
+    {
+        if (_hash == select_chain->hash)
+        {
+            // Голова может опустеть, если последний узел цепочки только что удален.
+            const c_hash_multiset_concurrent_node *const head = atomic_load_explicit(&select_chain->head,
+                                                                                     memory_order_acquire);
+            if ( (head != NULL) && (_hash_multiset->comp_data(_data, head->data) > 0) )
+            {
+                if (_link != NULL)
+                {
+                    *_link = link;
+                }
+                return select_chain;
+            }
+        }
+        link = &select_chain->next_chain;
+        select_chain = atomic_load_explicit(link, memory_order_acquire);
+    }
+
+    return NULL;
+}
+
+// Создает новое конкурентное хэш-мультимножество.
+// Количество слотов округляется вверх до кратного количеству полос (при нуле слотов
+// сразу задается количество по умолчанию).
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_multiset_concurrent *c_hash_multiset_concurrent_create(size_t (*const _hash_data)(const void *const _data),
+                                                              size_t (*const _comp_data)(const void *const _data_a,
+                                                                                         const void *const _data_b),
+                                                              const size_t _slots_count,
+                                                              const float _max_load_factor,
+                                                              size_t *const _error)
+{
+    if (_hash_data == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_comp_data == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if ( (_max_load_factor < C_HASH_MULTISET_CONCURRENT_MLF_MIN) ||
+         (_max_load_factor > C_HASH_MULTISET_CONCURRENT_MLF_MAX) )
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    const size_t slots_count = slots_round( (_slots_count > 0) ? _slots_count : C_HASH_MULTISET_CONCURRENT_0 );
+    if (slots_count == 0)
+    {
+        error_set(_error, 4);
+        return NULL;
+    }
+
+    c_hash_multiset_concurrent_table *const new_table = table_create(slots_count);
+    if (new_table == NULL)
+    {
+        error_set(_error, 5);
+        return NULL;
+    }
+
+    c_hash_multiset_concurrent *const new_hash_multiset = malloc(sizeof(c_hash_multiset_concurrent));
+    if (new_hash_multiset == NULL)
+    {
+        free(new_table);
+        error_set(_error, 6);
+        return NULL;
+    }
+
+    new_hash_multiset->hash_data = _hash_data;
+    new_hash_multiset->comp_data = _comp_data;
+
+    new_hash_multiset->max_load_factor = _max_load_factor;
+
+    atomic_init(&new_hash_multiset->table, new_table);
+    atomic_init(&new_hash_multiset->slots_count, slots_count);
+    atomic_init(&new_hash_multiset->nodes_count, 0);
+    atomic_init(&new_hash_multiset->uniques_count, 0);
+
+    for (size_t i = 0; i < C_HASH_MULTISET_CONCURRENT_STRIPES; ++i)
+    {
+        pthread_mutex_init(&new_hash_multiset->stripes[i].mutex, NULL);
+    }
+
+    atomic_init(&new_hash_multiset->epoch, 0);
+    for (size_t r = 0; r < C_HASH_MULTISET_CONCURRENT_READERS; ++r)
+    {
+        atomic_init(&new_hash_multiset->readers[0][r].count, 0);
+        atomic_init(&new_hash_multiset->readers[1][r].count, 0);
+    }
+
+    pthread_mutex_init(&new_hash_multiset->retire_lock, NULL);
+    new_hash_multiset->retired_nodes = NULL;
+    new_hash_multiset->retired_chains = NULL;
+    new_hash_multiset->retired_tables = NULL;
+    new_hash_multiset->retired_count = 0;
+
+    pthread_mutex_init(&new_hash_multiset->sync_lock, NULL);
+
+    return new_hash_multiset;
+}
+
+// Удаляет конкурентное хэш-мультимножество.
+// В момент удаления хэш-мультимножество не должно использоваться другими потоками.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_concurrent_delete(c_hash_multiset_concurrent *const _hash_multiset,
+                                            void (*const _del_data)(void *const _data))
+{
+    if (c_hash_multiset_concurrent_clear(_hash_multiset, _del_data) < 0)
+    {
+        return -1;
+    }
+
+    reclaim(_hash_multiset, 1);
+
+    free(atomic_load(&_hash_multiset->table));
+
+    for (size_t i = 0; i < C_HASH_MULTISET_CONCURRENT_STRIPES; ++i)
+    {
+        pthread_mutex_destroy(&_hash_multiset->stripes[i].mutex);
+    }
+    pthread_mutex_destroy(&_hash_multiset->retire_lock);
+    pthread_mutex_destroy(&_hash_multiset->sync_lock);
+
+    free(_hash_multiset);
+
+    return 1;
+}
+
+// Вставка данных в конкурентное хэш-мультимножество.
+// Блокирует только полосу, к которой относятся данные.
+// В случае успешной вставки возвращает > 0, данные захватываются хэш-мультимножеством.
+// В случае ошибки возвращает < 0, данные не захватываются хэш-мультимножеством.
+ptrdiff_t c_hash_multiset_concurrent_insert(c_hash_multiset_concurrent *const _hash_multiset,
+                                            const void *const _data)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    const size_t hash = _hash_multiset->hash_data(_data);
+
+    c_hash_multiset_concurrent_node *const new_node = malloc(sizeof(c_hash_multiset_concurrent_node));
+    if (new_node == NULL)
+    {
+        return -3;
+    }
+    new_node->data = (void*)_data;
+    new_node->del_data = NULL;
+
+    pthread_mutex_t *const stripe = &_hash_multiset->stripes[hash % C_HASH_MULTISET_CONCURRENT_STRIPES].mutex;
+    pthread_mutex_lock(stripe);
+
+    // Пока полоса заблокирована, массив слотов не может смениться.
+    c_hash_multiset_concurrent_table *const table = atomic_load_explicit(&_hash_multiset->table,
+                                                                         memory_order_acquire);
+
+    c_hash_multiset_concurrent_chain *const select_chain = chain_find(_hash_multiset, table, _data, hash, NULL);
+    if (select_chain != NULL)
+    {
+        new_node->next_node = atomic_load_explicit(&select_chain->head, memory_order_relaxed);
+        atomic_store_explicit(&select_chain->head, new_node, memory_order_release);
+        atomic_fetch_add(&select_chain->count, 1);
+    } else {
+        c_hash_multiset_concurrent_chain *const new_chain = malloc(sizeof(c_hash_multiset_concurrent_chain));
+        if (new_chain == NULL)
+        {
+            pthread_mutex_unlock(stripe);
+            free(new_node);
+            return -4;
+        }
+
+        _Atomic(c_hash_multiset_concurrent_chain*) *const slot = &table->slots[hash % table->slots_count];
+
+        new_node->next_node = NULL;
+        atomic_init(&new_chain->head, new_node);
+        atomic_init(&new_chain->count, 1);
+        new_chain->hash = hash;
+        new_chain->retired_next = NULL;
+        new_chain->retired_nodes = NULL;
+        new_chain->del_data = NULL;
+        atomic_init(&new_chain->next_chain, atomic_load_explicit(slot, memory_order_relaxed));
+
+        // Публикуем полностью построенную цепочку.
+        atomic_store_explicit(slot, new_chain, memory_order_release);
+
+        atomic_fetch_add(&_hash_multiset->uniques_count, 1);
+    }
+
+    atomic_fetch_add(&_hash_multiset->nodes_count, 1);
+
+    pthread_mutex_unlock(stripe);
+
+    // Ошибка расширения не мешает вставке: цепочки просто становятся длиннее.
+    grow(_hash_multiset);
+
+    return 1;
+}
+
+// Удаляет из конкурентного хэш-мультимножества одну единицу заданных данных.
+// Данные удаляются функцией _del_data не сразу, а когда их уже не могут видеть читатели.
+// В случае успешного удаления возвращает > 0.
+// В случае, если заданных данных в хэш-мультимножестве нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_concurrent_erase(c_hash_multiset_concurrent *const _hash_multiset,
+                                           const void *const _data,
+                                           void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    const size_t hash = _hash_multiset->hash_data(_data);
+
+    pthread_mutex_t *const stripe = &_hash_multiset->stripes[hash % C_HASH_MULTISET_CONCURRENT_STRIPES].mutex;
+    pthread_mutex_lock(stripe);
+
+    c_hash_multiset_concurrent_table *const table = atomic_load_explicit(&_hash_multiset->table,
+                                                                         memory_order_acquire);
+
+    _Atomic(c_hash_multiset_concurrent_chain*) *link;
+    c_hash_multiset_concurrent_chain *const select_chain = chain_find(_hash_multiset, table, _data, hash, &link);
+    if (select_chain == NULL)
+    {
+        pthread_mutex_unlock(stripe);
+        return 0;
+    }
+
+    c_hash_multiset_concurrent_node *const delete_node = atomic_load_explicit(&select_chain->head,
+                                                                              memory_order_relaxed);
+    atomic_store_explicit(&select_chain->head, delete_node->next_node, memory_order_release);
+    atomic_fetch_sub(&_hash_multiset->nodes_count, 1);
+
+    // Если цепочка опустела, вырезаем ее из слота.
+    if (atomic_fetch_sub(&select_chain->count, 1) == 1)
+    {
+        atomic_store_explicit(link,
+                              atomic_load_explicit(&select_chain->next_chain, memory_order_relaxed),
+                              memory_order_release);
+        atomic_fetch_sub(&_hash_multiset->uniques_count, 1);
+
+        retire_chain(_hash_multiset, select_chain, NULL, NULL);
+    }
+
+    retire_node(_hash_multiset, delete_node, _del_data);
+
+    pthread_mutex_unlock(stripe);
+
+    reclaim(_hash_multiset, 0);
+
+    return 1;
+}
+
+// Проверяет наличие заданных данных в конкурентном хэш-мультимножестве.
+// Не блокируется.
+// Если данные есть, возвращает > 0.
+// Если данных нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_concurrent_check(c_hash_multiset_concurrent *const _hash_multiset,
+                                           const void *const _data)
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    const size_t hash = _hash_multiset->hash_data(_data);
+
+    const size_t index = reader_index();
+    const size_t epoch = reader_enter(_hash_multiset, index);
+
+    c_hash_multiset_concurrent_table *const table = atomic_load_explicit(&_hash_multiset->table,
+                                                                         memory_order_acquire);
+    const ptrdiff_t r_code = (chain_find(_hash_multiset, table, _data, hash, NULL) != NULL) ? 1 : 0;
+
+    reader_exit(_hash_multiset, index, epoch);
+
+    return r_code;
+}
+
+// Возвращает количество заданных данных в конкурентном хэш-мультимножестве.
+// Не блокируется.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_concurrent_data_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                             const void *const _data,
+                                             size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    const size_t hash = _hash_multiset->hash_data(_data);
+
+    const size_t index = reader_index();
+    const size_t epoch = reader_enter(_hash_multiset, index);
+
+    c_hash_multiset_concurrent_table *const table = atomic_load_explicit(&_hash_multiset->table,
+                                                                         memory_order_acquire);
+    const c_hash_multiset_concurrent_chain *const select_chain = chain_find(_hash_multiset, table, _data, hash, NULL);
+    const size_t count = (select_chain != NULL) ? atomic_load(&select_chain->count) : 0;
+
+    reader_exit(_hash_multiset, index, epoch);
+
+    return count;
+}
+
+// Проходит по всем данным конкурентного хэш-мультимножества и выполняет над ними заданные действия.
+// На время обхода блокирует всех писателей.
+// В случае успешного выполнения возвращает > 0.
+// В случае, если в хэш-мультимножестве нет элементов, возвращает 0.
+// В случае ошибки < 0.
+ptrdiff_t c_hash_multiset_concurrent_for_each(c_hash_multiset_concurrent *const _hash_multiset,
+                                              void (*const _action_data)(const void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_action_data == NULL) return -2;
+
+    lock_all(_hash_multiset);
+
+    if (atomic_load(&_hash_multiset->uniques_count) == 0)
+    {
+        unlock_all(_hash_multiset);
+        return 0;
+    }
+
+    c_hash_multiset_concurrent_table *const table = atomic_load(&_hash_multiset->table);
+    for (size_t s = 0; s < table->slots_count; ++s)
+    {
+        const c_hash_multiset_concurrent_chain *select_chain = atomic_load(&table->slots[s]);
+        while (select_chain != NULL)
+        {
+            const c_hash_multiset_concurrent_node *select_node = atomic_load(&select_chain->head);
+            while (select_node != NULL)
+            {
+                _action_data( select_node->data );
+                select_node = select_node->next_node;
+            }
+            select_chain = atomic_load(&select_chain->next_chain);
+        }
+    }
+
+    unlock_all(_hash_multiset);
+
+    return 1;
+}
+
+// Очищает конкурентное хэш-мультимножество ото всех данных, количество слотов сохраняется.
+// На время очистки блокирует всех писателей, читателей не блокирует.
+// В случае успешного очищения возвращает > 0.
+// Если очищать не от чего, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_concurrent_clear(c_hash_multiset_concurrent *const _hash_multiset,
+                                           void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset == NULL) return -1;
+
+    lock_all(_hash_multiset);
+
+    if (atomic_load(&_hash_multiset->uniques_count) == 0)
+    {
+        unlock_all(_hash_multiset);
+        return 0;
+    }
+
+    c_hash_multiset_concurrent_table *const table = atomic_load(&_hash_multiset->table);
+    for (size_t s = 0; s < table->slots_count; ++s)
+    {
+        c_hash_multiset_concurrent_chain *select_chain = atomic_load(&table->slots[s]);
+        atomic_store_explicit(&table->slots[s], NULL, memory_order_release);
+        while (select_chain != NULL)
+        {
+            retire_chain(_hash_multiset, select_chain, atomic_load(&select_chain->head), _del_data);
+            select_chain = atomic_load(&select_chain->next_chain);
+        }
+    }
+
+    atomic_store(&_hash_multiset->nodes_count, 0);
+    atomic_store(&_hash_multiset->uniques_count, 0);
+
+    unlock_all(_hash_multiset);
+
+    reclaim(_hash_multiset, 1);
+
+    return 1;
+}
+
+// Удаляет из конкурентного хэш-мультимножества все единицы заданных данных.
+// Возвращает количество удаленных элементов.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_concurrent_erase_all(c_hash_multiset_concurrent *const _hash_multiset,
+                                            const void *const _data,
+                                            void (*const _del_data)(void *const _data),
+                                            size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    const size_t hash = _hash_multiset->hash_data(_data);
+
+    pthread_mutex_t *const stripe = &_hash_multiset->stripes[hash % C_HASH_MULTISET_CONCURRENT_STRIPES].mutex;
+    pthread_mutex_lock(stripe);
+
+    c_hash_multiset_concurrent_table *const table = atomic_load_explicit(&_hash_multiset->table,
+                                                                         memory_order_acquire);
+
+    _Atomic(c_hash_multiset_concurrent_chain*) *link;
+    c_hash_multiset_concurrent_chain *const select_chain = chain_find(_hash_multiset, table, _data, hash, &link);
+    if (select_chain == NULL)
+    {
+        pthread_mutex_unlock(stripe);
+        return 0;
+    }
+
+    // Ампутация цепи, ее узлы освобождаются вместе с ней.
+    atomic_store_explicit(link,
+                          atomic_load_explicit(&select_chain->next_chain, memory_order_relaxed),
+                          memory_order_release);
+
+    const size_t count = atomic_load(&select_chain->count);
+    atomic_fetch_sub(&_hash_multiset->nodes_count, count);
+    atomic_fetch_sub(&_hash_multiset->uniques_count, 1);
+
+    retire_chain(_hash_multiset, select_chain, atomic_load(&select_chain->head), _del_data);
+
+    pthread_mutex_unlock(stripe);
+
+    reclaim(_hash_multiset, 0);
+
+    return count;
+}
+
+// Возвращает количество слотов в конкурентном хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_concurrent_slots_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                              size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return atomic_load(&_hash_multiset->slots_count);
+}
+
+// Возвращает количество узлов (объектов) в конкурентном хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_concurrent_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                        size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return atomic_load(&_hash_multiset->nodes_count);
+}
+
+// Возвращает количество уникальных объектов в конкурентном хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_concurrent_uniques_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                                size_t *const _error)
+{
+    if (_hash_multiset == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return atomic_load(&_hash_multiset->uniques_count);
+}
@@ -0,0 +1,60 @@
+﻿/*
+    Заголовочный файл конкурентного хэш-мультимножества c_hash_multiset_concurrent
+    Писатели блокируют только свою полосу слотов, читатели (check, data_count) не блокируются,
+    освобождаемые цепочки и узлы возвращаются после эпохи, в которой их могли видеть читатели.
+
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MULTISET_CONCURRENT_H
+#define C_HASH_MULTISET_CONCURRENT_H
+
+#include <stddef.h>
+
+typedef struct s_c_hash_multiset_concurrent c_hash_multiset_concurrent;
+
+c_hash_multiset_concurrent *c_hash_multiset_concurrent_create(size_t (*const _hash_data)(const void *const _data),
+                                                              size_t (*const _comp_data)(const void *const _data_a,
+                                                                                         const void *const _data_b),
+                                                              const size_t _slots_count,
+                                                              const float _max_load_factor,
+                                                              size_t *const _error);
+
+ptrdiff_t c_hash_multiset_concurrent_delete(c_hash_multiset_concurrent *const _hash_multiset,
+                                            void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_multiset_concurrent_insert(c_hash_multiset_concurrent *const _hash_multiset,
+                                            const void *const _data);
+
+ptrdiff_t c_hash_multiset_concurrent_erase(c_hash_multiset_concurrent *const _hash_multiset,
+                                           const void *const _data,
+                                           void (*const _del_data)(void *const _data));
+
+ptrdiff_t c_hash_multiset_concurrent_check(c_hash_multiset_concurrent *const _hash_multiset,
+                                           const void *const _data);
+
+size_t c_hash_multiset_concurrent_data_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                             const void *const _data,
+                                             size_t *const _error);
+
+ptrdiff_t c_hash_multiset_concurrent_for_each(c_hash_multiset_concurrent *const _hash_multiset,
+                                              void (*const _action_data)(const void *const _data));
+
+ptrdiff_t c_hash_multiset_concurrent_clear(c_hash_multiset_concurrent *const _hash_multiset,
+                                           void (*const _del_data)(void *const _data));
+
+size_t c_hash_multiset_concurrent_erase_all(c_hash_multiset_concurrent *const _hash_multiset,
+                                            const void *const _data,
+                                            void (*const _del_data)(void *const _data),
+                                            size_t *const _error);
+
+size_t c_hash_multiset_concurrent_slots_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                              size_t *const _error);
+
+size_t c_hash_multiset_concurrent_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                        size_t *const _error);
+
+size_t c_hash_multiset_concurrent_uniques_count(c_hash_multiset_concurrent *const _hash_multiset,
+                                                size_t *const _error);
+
+#endif
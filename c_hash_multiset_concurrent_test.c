@@ -0,0 +1,287 @@
+﻿/*
+    Нагрузочный тест конкурентного хэш-мультимножества c_hash_multiset_concurrent
+    Несколько писателей вставляют и удаляют данные (insert, erase, erase_all), пока несколько
+    читателей проверяют их наличие (check, data_count), а хэш-мультимножество растет с 64 слотов.
+    Каждый писатель владеет своими ключами (номер ключа по модулю количества писателей) и ведет
+    их счет, после завершения потоков count, uniques_count и data_count каждого ключа сверяются со счетом.
+    Кроме того, каждый писатель по одному вставляет ключи своего диапазона, которые никогда не удаляет,
+    и после каждой вставки публикует их количество (отметку); читатели проверяют, что ключи ниже
+    отметки видны (check == 1, data_count >= 1), в том числе во время перестроений.
+
+    Сборка (пример):
+    cc -O2 c_hash_multiset_concurrent_test.c c_hash_multiset_concurrent.c -lpthread -o concurrent_test
+
+    Проверка санитайзерами:
+    cc -g -fsanitize=address c_hash_multiset_concurrent_test.c c_hash_multiset_concurrent.c -lpthread
+    cc -g -fsanitize=thread c_hash_multiset_concurrent_test.c c_hash_multiset_concurrent.c -lpthread
+    Под TSan запускать с TSAN_OPTIONS=detect_deadlocks=0: перестроение и очистка удерживают
+    все 64 мьютекса полос сразу, что переполняет детектор взаимоблокировок TSan
+    (CHECK failed в sanitizer_deadlock_detector.h).
+
+    Запуск:
+    concurrent_test [операций на писателя]
+    Возвращает 0, если проверки пройдены.
+
+    Лицензия: GPLv3
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "c_hash_multiset_concurrent.h"
+
+// Количество потоков писателей и читателей.
+#define TEST_WRITERS ( (size_t) 4 )
+#define TEST_READERS ( (size_t) 4 )
+
+// Количество различных ключей.
+#define TEST_KEYS ( (size_t) 20000 )
+
+// Количество неудаляемых ключей каждого писателя (следуют за TEST_KEYS различными ключами).
+#define TEST_COMMITTED ( (size_t) 2000 )
+
+// Всего ключей.
+#define TEST_KEYS_ALL ( TEST_KEYS + TEST_WRITERS * TEST_COMMITTED )
+
+// Каждая какая операция писателя вставляет очередной неудаляемый ключ.
+#define TEST_COMMIT_PERIOD ( (size_t) 8 )
+
+// Количество операций каждого писателя по умолчанию.
+#define TEST_OPERATIONS ( (size_t) 200000 )
+
+// Ключи: данные хэш-мультимножества - указатели на элементы массива.
+static uint64_t keys[TEST_KEYS_ALL];
+
+// Количество единиц каждого ключа по счету его писателя.
+static size_t tally[TEST_KEYS_ALL];
+
+// Отметка каждого писателя: количество его неудаляемых ключей, вставка которых завершена.
+static atomic_size_t committed[TEST_WRITERS];
+
+static c_hash_multiset_concurrent *hash_multiset;
+
+static size_t operations = TEST_OPERATIONS;
+
+static atomic_size_t writers_running;
+
+static atomic_size_t failures;
+
+// Функция хэша ключа.
+static size_t hash_key(const void *const _data)
+{
+    uint64_t x = *(const uint64_t*)_data;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+// Функция сравнения ключей.
+static size_t comp_key(const void *const _data_a,
+                       const void *const _data_b)
+{
+    return *(const uint64_t*)_data_a == *(const uint64_t*)_data_b;
+}
+
+// Генератор псевдослучайных чисел (xorshift).
+static uint64_t random_next(uint64_t *const _state)
+{
+    uint64_t x = *_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *_state = x;
+    return x;
+}
+
+// Регистрирует проваленную проверку.
+static void fail(const char *const _what,
+                 const size_t _key)
+{
+    fprintf(stderr, "FAIL: %s (key %zu)\n", _what, _key);
+    atomic_fetch_add(&failures, 1);
+}
+
+// Писатель: вставки (чаще всего), удаления одной единицы и всех единиц своих ключей.
+static void *writer(void *const _argument)
+{
+    const size_t w = (size_t)(uintptr_t)_argument;
+    uint64_t state = 0x9E3779B97F4A7C15ull * (w + 1);
+
+    size_t committed_count = 0;
+
+    for (size_t i = 0; i < operations; ++i)
+    {
+        if ( (i % TEST_COMMIT_PERIOD == 0) && (committed_count < TEST_COMMITTED) )
+        {
+            const size_t key = TEST_KEYS + w * TEST_COMMITTED + committed_count;
+            if (c_hash_multiset_concurrent_insert(hash_multiset, &keys[key]) <= 0)
+            {
+                fail("committed insert", key);
+            } else {
+                ++tally[key];
+            }
+            // Отметка публикуется после вставки: ключи ниже нее читатель обязан видеть.
+            atomic_store_explicit(&committed[w], ++committed_count, memory_order_release);
+        }
+
+        const size_t key = (size_t)(random_next(&state) % (TEST_KEYS / TEST_WRITERS)) * TEST_WRITERS + w;
+        const unsigned action = (unsigned)(random_next(&state) % 16);
+
+        if (action < 10)
+        {
+            if (c_hash_multiset_concurrent_insert(hash_multiset, &keys[key]) <= 0)
+            {
+                fail("insert", key);
+            } else {
+                ++tally[key];
+            }
+        } else if (action < 15) {
+            const ptrdiff_t r_code = c_hash_multiset_concurrent_erase(hash_multiset, &keys[key], NULL);
+            if (r_code != ((tally[key] > 0) ? 1 : 0))
+            {
+                fail("erase", key);
+            }
+            if (tally[key] > 0)
+            {
+                --tally[key];
+            }
+        } else {
+            size_t error = 0;
+            const size_t count = c_hash_multiset_concurrent_erase_all(hash_multiset, &keys[key], NULL, &error);
+            if ( (error != 0) || (count != tally[key]) )
+            {
+                fail("erase_all", key);
+            }
+            tally[key] = 0;
+        }
+    }
+
+    atomic_fetch_sub(&writers_running, 1);
+
+    return NULL;
+}
+
+// Читатель: check и data_count случайных ключей и неудаляемых ключей ниже отметок писателей,
+// пока работают писатели.
+static void *reader(void *const _argument)
+{
+    const size_t r = (size_t)(uintptr_t)_argument;
+    uint64_t state = 0xD1B54A32D192ED03ull * (r + 1);
+
+    while (atomic_load(&writers_running) > 0)
+    {
+        const size_t key = (size_t)(random_next(&state) % TEST_KEYS);
+
+        const ptrdiff_t r_code = c_hash_multiset_concurrent_check(hash_multiset, &keys[key]);
+        if ( (r_code != 0) && (r_code != 1) )
+        {
+            fail("check", key);
+        }
+
+        size_t error = 0;
+        c_hash_multiset_concurrent_data_count(hash_multiset, &keys[key], &error);
+        if (error != 0)
+        {
+            fail("data_count", key);
+        }
+
+        const size_t w = (size_t)(random_next(&state) % TEST_WRITERS);
+        const size_t committed_count = atomic_load_explicit(&committed[w], memory_order_acquire);
+        if (committed_count > 0)
+        {
+            const size_t committed_key = TEST_KEYS + w * TEST_COMMITTED +
+                                         (size_t)(random_next(&state) % committed_count);
+
+            if (c_hash_multiset_concurrent_check(hash_multiset, &keys[committed_key]) != 1)
+            {
+                fail("committed check", committed_key);
+            }
+
+            error = 0;
+            if ( (c_hash_multiset_concurrent_data_count(hash_multiset, &keys[committed_key], &error) < 1) ||
+                 (error != 0) )
+            {
+                fail("committed data_count", committed_key);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        operations = (size_t)strtoull(argv[1], NULL, 10);
+    }
+
+    for (size_t k = 0; k < TEST_KEYS_ALL; ++k)
+    {
+        keys[k] = k;
+    }
+
+    size_t error = 0;
+    hash_multiset = c_hash_multiset_concurrent_create(hash_key, comp_key, 64, 1.0f, &error);
+    if (hash_multiset == NULL)
+    {
+        fprintf(stderr, "create failed: %zu\n", error);
+        return 1;
+    }
+    const size_t slots_begin = c_hash_multiset_concurrent_slots_count(hash_multiset, NULL);
+
+    pthread_t writers[TEST_WRITERS],
+              readers[TEST_READERS];
+    atomic_store(&writers_running, TEST_WRITERS);
+    for (size_t r = 0; r < TEST_READERS; ++r)
+    {
+        pthread_create(&readers[r], NULL, reader, (void*)(uintptr_t)r);
+    }
+    for (size_t w = 0; w < TEST_WRITERS; ++w)
+    {
+        pthread_create(&writers[w], NULL, writer, (void*)(uintptr_t)w);
+    }
+    for (size_t w = 0; w < TEST_WRITERS; ++w)
+    {
+        pthread_join(writers[w], NULL);
+    }
+    for (size_t r = 0; r < TEST_READERS; ++r)
+    {
+        pthread_join(readers[r], NULL);
+    }
+
+    // Сверка со счетом писателей.
+    size_t count = 0,
+           uniques_count = 0;
+    for (size_t k = 0; k < TEST_KEYS_ALL; ++k)
+    {
+        count += tally[k];
+        uniques_count += (tally[k] > 0) ? 1 : 0;
+        if (c_hash_multiset_concurrent_data_count(hash_multiset, &keys[k], NULL) != tally[k])
+        {
+            fail("final data_count", k);
+        }
+    }
+    if (c_hash_multiset_concurrent_count(hash_multiset, NULL) != count)
+    {
+        fail("final count", count);
+    }
+    if (c_hash_multiset_concurrent_uniques_count(hash_multiset, NULL) != uniques_count)
+    {
+        fail("final uniques_count", uniques_count);
+    }
+    const size_t slots_end = c_hash_multiset_concurrent_slots_count(hash_multiset, NULL);
+
+    c_hash_multiset_concurrent_delete(hash_multiset, NULL);
+
+    const size_t failures_count = atomic_load(&failures);
+    printf("writers %zu, readers %zu, operations %zu, count %zu, uniques %zu, slots %zu -> %zu: %s\n",
+           TEST_WRITERS, TEST_READERS, operations, count, uniques_count, slots_begin, slots_end,
+           (failures_count == 0) ? "OK" : "FAILED");
+
+    return (failures_count == 0) ? 0 : 1;
+}
@@ -0,0 +1,801 @@
+﻿/*
+    Файл реализации замороженного хэш-мультимножества c_hash_multiset_frozen
+    c_hash_multiset_freeze() записывает содержимое хэш-мультимножества в файл без указателей:
+    совершенный индекс по хэшам и упакованные записи (данные, количество).
+    c_hash_multiset_frozen_open() отображает файл в память только для чтения и отвечает
+    на check и data_count без десериализации; страницы файла разделяются между процессами.
+
+    Лицензия: GPLv3
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "c_hash_multiset_frozen.h"
+
+// Версия формата файла.
+#define C_HASH_MULTISET_FROZEN_VERSION ( (uint32_t) 1 )
+
+// Метка порядка байт: файл читается только на платформе с тем же порядком байт.
+#define C_HASH_MULTISET_FROZEN_BYTE_ORDER ( (uint32_t) 0x01020304 )
+
+// Среднее количество хэшей в корзине совершенного индекса.
+#define C_HASH_MULTISET_FROZEN_BUCKET ( (size_t) 4 )
+
+// Количество попыток построения индекса с разными затравками.
+#define C_HASH_MULTISET_FROZEN_SEEDS ( (size_t) 16 )
+
+// Наибольшее смещение корзины, перебираемое при построении индекса.
+#define C_HASH_MULTISET_FROZEN_PILOT_MAX ( (uint32_t) 1 << 20 )
+
+// Позиция индекса без записи.
+#define C_HASH_MULTISET_FROZEN_EMPTY ( UINT64_MAX )
+
+// Размер буфера сериализации искомых данных на стеке.
+#define C_HASH_MULTISET_FROZEN_QUERY ( (size_t) 256 )
+
+// Заголовок файла. Файл: заголовок, смещения корзин (uint32_t), позиции индекса
+// (uint64_t, смещение первой записи с хэшем позиции от начала записей), записи.
+typedef struct s_c_hash_multiset_frozen_header
+{
+    uint8_t magic[4];
+    uint32_t version,
+             byte_order,
+             reserved;
+    uint64_t uniques_count,
+             nodes_count,
+             hashes_count,
+             buckets_count,
+             table_size,
+             seed,
+             pilots_offset,
+             table_offset,
+             records_offset,
+             file_size;
+} c_hash_multiset_frozen_header;
+
+// Запись: хэш, количество данных и размер представления данных, за которым следует
+// само представление, дополненное до 8 байт. Записи с одинаковым хэшем идут подряд.
+typedef struct s_c_hash_multiset_frozen_record
+{
+    uint64_t hash,
+             count,
+             size;
+} c_hash_multiset_frozen_record;
+
+struct s_c_hash_multiset_frozen
+{
+    size_t (*hash_data)(const void *const _data);
+    size_t (*serialize_data)(const void *const _data,
+                             void *const _buffer,
+                             const size_t _size);
+
+    // Отображение файла.
+    const uint8_t *base;
+    size_t size;
+#if defined(_WIN32)
+    HANDLE file,
+           mapping;
+#endif
+
+    const c_hash_multiset_frozen_header *header;
+    const uint32_t *pilots;
+    const uint64_t *table;
+    const uint8_t *records;
+    uint64_t records_size;
+};
+
+// Уникальные данные замораживаемого хэш-мультимножества.
+typedef struct s_c_hash_multiset_frozen_entry
+{
+    uint64_t hash;
+    const void *data;
+    size_t count,
+           size;
+} c_hash_multiset_frozen_entry;
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
+    {
+        *_error = _code;
+    }
+}
+
+// Округление размера вверх до 8 байт.
+static uint64_t round8(const uint64_t _size)
+{
+    return (_size + 7) & ~(uint64_t)7;
+}
+
+// Старшие 64 бита 128-битного произведения.
+static uint64_t mul_high(const uint64_t _a,
+                         const uint64_t _b)
+{
+#if defined(__SIZEOF_INT128__)
+    return (uint64_t)(((unsigned __int128)_a * _b) >> 64);
+#else
+    const uint64_t a_low = (uint32_t)_a,
+                   a_high = _a >> 32,
+                   b_low = (uint32_t)_b,
+                   b_high = _b >> 32;
+    const uint64_t low_low = a_low * b_low,
+                   high_low = a_high * b_low,
+                   low_high = a_low * b_high;
+    const uint64_t middle = (low_low >> 32) + (uint32_t)high_low + (uint32_t)low_high;
+    return a_high * b_high + (high_low >> 32) + (low_high >> 32) + (middle >> 32);
+#endif
+}
+
+// Финальное перемешивание MurmurHash3: хэш пользователя может быть плохим в отдельных битах.
+static uint64_t frozen_mix(uint64_t _value)
+{
+    _value ^= _value >> 33;
+    _value *= 0xFF51AFD7ED558CCDull;
+    _value ^= _value >> 33;
+    _value *= 0xC4CEB9FE1A85EC53ull;
+    _value ^= _value >> 33;
+    return _value;
+}
+
+// Позиция индекса для перемешанного хэша при заданном смещении корзины.
+static uint64_t frozen_position(const uint64_t _mixed,
+                                const uint32_t _pilot,
+                                const uint64_t _table_size)
+{
+    return mul_high(frozen_mix(_mixed ^ ((uint64_t)_pilot * 0x9E3779B97F4A7C15ull)), _table_size);
+}
+
+// Сравнение записей по хэшу для сортировки.
+static int frozen_entry_order(const void *const _a,
+                              const void *const _b)
+{
+    const uint64_t a = ((const c_hash_multiset_frozen_entry*)_a)->hash,
+                   b = ((const c_hash_multiset_frozen_entry*)_b)->hash;
+    return (a > b) - (a < b);
+}
+
+// Корзина индекса и количество хэшей в ней, для упорядочивания корзин по убыванию размера.
+typedef struct s_c_hash_multiset_frozen_bucket
+{
+    size_t size,
+           bucket;
+} c_hash_multiset_frozen_bucket;
+
+static int frozen_bucket_order(const void *const _a,
+                               const void *const _b)
+{
+    const size_t a = ((const c_hash_multiset_frozen_bucket*)_a)->size,
+                 b = ((const c_hash_multiset_frozen_bucket*)_b)->size;
+    return (a < b) - (a > b);
+}
+
+// Строит совершенный индекс (hash and displace) для _hashes_count различных хэшей:
+// хэш попадает в корзину, корзины от больших к меньшим подбирают смещение, при котором
+// все их хэши занимают свободные позиции таблицы. В _positions помещаются позиции хэшей.
+// В случае успеха возвращает > 0.
+// Если индекс не удалось построить, возвращает 0.
+// В случае ошибки выделения памяти возвращает < 0.
+static ptrdiff_t frozen_index(const uint64_t *const _hashes,
+                              const size_t _hashes_count,
+                              const size_t _buckets_count,
+                              const size_t _table_size,
+                              uint64_t *const _seed,
+                              uint32_t *const _pilots,
+                              uint64_t *const _positions)
+{
+    size_t *const bucket_start = calloc(_buckets_count + 1, sizeof(size_t));
+    size_t *const members = malloc((_hashes_count + 1) * sizeof(size_t));
+    c_hash_multiset_frozen_bucket *const order = malloc(_buckets_count * sizeof(c_hash_multiset_frozen_bucket));
+    uint8_t *const taken = malloc(_table_size);
+    if ( (bucket_start == NULL) || (members == NULL) || (order == NULL) || (taken == NULL) )
+    {
+        free(bucket_start);
+        free(members);
+        free(order);
+        free(taken);
+        return -1;
+    }
+
+    ptrdiff_t r_code = 0;
+    for (size_t attempt = 0; (attempt < C_HASH_MULTISET_FROZEN_SEEDS) && (r_code == 0); ++attempt)
+    {
+        const uint64_t seed = frozen_mix(attempt + 1);
+
+        // Раскладываем хэши по корзинам подсчетом.
+        memset(bucket_start, 0, (_buckets_count + 1) * sizeof(size_t));
+        for (size_t h = 0; h < _hashes_count; ++h)
+        {
+            ++bucket_start[mul_high(frozen_mix(_hashes[h] ^ seed), _buckets_count) + 1];
+        }
+        for (size_t b = 0; b < _buckets_count; ++b)
+        {
+            order[b].size = bucket_start[b + 1];
+            order[b].bucket = b;
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        for (size_t h = 0; h < _hashes_count; ++h)
+        {
+            const size_t b = (size_t)mul_high(frozen_mix(_hashes[h] ^ seed), _buckets_count);
+            members[bucket_start[b]++] = h;
+        }
+        // Теперь bucket_start[b] - конец корзины b.
+        qsort(order, _buckets_count, sizeof(c_hash_multiset_frozen_bucket), frozen_bucket_order);
+
+        memset(taken, 0, _table_size);
+        memset(_pilots, 0, _buckets_count * sizeof(uint32_t));
+
+        r_code = 1;
+        for (size_t o = 0; (o < _buckets_count) && (order[o].size > 0); ++o)
+        {
+            const size_t b = order[o].bucket;
+            const size_t first = bucket_start[b] - order[o].size,
+                         last = bucket_start[b];
+
+            uint32_t pilot = 0;
+            for ( ; pilot < C_HASH_MULTISET_FROZEN_PILOT_MAX; ++pilot)
+            {
+                size_t m = first;
+                for ( ; m < last; ++m)
+                {
+                    const size_t h = members[m];
+                    const uint64_t position = frozen_position(frozen_mix(_hashes[h] ^ seed), pilot, _table_size);
+                    if (taken[position] != 0)
+                    {
+                        break;
+                    }
+                    taken[position] = 1;
+                    _positions[h] = position;
+                }
+                if (m == last)
+                {
+                    break;
+                }
+                // Освобождаем позиции, занятые этой попыткой.
+                for (size_t u = first; u < m; ++u)
+                {
+                    taken[_positions[members[u]]] = 0;
+                }
+            }
+            if (pilot == C_HASH_MULTISET_FROZEN_PILOT_MAX)
+            {
+                r_code = 0;
+                break;
+            }
+            _pilots[b] = pilot;
+        }
+        *_seed = seed;
+    }
+
+    free(bucket_start);
+    free(members);
+    free(order);
+    free(taken);
+
+    return r_code;
+}
+
+// Записывает заданное количество байт в файл.
+// В случае успеха возвращает > 0, в случае ошибки записи - < 0.
+static ptrdiff_t frozen_write(FILE *const _file,
+                              const void *const _bytes,
+                              const size_t _size)
+{
+    return (fwrite(_bytes, 1, _size, _file) == _size) ? 1 : -1;
+}
+
+// Записывает содержимое хэш-мультимножества в файл _path для c_hash_multiset_frozen_open().
+// Индекс строится по _hash_data (той же функции, что будет передана при открытии; обычно -
+// функции хэша хэш-мультимножества).
+// _serialize_data помещает представление данных в _buffer, если оно умещается в _size байт
+// (_buffer может быть NULL при _size == 0), и возвращает размер представления;
+// в случае ошибки возвращает SIZE_MAX. Равные данные должны иметь одинаковые представления:
+// при поиске сравниваются представления.
+// Сохраняются данные первого узла каждой цепочки и количество повторов.
+// Файл записывается с порядком байт платформы.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_freeze(const c_hash_multiset *const _hash_multiset,
+                                 const char *const _path,
+                                 size_t (*const _hash_data)(const void *const _data),
+                                 size_t (*const _serialize_data)(const void *const _data,
+                                                                 void *const _buffer,
+                                                                 const size_t _size))
+{
+    if (_hash_multiset == NULL) return -1;
+    if (_path == NULL) return -2;
+    if (_hash_data == NULL) return -3;
+    if (_serialize_data == NULL) return -4;
+
+    const size_t uniques_count = c_hash_multiset_uniques_count(_hash_multiset, NULL);
+
+    // Собираем уникальные данные и упорядочиваем их по хэшу.
+    c_hash_multiset_frozen_entry *const entries = malloc((uniques_count + 1) * sizeof(c_hash_multiset_frozen_entry));
+    if (entries == NULL)
+    {
+        return -5;
+    }
+
+    c_hash_multiset_iter iter;
+    c_hash_multiset_iter_init(_hash_multiset, &iter, 1);
+    size_t entries_count = 0;
+    uint64_t nodes_count = 0;
+    const void *data;
+    size_t count;
+    while ( (entries_count < uniques_count) &&
+            (c_hash_multiset_iter_next(_hash_multiset, &iter, &data, &count) > 0) )
+    {
+        c_hash_multiset_frozen_entry *const entry = &entries[entries_count++];
+        entry->hash = (uint64_t)_hash_data(data);
+        entry->data = data;
+        entry->count = count;
+        entry->size = _serialize_data(data, NULL, 0);
+        if (entry->size == SIZE_MAX)
+        {
+            free(entries);
+            return -6;
+        }
+        nodes_count += count;
+    }
+    qsort(entries, entries_count, sizeof(c_hash_multiset_frozen_entry), frozen_entry_order);
+
+    // Различные хэши и смещения их первых записей.
+    size_t hashes_count = 0;
+    for (size_t e = 0; e < entries_count; ++e)
+    {
+        if ( (e == 0) || (entries[e].hash != entries[e - 1].hash) )
+        {
+            ++hashes_count;
+        }
+    }
+
+    const size_t buckets_count = hashes_count / C_HASH_MULTISET_FROZEN_BUCKET + 1;
+    // Загруженность таблицы индекса - около 0.9.
+    const size_t table_size = hashes_count + hashes_count / 9 + 1;
+
+    uint64_t *const hashes = malloc((hashes_count + 1) * sizeof(uint64_t));
+    uint64_t *const offsets = malloc((hashes_count + 1) * sizeof(uint64_t));
+    uint64_t *const positions = malloc((hashes_count + 1) * sizeof(uint64_t));
+    uint32_t *const pilots = malloc(buckets_count * sizeof(uint32_t));
+    uint64_t *const table = malloc(table_size * sizeof(uint64_t));
+
+    // Макрос освобождения временных массивов.
+    #define C_HASH_MULTISET_FROZEN_FREE\
+        free(entries);\
+        free(hashes);\
+        free(offsets);\
+        free(positions);\
+        free(pilots);\
+        free(table);
+
+    if ( (hashes == NULL) || (offsets == NULL) || (positions == NULL) || (pilots == NULL) || (table == NULL) )
+    {
+        C_HASH_MULTISET_FROZEN_FREE
+        return -5;
+    }
+
+    uint64_t records_size = 0;
+    size_t h = 0;
+    for (size_t e = 0; e < entries_count; ++e)
+    {
+        if ( (e == 0) || (entries[e].hash != entries[e - 1].hash) )
+        {
+            hashes[h] = entries[e].hash;
+            offsets[h] = records_size;
+            ++h;
+        }
+        records_size += sizeof(c_hash_multiset_frozen_record) + round8(entries[e].size);
+    }
+
+    uint64_t seed = 0;
+    const ptrdiff_t index_code = frozen_index(hashes, hashes_count, buckets_count, table_size, &seed, pilots, positions);
+    if (index_code <= 0)
+    {
+        C_HASH_MULTISET_FROZEN_FREE
+        return (index_code < 0) ? -5 : -7;
+    }
+
+    for (size_t t = 0; t < table_size; ++t)
+    {
+        table[t] = C_HASH_MULTISET_FROZEN_EMPTY;
+    }
+    for (size_t g = 0; g < hashes_count; ++g)
+    {
+        table[positions[g]] = offsets[g];
+    }
+
+    c_hash_multiset_frozen_header header;
+    memset(&header, 0, sizeof(c_hash_multiset_frozen_header));
+    memcpy(header.magic, "CHMF", 4);
+    header.version = C_HASH_MULTISET_FROZEN_VERSION;
+    header.byte_order = C_HASH_MULTISET_FROZEN_BYTE_ORDER;
+    header.uniques_count = entries_count;
+    header.nodes_count = nodes_count;
+    header.hashes_count = hashes_count;
+    header.buckets_count = buckets_count;
+    header.table_size = table_size;
+    header.seed = seed;
+    header.pilots_offset = sizeof(c_hash_multiset_frozen_header);
+    header.table_offset = header.pilots_offset + round8(buckets_count * sizeof(uint32_t));
+    header.records_offset = header.table_offset + table_size * sizeof(uint64_t);
+    header.file_size = header.records_offset + records_size;
+
+    FILE *const file = fopen(_path, "wb");
+    if (file == NULL)
+    {
+        C_HASH_MULTISET_FROZEN_FREE
+        return -8;
+    }
+
+    const uint8_t padding[8] = {0};
+    ptrdiff_t r_code = frozen_write(file, &header, sizeof(c_hash_multiset_frozen_header));
+    if (r_code > 0) r_code = frozen_write(file, pilots, buckets_count * sizeof(uint32_t));
+    if (r_code > 0) r_code = frozen_write(file, padding, (size_t)(header.table_offset - header.pilots_offset -
+                                                                  buckets_count * sizeof(uint32_t)));
+    if (r_code > 0) r_code = frozen_write(file, table, table_size * sizeof(uint64_t));
+
+    // Записи: представления данных получаются повторным вызовом _serialize_data.
+    size_t buffer_size = 0;
+    void *buffer = NULL;
+    for (size_t e = 0; (e < entries_count) && (r_code > 0); ++e)
+    {
+        const c_hash_multiset_frozen_entry *const entry = &entries[e];
+        if (entry->size > buffer_size)
+        {
+            free(buffer);
+            buffer_size = entry->size;
+            buffer = malloc(buffer_size);
+            if (buffer == NULL)
+            {
+                r_code = -5;
+                break;
+            }
+        }
+        if (_serialize_data(entry->data, buffer, buffer_size) != entry->size)
+        {
+            r_code = -6;
+            break;
+        }
+
+        c_hash_multiset_frozen_record record;
+        record.hash = entry->hash;
+        record.count = entry->count;
+        record.size = entry->size;
+        r_code = frozen_write(file, &record, sizeof(c_hash_multiset_frozen_record));
+        if (r_code > 0) r_code = frozen_write(file, buffer, entry->size);
+        if (r_code > 0) r_code = frozen_write(file, padding, (size_t)(round8(entry->size) - entry->size));
+    }
+    free(buffer);
+
+    C_HASH_MULTISET_FROZEN_FREE
+    #undef C_HASH_MULTISET_FROZEN_FREE
+
+    if (fclose(file) != 0)
+    {
+        r_code = (r_code > 0) ? -8 : r_code;
+    }
+    if (r_code < 0)
+    {
+        remove(_path);
+        return (r_code == -1) ? -8 : r_code;
+    }
+
+    return 1;
+}
+
+// Открывает файл, записанный c_hash_multiset_freeze(), отображая его в память только для чтения.
+// _hash_data и _serialize_data должны совпадать с переданными при заморозке.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+c_hash_multiset_frozen *c_hash_multiset_frozen_open(const char *const _path,
+                                                    size_t (*const _hash_data)(const void *const _data),
+                                                    size_t (*const _serialize_data)(const void *const _data,
+                                                                                    void *const _buffer,
+                                                                                    const size_t _size),
+                                                    size_t *const _error)
+{
+    if (_path == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+    if (_hash_data == NULL)
+    {
+        error_set(_error, 2);
+        return NULL;
+    }
+    if (_serialize_data == NULL)
+    {
+        error_set(_error, 3);
+        return NULL;
+    }
+
+    c_hash_multiset_frozen *const new_frozen = malloc(sizeof(c_hash_multiset_frozen));
+    if (new_frozen == NULL)
+    {
+        error_set(_error, 6);
+        return NULL;
+    }
+    new_frozen->hash_data = _hash_data;
+    new_frozen->serialize_data = _serialize_data;
+
+    // Отображаем файл.
+#if defined(_WIN32)
+    new_frozen->file = CreateFileA(_path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER file_size;
+    if ( (new_frozen->file == INVALID_HANDLE_VALUE) ||
+         (GetFileSizeEx(new_frozen->file, &file_size) == 0) ||
+         ((uint64_t)file_size.QuadPart > SIZE_MAX) ||
+         ((uint64_t)file_size.QuadPart < sizeof(c_hash_multiset_frozen_header)) )
+    {
+        if (new_frozen->file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(new_frozen->file);
+        }
+        free(new_frozen);
+        error_set(_error, 4);
+        return NULL;
+    }
+    new_frozen->size = (size_t)file_size.QuadPart;
+    new_frozen->mapping = CreateFileMappingA(new_frozen->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    new_frozen->base = (new_frozen->mapping != NULL) ?
+                       MapViewOfFile(new_frozen->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (new_frozen->base == NULL)
+    {
+        if (new_frozen->mapping != NULL)
+        {
+            CloseHandle(new_frozen->mapping);
+        }
+        CloseHandle(new_frozen->file);
+        free(new_frozen);
+        error_set(_error, 4);
+        return NULL;
+    }
+#else
+    const int descriptor = open(_path, O_RDONLY);
+    struct stat file_stat;
+    if ( (descriptor < 0) ||
+         (fstat(descriptor, &file_stat) != 0) ||
+         ((uint64_t)file_stat.st_size > SIZE_MAX) ||
+         ((uint64_t)file_stat.st_size < sizeof(c_hash_multiset_frozen_header)) )
+    {
+        if (descriptor >= 0)
+        {
+            close(descriptor);
+        }
+        free(new_frozen);
+        error_set(_error, 4);
+        return NULL;
+    }
+    new_frozen->size = (size_t)file_stat.st_size;
+    void *const base = mmap(NULL, new_frozen->size, PROT_READ, MAP_SHARED, descriptor, 0);
+    // Отображение остается действительным и после закрытия дескриптора.
+    close(descriptor);
+    if (base == MAP_FAILED)
+    {
+        free(new_frozen);
+        error_set(_error, 4);
+        return NULL;
+    }
+    new_frozen->base = base;
+#endif
+
+    // Проверяем заголовок: все области должны лежать внутри файла.
+    const c_hash_multiset_frozen_header *const header = (const c_hash_multiset_frozen_header*)new_frozen->base;
+    const uint64_t size = new_frozen->size;
+    const uint64_t pilots_size = round8(header->buckets_count * sizeof(uint32_t));
+    if ( (memcmp(header->magic, "CHMF", 4) != 0) ||
+         (header->version != C_HASH_MULTISET_FROZEN_VERSION) ||
+         (header->byte_order != C_HASH_MULTISET_FROZEN_BYTE_ORDER) ||
+         (header->file_size != size) ||
+         (header->buckets_count == 0) || (header->buckets_count > size / sizeof(uint32_t)) ||
+         (header->table_size == 0) || (header->table_size > size / sizeof(uint64_t)) ||
+         (header->pilots_offset != sizeof(c_hash_multiset_frozen_header)) ||
+         (header->table_offset != header->pilots_offset + pilots_size) ||
+         (header->records_offset != header->table_offset + header->table_size * sizeof(uint64_t)) ||
+         (header->records_offset > size) )
+    {
+        c_hash_multiset_frozen_close(new_frozen);
+        error_set(_error, 5);
+        return NULL;
+    }
+
+    new_frozen->header = header;
+    new_frozen->pilots = (const uint32_t*)(new_frozen->base + header->pilots_offset);
+    new_frozen->table = (const uint64_t*)(new_frozen->base + header->table_offset);
+    new_frozen->records = new_frozen->base + header->records_offset;
+    new_frozen->records_size = size - header->records_offset;
+
+    return new_frozen;
+}
+
+// Закрывает замороженное хэш-мультимножество.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_frozen_close(c_hash_multiset_frozen *const _frozen)
+{
+    if (_frozen == NULL) return -1;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(_frozen->base);
+    CloseHandle(_frozen->mapping);
+    CloseHandle(_frozen->file);
+#else
+    munmap((void*)_frozen->base, _frozen->size);
+#endif
+
+    free(_frozen);
+
+    return 1;
+}
+
+// Ищет запись с заданными данными.
+// Если запись найдена, помещает ее в *_record и возвращает > 0, иначе возвращает 0.
+// В случае ошибки (не удалось сериализовать данные) возвращает < 0.
+static ptrdiff_t frozen_find(const c_hash_multiset_frozen *const _frozen,
+                             const void *const _data,
+                             const c_hash_multiset_frozen_record **const _record)
+{
+    const c_hash_multiset_frozen_header *const header = _frozen->header;
+
+    const uint64_t hash = (uint64_t)_frozen->hash_data(_data);
+    const uint64_t mixed = frozen_mix(hash ^ header->seed);
+    const uint64_t bucket = mul_high(mixed, header->buckets_count);
+    uint64_t offset = _frozen->table[frozen_position(mixed, _frozen->pilots[bucket], header->table_size)];
+
+    // Данные сериализуются, только если нашлась запись с тем же хэшем.
+    uint8_t query_stack[C_HASH_MULTISET_FROZEN_QUERY];
+    uint8_t *query = NULL;
+    size_t query_size = 0;
+
+    ptrdiff_t r_code = 0;
+    while ( (offset != C_HASH_MULTISET_FROZEN_EMPTY) &&
+            (_frozen->records_size >= sizeof(c_hash_multiset_frozen_record)) &&
+            (offset <= _frozen->records_size - sizeof(c_hash_multiset_frozen_record)) )
+    {
+        const c_hash_multiset_frozen_record *const record = (const c_hash_multiset_frozen_record*)(_frozen->records + offset);
+        if (record->hash != hash)
+        {
+            break;
+        }
+
+        if (query == NULL)
+        {
+            query = query_stack;
+            query_size = _frozen->serialize_data(_data, query, C_HASH_MULTISET_FROZEN_QUERY);
+            if ( (query_size != SIZE_MAX) && (query_size > C_HASH_MULTISET_FROZEN_QUERY) )
+            {
+                query = malloc(query_size);
+                if ( (query == NULL) ||
+                     (_frozen->serialize_data(_data, query, query_size) != query_size) )
+                {
+                    query_size = SIZE_MAX;
+                }
+            }
+            if (query_size == SIZE_MAX)
+            {
+                r_code = -1;
+                break;
+            }
+        }
+
+        const uint64_t available = _frozen->records_size - offset - sizeof(c_hash_multiset_frozen_record);
+        if (record->size > available)
+        {
+            break;
+        }
+        if ( (record->size == query_size) && (memcmp(record + 1, query, query_size) == 0) )
+        {
+            *_record = record;
+            r_code = 1;
+            break;
+        }
+        offset += sizeof(c_hash_multiset_frozen_record) + round8(record->size);
+    }
+
+    if (query != query_stack)
+    {
+        free(query);
+    }
+
+    return r_code;
+}
+
+// Проверяет наличие заданных данных в замороженном хэш-мультимножестве.
+// Если данные есть, возвращает > 0.
+// Если данных нет, возвращает 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_frozen_check(const c_hash_multiset_frozen *const _frozen,
+                                       const void *const _data)
+{
+    if (_frozen == NULL) return -1;
+    if (_data == NULL) return -2;
+
+    const c_hash_multiset_frozen_record *record;
+    const ptrdiff_t r_code = frozen_find(_frozen, _data, &record);
+    if (r_code < 0)
+    {
+        return -3;
+    }
+
+    return r_code;
+}
+
+// Возвращает количество заданных данных в замороженном хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+// Так как функция может возвращать 0 и в случае успеха, и в случае ошибки, для детектирования ошибки
+// перед вызовом функции необходимо поместить 0 в заданное расположение ошибки.
+size_t c_hash_multiset_frozen_data_count(const c_hash_multiset_frozen *const _frozen,
+                                         const void *const _data,
+                                         size_t *const _error)
+{
+    if (_frozen == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+    if (_data == NULL)
+    {
+        error_set(_error, 2);
+        return 0;
+    }
+
+    const c_hash_multiset_frozen_record *record;
+    const ptrdiff_t r_code = frozen_find(_frozen, _data, &record);
+    if (r_code < 0)
+    {
+        error_set(_error, 3);
+        return 0;
+    }
+    if (r_code == 0)
+    {
+        return 0;
+    }
+
+    return (size_t)record->count;
+}
+
+// Возвращает количество данных в замороженном хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_frozen_count(const c_hash_multiset_frozen *const _frozen,
+                                    size_t *const _error)
+{
+    if (_frozen == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return (size_t)_frozen->header->nodes_count;
+}
+
+// Возвращает количество уникальных данных в замороженном хэш-мультимножестве.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_frozen_uniques_count(const c_hash_multiset_frozen *const _frozen,
+                                            size_t *const _error)
+{
+    if (_frozen == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return (size_t)_frozen->header->uniques_count;
+}
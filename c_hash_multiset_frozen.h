@@ -0,0 +1,49 @@
+﻿/*
+    Заголовочный файл замороженного хэш-мультимножества c_hash_multiset_frozen
+    c_hash_multiset_freeze() записывает содержимое хэш-мультимножества в файл без указателей:
+    совершенный индекс по хэшам и упакованные записи (данные, количество).
+    c_hash_multiset_frozen_open() отображает файл в память только для чтения и отвечает
+    на check и data_count без десериализации; страницы файла разделяются между процессами.
+
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MULTISET_FROZEN_H
+#define C_HASH_MULTISET_FROZEN_H
+
+#include <stddef.h>
+
+#include "c_hash_multiset.h"
+
+typedef struct s_c_hash_multiset_frozen c_hash_multiset_frozen;
+
+ptrdiff_t c_hash_multiset_freeze(const c_hash_multiset *const _hash_multiset,
+                                 const char *const _path,
+                                 size_t (*const _hash_data)(const void *const _data),
+                                 size_t (*const _serialize_data)(const void *const _data,
+                                                                 void *const _buffer,
+                                                                 const size_t _size));
+
+c_hash_multiset_frozen *c_hash_multiset_frozen_open(const char *const _path,
+                                                    size_t (*const _hash_data)(const void *const _data),
+                                                    size_t (*const _serialize_data)(const void *const _data,
+                                                                                    void *const _buffer,
+                                                                                    const size_t _size),
+                                                    size_t *const _error);
+
+ptrdiff_t c_hash_multiset_frozen_close(c_hash_multiset_frozen *const _frozen);
+
+ptrdiff_t c_hash_multiset_frozen_check(const c_hash_multiset_frozen *const _frozen,
+                                       const void *const _data);
+
+size_t c_hash_multiset_frozen_data_count(const c_hash_multiset_frozen *const _frozen,
+                                         const void *const _data,
+                                         size_t *const _error);
+
+size_t c_hash_multiset_frozen_count(const c_hash_multiset_frozen *const _frozen,
+                                    size_t *const _error);
+
+size_t c_hash_multiset_frozen_uniques_count(const c_hash_multiset_frozen *const _frozen,
+                                            size_t *const _error);
+
+#endif
@@ -0,0 +1,407 @@
+﻿/*
+    Файл реализации встроенных функций хэша и сравнения хэш-мультимножества c_hash_multiset
+    Функции строк и целых чисел можно сразу передавать в c_hash_multiset_create(),
+    c_hash_multiset_hash_bytes() служит основой для функций хэша пользовательских данных.
+
+    Лицензия: GPLv3
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define C_HASH_MULTISET_HASH_SSE2
+#endif
+
+#include "c_hash_multiset_hash.h"
+
+// Размер, начиная с которого данные хэшируются полосами по 64 байта в восемь независимых
+// накопителей (с SSE2 - по два накопителя на команду).
+#define C_HASH_MULTISET_HASH_LONG ( (size_t) 256 )
+
+// Размер полосы.
+#define C_HASH_MULTISET_HASH_STRIPE ( (size_t) 64 )
+
+// Количество полос между перемешиваниями накопителей.
+#define C_HASH_MULTISET_HASH_STRIPES ( (size_t) 16 )
+
+// 32-битный множитель перемешивания накопителей.
+#define C_HASH_MULTISET_HASH_PRIME32 ( UINT32_C(0x9E3779B1) )
+
+// Константы основного алгоритма (семейство wyhash).
+static const uint64_t secret[4] =
+{
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)
+};
+
+// Константы накопителей длинных данных (семейство xxh3).
+static const uint64_t secret_long[8] =
+{
+    UINT64_C(0x9E3779B97F4A7C15), UINT64_C(0xC2B2AE3D27D4EB4F),
+    UINT64_C(0x165667B19E3779F9), UINT64_C(0x85EBCA77C2B2AE63),
+    UINT64_C(0x27D4EB2F165667C5), UINT64_C(0xA0761D6478BD642F),
+    UINT64_C(0xE7037ED1A0B428DB), UINT64_C(0x8EBC6AF09C88C6E3)
+};
+
+// Перемножает 64-битные числа, в *_a помещается младшая половина произведения, в *_b - старшая.
+static void mum(uint64_t *const _a,
+                uint64_t *const _b)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = (unsigned __int128)*_a * *_b;
+    *_a = (uint64_t)r;
+    *_b = (uint64_t)(r >> 64);
+#else
+    const uint64_t a_lo = (uint32_t)*_a,
+                   a_hi = *_a >> 32,
+                   b_lo = (uint32_t)*_b,
+                   b_hi = *_b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo,
+                   hi_lo = a_hi * b_lo,
+                   lo_hi = a_lo * b_hi,
+                   hi_hi = a_hi * b_hi;
+    const uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+    *_a = (cross << 32) | (uint32_t)lo_lo;
+    *_b = hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+// Перемешивает два числа: xor половин их 128-битного произведения.
+static uint64_t mix(uint64_t _a,
+                    uint64_t _b)
+{
+    mum(&_a, &_b);
+    return _a ^ _b;
+}
+
+// Читает 8 байт (little-endian на little-endian платформах, как и весь алгоритм).
+static uint64_t read8(const uint8_t *const _p)
+{
+    uint64_t v;
+    memcpy(&v, _p, sizeof(v));
+    return v;
+}
+
+// Читает 4 байта.
+static uint64_t read4(const uint8_t *const _p)
+{
+    uint32_t v;
+    memcpy(&v, _p, sizeof(v));
+    return v;
+}
+
+// Читает от 1 до 3 байт.
+static uint64_t read3(const uint8_t *const _p,
+                      const size_t _size)
+{
+    return ( (uint64_t)_p[0] << 16 ) | ( (uint64_t)_p[_size >> 1] << 8 ) | _p[_size - 1];
+}
+
+// Накапливает полосы длинных данных, возвращает количество обработанных байт.
+// Векторный и скалярный варианты дают одинаковый результат.
+static size_t accumulate(uint64_t *const _acc,
+                         const uint8_t *const _p,
+                         const size_t _size)
+{
+    const size_t stripes_count = _size / C_HASH_MULTISET_HASH_STRIPE;
+
+#if defined(C_HASH_MULTISET_HASH_SSE2)
+    __m128i acc[4],
+            key[4];
+    for (size_t v = 0; v < 4; ++v)
+    {
+        acc[v] = _mm_loadu_si128((const __m128i*)(_acc + 2 * v));
+        key[v] = _mm_loadu_si128((const __m128i*)(secret_long + 2 * v));
+    }
+    const __m128i prime = _mm_set1_epi32((int)C_HASH_MULTISET_HASH_PRIME32);
+
+    for (size_t s = 0; s < stripes_count; ++s)
+    {
+        const uint8_t *const stripe = _p + s * C_HASH_MULTISET_HASH_STRIPE;
+        for (size_t v = 0; v < 4; ++v)
+        {
+            const __m128i data = _mm_loadu_si128((const __m128i*)(stripe + 16 * v));
+            const __m128i data_key = _mm_xor_si128(data, key[v]);
+            const __m128i product = _mm_mul_epu32(data_key, _mm_srli_epi64(data_key, 32));
+            // Данные соседнего накопителя сохраняют вклад каждого байта без потерь.
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[v] = _mm_add_epi64(acc[v], _mm_add_epi64(product, swapped));
+        }
+
+        if ( (s + 1) % C_HASH_MULTISET_HASH_STRIPES == 0 )
+        {
+            for (size_t v = 0; v < 4; ++v)
+            {
+                __m128i a = _mm_xor_si128(acc[v], _mm_srli_epi64(acc[v], 47));
+                a = _mm_xor_si128(a, key[v]);
+                const __m128i product_lo = _mm_mul_epu32(a, prime);
+                const __m128i product_hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+                acc[v] = _mm_add_epi64(product_lo, _mm_slli_epi64(product_hi, 32));
+            }
+        }
+    }
+
+    for (size_t v = 0; v < 4; ++v)
+    {
+        _mm_storeu_si128((__m128i*)(_acc + 2 * v), acc[v]);
+    }
+#else
+    for (size_t s = 0; s < stripes_count; ++s)
+    {
+        const uint8_t *const stripe = _p + s * C_HASH_MULTISET_HASH_STRIPE;
+        for (size_t l = 0; l < 8; ++l)
+        {
+            const uint64_t data = read8(stripe + 8 * l);
+            const uint64_t data_key = data ^ secret_long[l];
+            _acc[l] += (uint64_t)(uint32_t)data_key * (data_key >> 32);
+            _acc[l ^ 1] += data;
+        }
+
+        if ( (s + 1) % C_HASH_MULTISET_HASH_STRIPES == 0 )
+        {
+            for (size_t l = 0; l < 8; ++l)
+            {
+                uint64_t a = _acc[l] ^ (_acc[l] >> 47);
+                a ^= secret_long[l];
+                _acc[l] = a * C_HASH_MULTISET_HASH_PRIME32;
+            }
+        }
+    }
+#endif
+
+    return stripes_count * C_HASH_MULTISET_HASH_STRIPE;
+}
+
+// Возвращает 64-битный хэш блока байт заданного размера (алгоритм семейства wyhash, длинные
+// данные предварительно накапливаются полосами, как в xxh3).
+// Основа для функций хэша пользовательских данных: например, для структуры с полем-буфером
+// функция хэша может вернуть c_hash_multiset_hash_bytes(buffer, size, 0).
+// Результат зависит только от байт, размера и _seed (одинаков с SSE2 и без).
+uint64_t c_hash_multiset_hash_bytes(const void *const _bytes,
+                                    const size_t _size,
+                                    const uint64_t _seed)
+{
+    const uint8_t *p = _bytes;
+    uint64_t seed = _seed ^ mix(_seed ^ secret[0], secret[1]),
+             a,
+             b;
+
+    if (_size <= 16)
+    {
+        if (_size >= 4)
+        {
+            a = (read4(p) << 32) | read4(p + ((_size >> 3) << 2));
+            b = (read4(p + _size - 4) << 32) | read4(p + _size - 4 - ((_size >> 3) << 2));
+        } else if (_size > 0) {
+            a = read3(p, _size);
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t i = _size;
+
+        if (_size >= C_HASH_MULTISET_HASH_LONG)
+        {
+            uint64_t acc[8];
+            for (size_t l = 0; l < 8; ++l)
+            {
+                acc[l] = secret_long[l] ^ seed;
+            }
+
+            const size_t done = accumulate(acc, p, _size);
+            p += done;
+            i -= done;
+
+            for (size_t l = 0; l < 8; l += 2)
+            {
+                seed ^= mix(acc[l] ^ secret_long[l], acc[l + 1] ^ secret_long[l + 1]);
+            }
+        } else if (i > 48) {
+            // Три независимые цепочки умножений выполняются процессором параллельно.
+            uint64_t seed_1 = seed,
+                     seed_2 = seed;
+            do
+            {
+                seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+                seed_1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ seed_1);
+                seed_2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ seed_2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed_1 ^ seed_2;
+        }
+
+        while (i > 16)
+        {
+            seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        // Последние 16 байт читаются всегда (частично повторно), данных не меньше 17 байт.
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    mum(&a, &b);
+
+    return mix(a ^ secret[0] ^ _size, b ^ secret[1]);
+}
+
+// Функция хэша строк, оканчивающихся нулем.
+size_t c_hash_multiset_hash_string(const void *const _data)
+{
+    if (_data == NULL) return 0;
+
+    return (size_t)c_hash_multiset_hash_bytes(_data, strlen((const char*)_data), 0);
+}
+
+// Функция хэша 32-битных беззнаковых целых (данные - указатель на число).
+size_t c_hash_multiset_hash_u32(const void *const _data)
+{
+    if (_data == NULL) return 0;
+
+    const uint64_t value = *(const uint32_t*)_data;
+    return (size_t)mix(value ^ secret[0], value ^ secret[1]);
+}
+
+// Функция хэша 64-битных беззнаковых целых (данные - указатель на число).
+size_t c_hash_multiset_hash_u64(const void *const _data)
+{
+    if (_data == NULL) return 0;
+
+    const uint64_t value = *(const uint64_t*)_data;
+    return (size_t)mix(value ^ secret[0], value ^ secret[1]);
+}
+
+// Функция сравнения строк, оканчивающихся нулем.
+size_t c_hash_multiset_comp_string(const void *const _data_a,
+                                   const void *const _data_b)
+{
+    if ( (_data_a == NULL) || (_data_b == NULL) ) return 0;
+
+    return strcmp((const char*)_data_a, (const char*)_data_b) == 0;
+}
+
+// Функция сравнения 32-битных беззнаковых целых.
+size_t c_hash_multiset_comp_u32(const void *const _data_a,
+                                const void *const _data_b)
+{
+    if ( (_data_a == NULL) || (_data_b == NULL) ) return 0;
+
+    return *(const uint32_t*)_data_a == *(const uint32_t*)_data_b;
+}
+
+// Функция сравнения 64-битных беззнаковых целых.
+size_t c_hash_multiset_comp_u64(const void *const _data_a,
+                                const void *const _data_b)
+{
+    if ( (_data_a == NULL) || (_data_b == NULL) ) return 0;
+
+    return *(const uint64_t*)_data_a == *(const uint64_t*)_data_b;
+}
+
+// Сравнение хэшей для сортировки.
+static int hash_order(const void *const _a,
+                      const void *const _b)
+{
+    const size_t a = *(const size_t*)_a,
+                 b = *(const size_t*)_b;
+    return (a > b) - (a < b);
+}
+
+// Проверяет, насколько равномерно функция хэша распределяет _count различных данных массива _data
+// по _slots_count слотам (номер слота - остаток от деления хэша, как у политики роста по умолчанию;
+// для проверки младших бит задайте количество слотов степенью двойки).
+// Результат помещается в _report.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_hash_quality(size_t (*const _hash_data)(const void *const _data),
+                                       const void *const *const _data,
+                                       const size_t _count,
+                                       const size_t _slots_count,
+                                       c_hash_multiset_hash_report *const _report)
+{
+    if (_hash_data == NULL) return -1;
+    if ( (_data == NULL) && (_count > 0) ) return -2;
+    if (_slots_count == 0) return -3;
+    if (_report == NULL) return -4;
+
+    if ( (_count > SIZE_MAX / sizeof(size_t)) || (_slots_count > SIZE_MAX / sizeof(size_t)) )
+    {
+        return -5;
+    }
+
+    size_t *const hashes = malloc( (_count > 0 ? _count : 1) * sizeof(size_t) );
+    if (hashes == NULL)
+    {
+        return -5;
+    }
+    size_t *const slots = calloc(_slots_count, sizeof(size_t));
+    if (slots == NULL)
+    {
+        free(hashes);
+        return -5;
+    }
+
+    for (size_t i = 0; i < _count; ++i)
+    {
+        hashes[i] = _hash_data(_data[i]);
+        ++slots[hashes[i] % _slots_count];
+    }
+
+    _report->keys_count = _count;
+    _report->slots_count = _slots_count;
+    _report->empty_slots = 0;
+    _report->max_slot_keys = 0;
+
+    // Хи-квадрат относительно равномерного распределения.
+    const double expected = (double)_count / _slots_count;
+    double chi_squared = 0.0;
+    for (size_t s = 0; s < _slots_count; ++s)
+    {
+        if (slots[s] == 0)
+        {
+            ++_report->empty_slots;
+        }
+        if (slots[s] > _report->max_slot_keys)
+        {
+            _report->max_slot_keys = slots[s];
+        }
+        const double deviation = slots[s] - expected;
+        chi_squared += deviation * deviation;
+    }
+    chi_squared = (expected > 0.0) ? chi_squared / expected : 0.0;
+
+    _report->chi_squared = chi_squared;
+    if (_slots_count > 1)
+    {
+        const double freedom = (double)(_slots_count - 1);
+        _report->score = (chi_squared - freedom) / sqrt(2.0 * freedom);
+    } else {
+        _report->score = 0.0;
+    }
+
+    // Совпадения полных хэшей находятся сортировкой.
+    qsort(hashes, _count, sizeof(size_t), hash_order);
+    _report->hash_collisions = 0;
+    for (size_t i = 1; i < _count; ++i)
+    {
+        if (hashes[i] == hashes[i - 1])
+        {
+            ++_report->hash_collisions;
+        }
+    }
+
+    free(slots);
+    free(hashes);
+
+    return 1;
+}
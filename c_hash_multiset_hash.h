@@ -0,0 +1,58 @@
+﻿/*
+    Заголовочный файл встроенных функций хэша и сравнения хэш-мультимножества c_hash_multiset
+    Функции строк и целых чисел можно сразу передавать в c_hash_multiset_create(),
+    c_hash_multiset_hash_bytes() служит основой для функций хэша пользовательских данных.
+
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MULTISET_HASH_H
+#define C_HASH_MULTISET_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Результат проверки качества функции хэша (c_hash_multiset_hash_quality()).
+typedef struct s_c_hash_multiset_hash_report
+{
+    // Количество ключей и слотов, по которым они распределялись.
+    size_t keys_count,
+           slots_count;
+    // Количество пустых слотов и наибольшее количество ключей в одном слоте.
+    size_t empty_slots,
+           max_slot_keys;
+    // Количество ключей, полный хэш которых совпал с хэшем другого ключа.
+    size_t hash_collisions;
+    // Статистика хи-квадрат заполнения слотов и ее отклонение от ожидаемой для идеальной
+    // функции хэша в стандартных отклонениях (|score| < 3 - распределение неотличимо от случайного,
+    // большие положительные значения - ключи скучиваются).
+    double chi_squared,
+           score;
+} c_hash_multiset_hash_report;
+
+uint64_t c_hash_multiset_hash_bytes(const void *const _bytes,
+                                    const size_t _size,
+                                    const uint64_t _seed);
+
+size_t c_hash_multiset_hash_string(const void *const _data);
+
+size_t c_hash_multiset_hash_u32(const void *const _data);
+
+size_t c_hash_multiset_hash_u64(const void *const _data);
+
+size_t c_hash_multiset_comp_string(const void *const _data_a,
+                                   const void *const _data_b);
+
+size_t c_hash_multiset_comp_u32(const void *const _data_a,
+                                const void *const _data_b);
+
+size_t c_hash_multiset_comp_u64(const void *const _data_a,
+                                const void *const _data_b);
+
+ptrdiff_t c_hash_multiset_hash_quality(size_t (*const _hash_data)(const void *const _data),
+                                       const void *const *const _data,
+                                       const size_t _count,
+                                       const size_t _slots_count,
+                                       c_hash_multiset_hash_report *const _report);
+
+#endif
@@ -0,0 +1,184 @@
+﻿/*
+    Файл реализации шардированного хэш-мультимножества c_hash_multiset_sharded
+    Каждый поток заполняет свой шард (обычное хэш-мультимножество) без блокировок,
+    затем шарды сливаются в один параллельно по диапазонам слотов.
+
+    Лицензия: GPLv3
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "c_hash_multiset_sharded.h"
+
+struct s_c_hash_multiset_sharded
+{
+    size_t shards_count;
+    c_hash_multiset **shards;
+};
+
+// Если расположение задано, в него помещается код.
+static void error_set(size_t *const _error,
+                      const size_t _code)
+{
+    if (_error != NULL)
+    {
+        *_error = _code;
+    }
+}
+
+// Создает шардированное хэш-мультимножество из _shards_count шардов с одинаковыми параметрами
+// (_options может быть NULL).
+// Распределитель с release не допускается: блоки шардов при слиянии переходят к другому шарду;
+// плоский движок и хранение повторов массивом не допускаются: слияние переносит цепочки
+// с узлами (см. c_hash_multiset_merge()).
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0): коды 1-11 - ошибка создания шарда (как у c_hash_multiset_create_ex()),
+// 12 - нет шардов, 13 - распределитель с release, 14 - ошибка выделения памяти,
+// 15 - движок, отличный от цепочного, или хранение повторов массивом.
+c_hash_multiset_sharded *c_hash_multiset_sharded_create(size_t (*const _hash_data)(const void *const _data),
+                                                        size_t (*const _comp_data)(const void *const _data_a,
+                                                                                   const void *const _data_b),
+                                                        const size_t _shards_count,
+                                                        const size_t _slots_count,
+                                                        const float _max_load_factor,
+                                                        const c_hash_multiset_options *const _options,
+                                                        size_t *const _error)
+{
+    if (_shards_count == 0)
+    {
+        error_set(_error, 12);
+        return NULL;
+    }
+    if ( (_options != NULL) && (_options->allocator != NULL) && (_options->allocator->release != NULL) )
+    {
+        error_set(_error, 13);
+        return NULL;
+    }
+    if ( (_options != NULL) &&
+         ( (_options->engine != C_HASH_MULTISET_ENGINE_CHAINED) ||
+           (_options->storage != C_HASH_MULTISET_STORAGE_NODES) ) )
+    {
+        error_set(_error, 15);
+        return NULL;
+    }
+    if (_shards_count > SIZE_MAX / sizeof(c_hash_multiset*))
+    {
+        error_set(_error, 14);
+        return NULL;
+    }
+
+    c_hash_multiset_sharded *const new_hash_multiset_sharded = malloc(sizeof(c_hash_multiset_sharded));
+    if (new_hash_multiset_sharded == NULL)
+    {
+        error_set(_error, 14);
+        return NULL;
+    }
+
+    c_hash_multiset **const new_shards = malloc(_shards_count * sizeof(c_hash_multiset*));
+    if (new_shards == NULL)
+    {
+        free(new_hash_multiset_sharded);
+        error_set(_error, 14);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < _shards_count; ++i)
+    {
+        new_shards[i] = c_hash_multiset_create_ex(_hash_data, _comp_data, _slots_count, _max_load_factor,
+                                                  _options, _error);
+        if (new_shards[i] == NULL)
+        {
+            while (i > 0)
+            {
+                c_hash_multiset_delete(new_shards[--i], NULL);
+            }
+            free(new_shards);
+            free(new_hash_multiset_sharded);
+            return NULL;
+        }
+    }
+
+    new_hash_multiset_sharded->shards_count = _shards_count;
+    new_hash_multiset_sharded->shards = new_shards;
+
+    return new_hash_multiset_sharded;
+}
+
+// Удаляет шардированное хэш-мультимножество вместе со всеми шардами.
+// В случае успеха возвращает > 0.
+// В случае ошибки возвращает < 0.
+ptrdiff_t c_hash_multiset_sharded_delete(c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                         void (*const _del_data)(void *const _data))
+{
+    if (_hash_multiset_sharded == NULL) return -1;
+
+    for (size_t i = 0; i < _hash_multiset_sharded->shards_count; ++i)
+    {
+        c_hash_multiset_delete(_hash_multiset_sharded->shards[i], _del_data);
+    }
+
+    free(_hash_multiset_sharded->shards);
+    free(_hash_multiset_sharded);
+
+    return 1;
+}
+
+// Возвращает шард с заданным номером.
+// Шард - обычное хэш-мультимножество, которое одновременно должен использовать только один поток
+// (как правило, поток с номером _index).
+// В случае ошибки возвращает NULL.
+c_hash_multiset *c_hash_multiset_sharded_shard(const c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                               const size_t _index)
+{
+    if (_hash_multiset_sharded == NULL) return NULL;
+    if (_index >= _hash_multiset_sharded->shards_count) return NULL;
+
+    return _hash_multiset_sharded->shards[_index];
+}
+
+// Возвращает количество шардов.
+// В случае ошибки возвращает 0, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0).
+size_t c_hash_multiset_sharded_shards_count(const c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                            size_t *const _error)
+{
+    if (_hash_multiset_sharded == NULL)
+    {
+        error_set(_error, 1);
+        return 0;
+    }
+
+    return _hash_multiset_sharded->shards_count;
+}
+
+// Сливает все шарды в шард 0 (c_hash_multiset_merge(), не более _threads_count потоков)
+// и возвращает его. Остальные шарды становятся пустыми и могут заполняться снова.
+// На время слияния шарды не должны использоваться другими потоками.
+// В случае ошибки возвращает NULL, и если _error != NULL, в заданное расположение помещается
+// код причины ошибки (> 0): 1 - шардированное хэш-мультимножество не задано, 2 - ошибка слияния
+// (данные уже слитых шардов остаются в шарде 0, данные остальных - в них самих; шард 0 и шард,
+// на котором слияние прервалось, могут быть перестроены, см. c_hash_multiset_merge()).
+c_hash_multiset *c_hash_multiset_sharded_merge(c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                               const size_t _threads_count,
+                                               size_t *const _error)
+{
+    if (_hash_multiset_sharded == NULL)
+    {
+        error_set(_error, 1);
+        return NULL;
+    }
+
+    c_hash_multiset *const destination = _hash_multiset_sharded->shards[0];
+
+    for (size_t i = 1; i < _hash_multiset_sharded->shards_count; ++i)
+    {
+        if (c_hash_multiset_merge(destination, _hash_multiset_sharded->shards[i], _threads_count) < 0)
+        {
+            error_set(_error, 2);
+            return NULL;
+        }
+    }
+
+    return destination;
+}
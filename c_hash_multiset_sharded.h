@@ -0,0 +1,40 @@
+﻿/*
+    Заголовочный файл шардированного хэш-мультимножества c_hash_multiset_sharded
+    Каждый поток заполняет свой шард (обычное хэш-мультимножество) без блокировок,
+    затем шарды сливаются в один параллельно по диапазонам слотов.
+
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MULTISET_SHARDED_H
+#define C_HASH_MULTISET_SHARDED_H
+
+#include <stddef.h>
+
+#include "c_hash_multiset.h"
+
+typedef struct s_c_hash_multiset_sharded c_hash_multiset_sharded;
+
+c_hash_multiset_sharded *c_hash_multiset_sharded_create(size_t (*const _hash_data)(const void *const _data),
+                                                        size_t (*const _comp_data)(const void *const _data_a,
+                                                                                   const void *const _data_b),
+                                                        const size_t _shards_count,
+                                                        const size_t _slots_count,
+                                                        const float _max_load_factor,
+                                                        const c_hash_multiset_options *const _options,
+                                                        size_t *const _error);
+
+ptrdiff_t c_hash_multiset_sharded_delete(c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                         void (*const _del_data)(void *const _data));
+
+c_hash_multiset *c_hash_multiset_sharded_shard(const c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                               const size_t _index);
+
+size_t c_hash_multiset_sharded_shards_count(const c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                            size_t *const _error);
+
+c_hash_multiset *c_hash_multiset_sharded_merge(c_hash_multiset_sharded *const _hash_multiset_sharded,
+                                               const size_t _threads_count,
+                                               size_t *const _error);
+
+#endif
@@ -0,0 +1,205 @@
+﻿/*
+    Тест хэш-мультимножества c_hash_multiset
+    Проверяет сценарии, в которых ошибка не видна по кодам возврата: положение файла после
+    загрузки снимка и т.п. Каждая проверка - отдельная функция test_*().
+
+    Сборка (пример):
+    cc -O2 c_hash_multiset_test.c c_hash_multiset.c -lpthread -lm -o test
+
+    Проверка санитайзерами:
+    cc -g -fsanitize=address,undefined c_hash_multiset_test.c c_hash_multiset.c -lpthread -lm
+
+    Запуск:
+    test
+    Возвращает 0, если проверки пройдены.
+
+    Лицензия: GPLv3
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "c_hash_multiset.h"
+
+static size_t failures;
+
+// Проверяет условие и регистрирует проваленную проверку.
+#define TEST_CHECK(_condition)\
+    do\
+    {\
+        if (!(_condition))\
+        {\
+            fprintf(stderr, "FAIL: %s (%s:%d)\n", #_condition, __FILE__, __LINE__);\
+            ++failures;\
+        }\
+    } while (0)
+
+// Функция хэша ключа uint64_t.
+static size_t hash_key(const void *const _data)
+{
+    uint64_t x = *(const uint64_t*)_data;
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+// Функция сравнения ключей uint64_t.
+static size_t comp_key(const void *const _data_a,
+                       const void *const _data_b)
+{
+    return *(const uint64_t*)_data_a == *(const uint64_t*)_data_b;
+}
+
+// Функция хэша ключа uint64_t, у которой соседние ключи совпадают по хэшу.
+static size_t hash_key_pair(const void *const _data)
+{
+    uint64_t x = *(const uint64_t*)_data >> 1;
+    return hash_key(&x);
+}
+
+// Создает ключ в динамической памяти.
+static uint64_t *key_new(const uint64_t _value)
+{
+    uint64_t *const key = malloc(sizeof(uint64_t));
+    if (key != NULL)
+    {
+        *key = _value;
+    }
+    return key;
+}
+
+// Удаляет ключ, созданный key_new().
+static void key_delete(void *const _data)
+{
+    free(_data);
+}
+
+// Сериализует ключ.
+static size_t key_serialize(const void *const _data,
+                            void *const _buffer,
+                            const size_t _size)
+{
+    if (_size >= sizeof(uint64_t))
+    {
+        memcpy(_buffer, _data, sizeof(uint64_t));
+    }
+    return sizeof(uint64_t);
+}
+
+// Создает ключ из представления.
+static void *key_deserialize(const void *const _buffer,
+                             const size_t _size)
+{
+    if (_size != sizeof(uint64_t)) return NULL;
+    uint64_t value;
+    memcpy(&value, _buffer, sizeof(uint64_t));
+    return key_new(value);
+}
+
+// Снимок, за которым в файле следуют другие данные: после загрузки файл стоит сразу за снимком.
+static void test_snapshot_sentinel(void)
+{
+    static const char sentinel[] = "SENTINEL";
+
+    c_hash_multiset *const hash_multiset = c_hash_multiset_create(hash_key, comp_key, 0, 0.75f, NULL);
+    TEST_CHECK(hash_multiset != NULL);
+    if (hash_multiset == NULL) return;
+
+    // Снимок больше буфера потока, повторы у части ключей.
+    for (uint64_t k = 0; k < 5000; ++k)
+    {
+        for (uint64_t r = 0; r <= k % 3; ++r)
+        {
+            TEST_CHECK(c_hash_multiset_insert(hash_multiset, key_new(k)) > 0);
+        }
+    }
+
+    FILE *const file = tmpfile();
+    TEST_CHECK(file != NULL);
+    if (file != NULL)
+    {
+        TEST_CHECK(c_hash_multiset_save(hash_multiset, file, key_serialize) > 0);
+        TEST_CHECK(fwrite(sentinel, 1, sizeof(sentinel), file) == sizeof(sentinel));
+        rewind(file);
+
+        size_t error = 0;
+        c_hash_multiset *const loaded = c_hash_multiset_load(file, hash_key, comp_key, key_deserialize,
+                                                             key_delete, NULL, &error);
+        TEST_CHECK( (loaded != NULL) && (error == 0) );
+        if (loaded != NULL)
+        {
+            TEST_CHECK(c_hash_multiset_count(loaded, NULL) == c_hash_multiset_count(hash_multiset, NULL));
+            c_hash_multiset_delete(loaded, key_delete);
+        }
+
+        char buffer[sizeof(sentinel)] = {0};
+        TEST_CHECK(fread(buffer, 1, sizeof(buffer), file) == sizeof(buffer));
+        TEST_CHECK(memcmp(buffer, sentinel, sizeof(sentinel)) == 0);
+
+        fclose(file);
+    }
+
+    c_hash_multiset_delete(hash_multiset, key_delete);
+}
+
+// Удаление через ячейку, найденную по самим хранимым данным, с освобождающей _del_data,
+// ниже min_load_factor: после сжатия место вставки ищется без сравнения удаленных данных
+// (хэш совпадает у пар ключей, так что сравнение с оставшимся ключом пары было бы вызвано).
+static void test_entry_erase_shrink(const size_t _engine)
+{
+    enum { KEYS_COUNT = 4000, KEYS_LEFT = 100 };
+
+    c_hash_multiset_options options;
+    c_hash_multiset_options_init(&options);
+    options.engine = _engine;
+    options.min_load_factor = 0.2f;
+
+    c_hash_multiset *const hash_multiset = c_hash_multiset_create_ex(hash_key_pair, comp_key, 0, 0.75f,
+                                                                     &options, NULL);
+    TEST_CHECK(hash_multiset != NULL);
+    if (hash_multiset == NULL) return;
+
+    static uint64_t *keys[KEYS_COUNT];
+    for (size_t k = 0; k < KEYS_COUNT; ++k)
+    {
+        keys[k] = key_new(k);
+        TEST_CHECK(c_hash_multiset_insert(hash_multiset, keys[k]) > 0);
+    }
+    const size_t slots_count = c_hash_multiset_slots_count(hash_multiset, NULL);
+
+    c_hash_multiset_entry entry;
+    for (size_t k = 0; k < KEYS_COUNT - KEYS_LEFT; ++k)
+    {
+        TEST_CHECK(c_hash_multiset_entry_find(hash_multiset, keys[k], &entry) > 0);
+        TEST_CHECK(c_hash_multiset_entry_erase(hash_multiset, &entry, key_delete) > 0);
+        TEST_CHECK(c_hash_multiset_entry_count(&entry) == 0);
+    }
+
+    TEST_CHECK(c_hash_multiset_slots_count(hash_multiset, NULL) < slots_count);
+    TEST_CHECK(c_hash_multiset_uniques_count(hash_multiset, NULL) == KEYS_LEFT);
+    for (size_t k = KEYS_COUNT - KEYS_LEFT; k < KEYS_COUNT; ++k)
+    {
+        TEST_CHECK(c_hash_multiset_check(hash_multiset, keys[k]) == 1);
+    }
+
+    // Ячейка после последнего удаления остается пригодной для вставки.
+    uint64_t *const key = key_new(KEYS_COUNT - KEYS_LEFT - 1);
+    TEST_CHECK(c_hash_multiset_entry_insert(hash_multiset, &entry, key) > 0);
+    TEST_CHECK(c_hash_multiset_check(hash_multiset, key) == 1);
+
+    c_hash_multiset_delete(hash_multiset, key_delete);
+}
+
+int main(void)
+{
+    test_snapshot_sentinel();
+    test_entry_erase_shrink(C_HASH_MULTISET_ENGINE_CHAINED);
+    test_entry_erase_shrink(C_HASH_MULTISET_ENGINE_FLAT);
+
+    printf("%s\n", (failures == 0) ? "OK" : "FAILED");
+
+    return (failures == 0) ? 0 : 1;
+}
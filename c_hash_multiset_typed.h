@@ -0,0 +1,370 @@
+﻿/*
+    Заголовочный файл типизированных хэш-мультимножеств c_hash_multiset_typed
+    C_HASH_MULTISET_DEFINE(name, key_type, hash_expr, eq_expr) порождает в единице трансляции
+    хэш-мультимножество ключей key_type с тем же набором функций, что и у c_hash_multiset
+    (name_create(), name_insert(), name_erase(), name_check(), ...), но с типизированными
+    сигнатурами: hash_expr(ключ) и eq_expr(ключ_а, ключ_б) подставляются на этапе компиляции
+    (функции или макросы), косвенных вызовов при поиске нет.
+
+    Пример:
+    static size_t u64_hash(const uint64_t _key) { return (size_t)(_key ^ (_key >> 29)); }
+    #define U64_EQ(_a, _b) ( (_a) == (_b) )
+    C_HASH_MULTISET_DEFINE(u64_multiset, uint64_t, u64_hash, U64_EQ)
+
+    Лицензия: GPLv3
+*/
+
+#ifndef C_HASH_MULTISET_TYPED_H
+#define C_HASH_MULTISET_TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Количество слотов, размещаемых при первой вставке в типизированное хэш-мультимножество.
+#define C_HASH_MULTISET_TYPED_0 ( (size_t) 16 )
+
+// Допустимые значения max_load_factor типизированного хэш-мультимножества
+// (открытая адресация требует свободных позиций).
+#define C_HASH_MULTISET_TYPED_MLF_MIN ( (float) 0.1f )
+#define C_HASH_MULTISET_TYPED_MLF_MAX ( (float) 0.9f )
+
+// Порождает типизированное хэш-мультимножество name.
+// Ключи хранятся по значению прямо в таблице с открытой адресацией (линейное пробирование,
+// номер позиции - старшие биты произведения хэша на константу Фибоначчи, количество слотов -
+// степень двойки), удаление сдвигает следующие записи назад, поэтому удаленных позиций нет.
+// Каждые уникальные (по eq_expr) ключи хранятся одной записью с количеством повторов:
+// name_for_each() передает действию представителя (первый вставленный ключ) столько раз,
+// сколько у него повторов. Память выделяется malloc/free.
+// Коды ошибок совпадают с кодами соответствующих функций c_hash_multiset.
+#define C_HASH_MULTISET_DEFINE(name, key_type, hash_expr, eq_expr)\
+\
+typedef struct s_##name##_entry\
+{\
+    size_t hash,\
+           count;\
+    key_type key;\
+} name##_entry;\
+\
+typedef struct s_##name\
+{\
+    name##_entry *entries;\
+    size_t slots_count,\
+           nodes_count,\
+           uniques_count,\
+           shift;\
+    float max_load_factor;\
+} name;\
+\
+static inline size_t name##_home(const name *const _hash_multiset,\
+                                 const size_t _hash)\
+{\
+    return (size_t)( ((uint64_t)_hash * UINT64_C(0x9E3779B97F4A7C15)) >> _hash_multiset->shift );\
+}\
+\
+static inline size_t name##_find(const name *const _hash_multiset,\
+                                 const key_type *const _key,\
+                                 const size_t _hash)\
+{\
+    if (_hash_multiset->slots_count == 0) return SIZE_MAX;\
+    const size_t mask = _hash_multiset->slots_count - 1;\
+    for (size_t e = name##_home(_hash_multiset, _hash); ; e = (e + 1) & mask)\
+    {\
+        const name##_entry *const select_entry = &_hash_multiset->entries[e];\
+        if (select_entry->count == 0) return SIZE_MAX;\
+        if ( (select_entry->hash == _hash) && (eq_expr(select_entry->key, (*_key))) ) return e;\
+    }\
+}\
+\
+static inline ptrdiff_t name##_rehash(name *const _hash_multiset,\
+                                      const size_t _slots_count)\
+{\
+    if (_slots_count > SIZE_MAX / sizeof(name##_entry)) return -1;\
+    name##_entry *const new_entries = malloc(_slots_count * sizeof(name##_entry));\
+    if (new_entries == NULL) return -2;\
+    memset(new_entries, 0, _slots_count * sizeof(name##_entry));\
+\
+    name##_entry *const old_entries = _hash_multiset->entries;\
+    const size_t old_slots_count = _hash_multiset->slots_count;\
+\
+    size_t bits = 0;\
+    while (((size_t)1 << bits) < _slots_count) ++bits;\
+    _hash_multiset->entries = new_entries;\
+    _hash_multiset->slots_count = _slots_count;\
+    _hash_multiset->shift = 64 - bits;\
+\
+    const size_t mask = _slots_count - 1;\
+    for (size_t o = 0; o < old_slots_count; ++o)\
+    {\
+        if (old_entries[o].count == 0) continue;\
+        size_t e = name##_home(_hash_multiset, old_entries[o].hash);\
+        while (new_entries[e].count != 0) e = (e + 1) & mask;\
+        new_entries[e] = old_entries[o];\
+    }\
+\
+    free(old_entries);\
+    return 1;\
+}\
+\
+static inline name *name##_create(const size_t _slots_count,\
+                                  const float _max_load_factor,\
+                                  size_t *const _error)\
+{\
+    if ( !(_max_load_factor >= C_HASH_MULTISET_TYPED_MLF_MIN) ||\
+         (_max_load_factor > C_HASH_MULTISET_TYPED_MLF_MAX) )\
+    {\
+        if (_error != NULL) *_error = 3;\
+        return NULL;\
+    }\
+    size_t slots_count = 0;\
+    if (_slots_count > 0)\
+    {\
+        slots_count = C_HASH_MULTISET_TYPED_0;\
+        while (slots_count < _slots_count)\
+        {\
+            if (slots_count > SIZE_MAX / 2)\
+            {\
+                if (_error != NULL) *_error = 4;\
+                return NULL;\
+            }\
+            slots_count *= 2;\
+        }\
+    }\
+\
+    name *const new_hash_multiset = malloc(sizeof(name));\
+    if (new_hash_multiset == NULL)\
+    {\
+        if (_error != NULL) *_error = 6;\
+        return NULL;\
+    }\
+    new_hash_multiset->entries = NULL;\
+    new_hash_multiset->slots_count = 0;\
+    new_hash_multiset->nodes_count = 0;\
+    new_hash_multiset->uniques_count = 0;\
+    new_hash_multiset->shift = 64;\
+    new_hash_multiset->max_load_factor = _max_load_factor;\
+\
+    if ( (slots_count > 0) && (name##_rehash(new_hash_multiset, slots_count) < 0) )\
+    {\
+        free(new_hash_multiset);\
+        if (_error != NULL) *_error = 5;\
+        return NULL;\
+    }\
+\
+    return new_hash_multiset;\
+}\
+\
+static inline ptrdiff_t name##_delete(name *const _hash_multiset)\
+{\
+    if (_hash_multiset == NULL) return -1;\
+    free(_hash_multiset->entries);\
+    free(_hash_multiset);\
+    return 1;\
+}\
+\
+static inline ptrdiff_t name##_insert(name *const _hash_multiset,\
+                                      const key_type _key)\
+{\
+    if (_hash_multiset == NULL) return -1;\
+\
+    if (_hash_multiset->slots_count == 0)\
+    {\
+        if (name##_rehash(_hash_multiset, C_HASH_MULTISET_TYPED_0) < 0) return -3;\
+    } else if ((float)(_hash_multiset->uniques_count + 1) > _hash_multiset->slots_count * _hash_multiset->max_load_factor) {\
+        if (_hash_multiset->slots_count > SIZE_MAX / 2) return -4;\
+        if (name##_rehash(_hash_multiset, _hash_multiset->slots_count * 2) < 0) return -6;\
+    }\
+\
+    const size_t hash = (size_t)(hash_expr(_key));\
+    const size_t mask = _hash_multiset->slots_count - 1;\
+    size_t e = name##_home(_hash_multiset, hash);\
+    for ( ; ; e = (e + 1) & mask)\
+    {\
+        name##_entry *const select_entry = &_hash_multiset->entries[e];\
+        if (select_entry->count == 0)\
+        {\
+            select_entry->hash = hash;\
+            select_entry->count = 1;\
+            select_entry->key = _key;\
+            ++_hash_multiset->uniques_count;\
+            break;\
+        }\
+        if ( (select_entry->hash == hash) && (eq_expr(select_entry->key, _key)) )\
+        {\
+            ++select_entry->count;\
+            break;\
+        }\
+    }\
+\
+    ++_hash_multiset->nodes_count;\
+\
+    return 1;\
+}\
+\
+static inline void name##_vacate(name *const _hash_multiset,\
+                                 size_t _e)\
+{\
+    const size_t mask = _hash_multiset->slots_count - 1;\
+    name##_entry *const entries = _hash_multiset->entries;\
+    for (size_t j = (_e + 1) & mask; entries[j].count != 0; j = (j + 1) & mask)\
+    {\
+        const size_t home = name##_home(_hash_multiset, entries[j].hash);\
+        if ( ((j - home) & mask) >= ((j - _e) & mask) )\
+        {\
+            entries[_e] = entries[j];\
+            _e = j;\
+        }\
+    }\
+    entries[_e].count = 0;\
+    --_hash_multiset->uniques_count;\
+}\
+\
+static inline ptrdiff_t name##_erase(name *const _hash_multiset,\
+                                     const key_type _key)\
+{\
+    if (_hash_multiset == NULL) return -1;\
+\
+    const size_t e = name##_find(_hash_multiset, &_key, (size_t)(hash_expr(_key)));\
+    if (e == SIZE_MAX) return 0;\
+\
+    --_hash_multiset->nodes_count;\
+    if (--_hash_multiset->entries[e].count == 0)\
+    {\
+        name##_vacate(_hash_multiset, e);\
+    }\
+\
+    return 1;\
+}\
+\
+static inline size_t name##_erase_all(name *const _hash_multiset,\
+                                      const key_type _key,\
+                                      size_t *const _error)\
+{\
+    if (_hash_multiset == NULL)\
+    {\
+        if (_error != NULL) *_error = 1;\
+        return 0;\
+    }\
+\
+    const size_t e = name##_find(_hash_multiset, &_key, (size_t)(hash_expr(_key)));\
+    if (e == SIZE_MAX) return 0;\
+\
+    const size_t count = _hash_multiset->entries[e].count;\
+    _hash_multiset->nodes_count -= count;\
+    name##_vacate(_hash_multiset, e);\
+\
+    return count;\
+}\
+\
+static inline ptrdiff_t name##_check(const name *const _hash_multiset,\
+                                     const key_type _key)\
+{\
+    if (_hash_multiset == NULL) return -1;\
+    if (_hash_multiset->uniques_count == 0) return 0;\
+    return name##_find(_hash_multiset, &_key, (size_t)(hash_expr(_key))) != SIZE_MAX;\
+}\
+\
+static inline size_t name##_data_count(const name *const _hash_multiset,\
+                                       const key_type _key,\
+                                       size_t *const _error)\
+{\
+    if (_hash_multiset == NULL)\
+    {\
+        if (_error != NULL) *_error = 1;\
+        return 0;\
+    }\
+    if (_hash_multiset->uniques_count == 0) return 0;\
+    const size_t e = name##_find(_hash_multiset, &_key, (size_t)(hash_expr(_key)));\
+    return (e != SIZE_MAX) ? _hash_multiset->entries[e].count : 0;\
+}\
+\
+static inline ptrdiff_t name##_for_each(const name *const _hash_multiset,\
+                                        void (*const _action_data)(const key_type *const _data))\
+{\
+    if (_hash_multiset == NULL) return -1;\
+    if (_action_data == NULL) return -2;\
+    if (_hash_multiset->uniques_count == 0) return 0;\
+    for (size_t e = 0; e < _hash_multiset->slots_count; ++e)\
+    {\
+        const name##_entry *const select_entry = &_hash_multiset->entries[e];\
+        for (size_t c = 0; c < select_entry->count; ++c)\
+        {\
+            _action_data(&select_entry->key);\
+        }\
+    }\
+    return 1;\
+}\
+\
+static inline ptrdiff_t name##_clear(name *const _hash_multiset)\
+{\
+    if (_hash_multiset == NULL) return -1;\
+    if (_hash_multiset->uniques_count == 0) return 0;\
+    for (size_t e = 0; e < _hash_multiset->slots_count; ++e)\
+    {\
+        _hash_multiset->entries[e].count = 0;\
+    }\
+    _hash_multiset->nodes_count = 0;\
+    _hash_multiset->uniques_count = 0;\
+    return 1;\
+}\
+\
+static inline ptrdiff_t name##_resize(name *const _hash_multiset,\
+                                      const size_t _slots_count)\
+{\
+    if (_hash_multiset == NULL) return -1;\
+    if (_slots_count == 0)\
+    {\
+        if (_hash_multiset->uniques_count > 0) return -2;\
+        free(_hash_multiset->entries);\
+        _hash_multiset->entries = NULL;\
+        _hash_multiset->slots_count = 0;\
+        _hash_multiset->shift = 64;\
+        return 1;\
+    }\
+    size_t slots_count = C_HASH_MULTISET_TYPED_0;\
+    while ( (slots_count < _slots_count) ||\
+            ((float)_hash_multiset->uniques_count > slots_count * _hash_multiset->max_load_factor) )\
+    {\
+        if (slots_count > SIZE_MAX / 2) return -3;\
+        slots_count *= 2;\
+    }\
+    if (slots_count == _hash_multiset->slots_count) return 0;\
+    if (name##_rehash(_hash_multiset, slots_count) < 0) return -4;\
+    return 1;\
+}\
+\
+static inline size_t name##_slots_count(const name *const _hash_multiset,\
+                                        size_t *const _error)\
+{\
+    if (_hash_multiset == NULL)\
+    {\
+        if (_error != NULL) *_error = 1;\
+        return 0;\
+    }\
+    return _hash_multiset->slots_count;\
+}\
+\
+static inline size_t name##_count(const name *const _hash_multiset,\
+                                  size_t *const _error)\
+{\
+    if (_hash_multiset == NULL)\
+    {\
+        if (_error != NULL) *_error = 1;\
+        return 0;\
+    }\
+    return _hash_multiset->nodes_count;\
+}\
+\
+static inline size_t name##_uniques_count(const name *const _hash_multiset,\
+                                          size_t *const _error)\
+{\
+    if (_hash_multiset == NULL)\
+    {\
+        if (_error != NULL) *_error = 1;\
+        return 0;\
+    }\
+    return _hash_multiset->uniques_count;\
+}
+
+#endif
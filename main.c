@@ -3,39 +3,7 @@
 #include <string.h>
 
 #include "c_hash_multiset.h"
-
-// Функция генерации хэша по элементу-строке.
-size_t hash_data_s(const void *const _data)
-{
-    if (_data == NULL)return 0;
-    const char *c = (char*)_data;
-    size_t hash = 0;
-    while (*c != 0)
-    {
-        hash += *(c++);
-    }
-    return hash;
-}
-
-// Функция детального сравнения элементов-строк.
-size_t comp_data_s(const void *const _key_a,
-                   const void *const _key_b)
-{
-    if ( (_key_a == NULL) || (_key_b == NULL) )
-    {
-        return 0;
-    }
-
-    const char *const key_a = (char*)_key_a;
-    const char *const key_b = (char*)_key_b;
-
-    if (strcmp(key_a, key_b) == 0)
-    {
-        return 1;
-    }
-
-    return 0;
-}
+#include "c_hash_multiset_hash.h"
 
 // Функция вывода элементов-строки.
 void print_data_s(const void *const _data)
@@ -51,8 +19,8 @@ int main(int argc, char **argv)
     size_t error;
     c_hash_multiset *hash_multiset;
 
-    // Попытаемся создать хэш-мультимножество.
-    hash_multiset = c_hash_multiset_create(hash_data_s, comp_data_s, 10, 0.5f, &error);
+    // Попытаемся создать хэш-мультимножество строк со встроенными функциями хэша и сравнения.
+    hash_multiset = c_hash_multiset_create(c_hash_multiset_hash_string, c_hash_multiset_comp_string, 10, 0.5f, &error);
     // Если возникла ошибка, покажем ее.
     if (hash_multiset == NULL)
     {